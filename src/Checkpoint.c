@@ -0,0 +1,101 @@
+/***************************************************************************************************
+ * @file Checkpoint.c
+ * @brief State of a long encoding or recuperation, to resume it if the process gets killed.
+ *
+ * @version   1.0
+ * @date      2024-07-23
+ * @author    @dabecart
+ *
+ * @license
+ * This project is licensed under the MIT License - see the LICENSE file for details.
+ **************************************************************************************************/
+
+#include "Checkpoint.h"
+#include "Checksum.h"
+#include "RecTrailer.h"
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+
+#define CHECKPOINT_OPTIONS      9
+#define CHECKPOINT_PROGRESS     6
+#define CHECKPOINT_SIZE         (8 + 4 + 8*(CHECKPOINT_OPTIONS + CHECKPOINT_PROGRESS) + 3*4 + 4)
+
+/***************************************************************************************************
+ * FUNCTIONS
+ **************************************************************************************************/
+
+int writeCheckpoint(const char* filename, const Checkpoint* checkpoint){
+    unsigned char bytes[CHECKPOINT_SIZE];
+    unsigned char* out = bytes;
+    memcpy(out, CHECKPOINT_MAGIC, 8);
+    putU32(out + 8, checkpoint->kind);
+    out += 12;
+
+    const long fields[CHECKPOINT_OPTIONS + CHECKPOINT_PROGRESS] = {
+        checkpoint->inputSize, checkpoint->recSize, checkpoint->depth, checkpoint->columnGroup,
+        checkpoint->columnParity, checkpoint->regionBlocks, checkpoint->parityPolicy,
+        checkpoint->decodeBudget, checkpoint->secondRead,
+        checkpoint->blocks, checkpoint->inputPosition, checkpoint->recPosition,
+        checkpoint->outputPosition, checkpoint->blocksCorrected, checkpoint->columnsFixed,
+    };
+    for(int i = 0; i < CHECKPOINT_OPTIONS + CHECKPOINT_PROGRESS; i++, out += 8){
+        putU64(out, fields[i]);
+    }
+    putU32(out, checkpoint->inputCrc);
+    putU32(out + 4, checkpoint->recCrc);
+    putU32(out + 8, checkpoint->outputCrc);
+    putU32(out + 12, crc32c(0, bytes, CHECKPOINT_SIZE - 4));
+
+    // Written aside and renamed, so the file always has a whole checkpoint.
+    char temporary[strlen(filename) + 5];
+    sprintf(temporary, "%s.tmp", filename);
+    FILE* file = fopen(temporary, "wb");
+    if(file == NULL) return -1;
+
+    int ret = fwrite(bytes, 1, CHECKPOINT_SIZE, file) == CHECKPOINT_SIZE && fflush(file) == 0 &&
+              fsync(fileno(file)) == 0;
+    if(fclose(file) != 0 || !ret || rename(temporary, filename) != 0){
+        remove(temporary);
+        return -1;
+    }
+    return 0;
+}
+
+int readCheckpoint(const char* filename, Checkpoint* checkpoint){
+    FILE* file = fopen(filename, "rb");
+    if(file == NULL) return -1;
+
+    unsigned char bytes[CHECKPOINT_SIZE + 1];
+    size_t length = fread(bytes, 1, sizeof(bytes), file);
+    fclose(file);
+    if(length != CHECKPOINT_SIZE || memcmp(bytes, CHECKPOINT_MAGIC, 8) != 0 ||
+       getU32(bytes + CHECKPOINT_SIZE - 4) != crc32c(0, bytes, CHECKPOINT_SIZE - 4)){
+        return -1;
+    }
+
+    checkpoint->kind = getU32(bytes + 8);
+    const unsigned char* in = bytes + 12;
+    long* fields[CHECKPOINT_OPTIONS + CHECKPOINT_PROGRESS] = {
+        &checkpoint->inputSize, &checkpoint->recSize, &checkpoint->depth, &checkpoint->columnGroup,
+        &checkpoint->columnParity, &checkpoint->regionBlocks, &checkpoint->parityPolicy,
+        &checkpoint->decodeBudget, &checkpoint->secondRead,
+        &checkpoint->blocks, &checkpoint->inputPosition, &checkpoint->recPosition,
+        &checkpoint->outputPosition, &checkpoint->blocksCorrected, &checkpoint->columnsFixed,
+    };
+    for(int i = 0; i < CHECKPOINT_OPTIONS + CHECKPOINT_PROGRESS; i++, in += 8){
+        *fields[i] = getU64(in);
+    }
+    checkpoint->inputCrc = getU32(in);
+    checkpoint->recCrc = getU32(in + 4);
+    checkpoint->outputCrc = getU32(in + 8);
+    return 0;
+}
+
+int sameCheckpointJob(const Checkpoint* a, const Checkpoint* b){
+    return a->kind == b->kind && a->inputSize == b->inputSize && a->recSize == b->recSize &&
+           a->depth == b->depth && a->columnGroup == b->columnGroup &&
+           a->columnParity == b->columnParity && a->regionBlocks == b->regionBlocks &&
+           a->parityPolicy == b->parityPolicy && a->decodeBudget == b->decodeBudget && 
+           a->secondRead == b->secondRead;
+}
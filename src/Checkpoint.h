@@ -0,0 +1,97 @@
+/***************************************************************************************************
+ * @file Checkpoint.h
+ * @brief State of a long encoding or recuperation, to resume it if the process gets killed.
+ *
+ * Every few seconds, the job flushes its output and saves how far it got on a small state file:
+ *
+ *   "RSCKPT02"  magic
+ *   u32         kind of job (CheckpointKind)
+ *   u64[]       options of the job: size of the input and of the recuperation file, interleave
+ *               depth, column group and parity rows, blocks per region of the integrity index,
+ *               parity policy, budget of combinations per block and whether there's a second read
+ *   u64[]       progress: blocks done, bytes read of the input and of the recuperation file, bytes
+ *               of the output, blocks OK and blocks recuperated with the column parity
+ *   u32         CRC32C of the bytes read of the input
+ *   u32         CRC32C of the bytes read of the recuperation file
+ *   u32         CRC32C of the first bytes of the output
+ *   u32         CRC32C of everything above
+ *
+ * All numbers are little endian. The file is replaced atomically (written aside and renamed), so it
+ * always holds a whole checkpoint. A job can only be resumed with the same options and the same 
+ * input and recuperation files up to the checkpoint, and if its output still has the same checksum 
+ * up to it.
+ *
+ * @version   1.0
+ * @date      2024-07-23
+ * @author    @dabecart
+ *
+ * @license
+ * This project is licensed under the MIT License - see the LICENSE file for details.
+ **************************************************************************************************/
+
+#ifndef CHECKPOINT_h
+#define CHECKPOINT_h
+
+#include "CommonDefines.h"
+
+/***************************************************************************************************
+ * DEFINES
+ **************************************************************************************************/
+
+#define CHECKPOINT_MAGIC            "RSCKPT02"
+
+// Seconds between checkpoints by default.
+#define CHECKPOINT_DEFAULT_INTERVAL 10
+
+/***************************************************************************************************
+ * TYPES
+ **************************************************************************************************/
+
+typedef enum{
+    CHECKPOINT_ENCODE       = 1,
+    CHECKPOINT_RECUPERATE   = 2,
+} CheckpointKind;
+
+typedef struct{
+    CheckpointKind kind;
+
+    // Options of the job.
+    long inputSize;
+    long recSize;
+    long depth;
+    long columnGroup;
+    long columnParity;
+    long regionBlocks;
+    long parityPolicy;
+    long decodeBudget;
+    long secondRead;
+
+    // Progress. Everything before these positions is on the output.
+    long blocks;
+    long inputPosition;
+    long recPosition;
+    long outputPosition;
+    long blocksCorrected;
+    long columnsFixed;
+
+    // Checksums of what was read of the input and of the recuperation file and of what was written
+    // on the output, up to the positions above.
+    unsigned int inputCrc;
+    unsigned int recCrc;
+    unsigned int outputCrc;
+} Checkpoint;
+
+/***************************************************************************************************
+ * FUNCTIONS
+ **************************************************************************************************/
+
+// Saves [checkpoint] on [filename], replacing the previous one. Returns -1 on error.
+int writeCheckpoint(const char* filename, const Checkpoint* checkpoint);
+
+// Reads the checkpoint of [filename]. Returns -1 if it doesn't exist or it's not valid.
+int readCheckpoint(const char* filename, Checkpoint* checkpoint);
+
+// 1 if both jobs were started with the same options.
+int sameCheckpointJob(const Checkpoint* a, const Checkpoint* b);
+
+#endif
@@ -0,0 +1,242 @@
+/***************************************************************************************************
+ * @file Checksum.c
+ * @brief CRC-16-CCITT and CRC32C with runtime selected implementations.
+ *
+ * @version   1.0
+ * @date      2024-07-23
+ * @author    @dabecart
+ *
+ * @license
+ * This project is licensed under the MIT License - see the LICENSE file for details.
+ **************************************************************************************************/
+
+#include "Checksum.h"
+#include <pthread.h>
+#include <string.h>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define CHECKSUM_X86
+#endif
+
+#define CRC16_POLYNOMIAL        0x1021
+#define CRC32C_POLYNOMIAL       0x82F63B78
+
+// Bytes checked against the portable implementations before using the ones of the CPU.
+#define SELF_CHECK_LENGTH       512
+
+/***************************************************************************************************
+ * TABLES
+ **************************************************************************************************/
+
+// crc16Table[k][b] is the CRC (with an initial value of 0) of the byte b followed by k zero bytes,
+// so eight bytes are processed with eight independent lookups. The same goes for the CRC32C,
+// which is reflected.
+static unsigned short crc16Table[8][256];
+static unsigned int crc32cTable[8][256];
+
+// Constants of the PCLMULQDQ folding: x^192 and x^128 modulo the CRC-16 polynomial.
+static unsigned long long foldHigh;
+static unsigned long long foldLow;
+
+static int hasPclmul = 0;
+static int hasSse42 = 0;
+static int accelerationEnabled = 1;
+static pthread_once_t checksumOnce = PTHREAD_ONCE_INIT;
+
+static unsigned long long crc16PowerOfX(int power){
+    unsigned int remainder = 1;
+    for(int i = 0; i < power; i++){
+        remainder <<= 1;
+        if(remainder & 0x10000) remainder ^= 0x10000 | CRC16_POLYNOMIAL;
+    }
+    return remainder;
+}
+
+static void buildTables(){
+    for(int b = 0; b < 256; b++){
+        unsigned short crc16 = b << 8;
+        unsigned int crc32 = b;
+        for(int bit = 0; bit < 8; bit++){
+            crc16 = (crc16 & 0x8000) ? (crc16 << 1) ^ CRC16_POLYNOMIAL : crc16 << 1;
+            crc32 = (crc32 & 1) ? (crc32 >> 1) ^ CRC32C_POLYNOMIAL : crc32 >> 1;
+        }
+        crc16Table[0][b] = crc16;
+        crc32cTable[0][b] = crc32;
+    }
+    for(int k = 1; k < 8; k++){
+        for(int b = 0; b < 256; b++){
+            unsigned short crc16 = crc16Table[k-1][b];
+            crc16Table[k][b] = (crc16 << 8) ^ crc16Table[0][crc16 >> 8];
+            unsigned int crc32 = crc32cTable[k-1][b];
+            crc32cTable[k][b] = (crc32 >> 8) ^ crc32cTable[0][crc32 & 0xFF];
+        }
+    }
+    foldHigh = crc16PowerOfX(192);
+    foldLow  = crc16PowerOfX(128);
+}
+
+/***************************************************************************************************
+ * PORTABLE IMPLEMENTATIONS
+ **************************************************************************************************/
+
+static unsigned short crc16Slicing(unsigned short crc, const unsigned char* data, size_t length){
+    while(length >= 8){
+        crc ^= (data[0] << 8) | data[1];
+        crc = crc16Table[7][crc >> 8]  ^ crc16Table[6][crc & 0xFF] ^
+              crc16Table[5][data[2]]   ^ crc16Table[4][data[3]]   ^
+              crc16Table[3][data[4]]   ^ crc16Table[2][data[5]]   ^
+              crc16Table[1][data[6]]   ^ crc16Table[0][data[7]];
+        data += 8;
+        length -= 8;
+    }
+    while(length--){
+        crc = (crc << 8) ^ crc16Table[0][(crc >> 8) ^ *data++];
+    }
+    return crc;
+}
+
+static unsigned int crc32cSlicing(unsigned int crc, const unsigned char* data, size_t length){
+    crc = ~crc;
+    while(length >= 8){
+        crc ^= data[0] | (data[1] << 8) | (data[2] << 16) | ((unsigned int) data[3] << 24);
+        crc = crc32cTable[7][crc & 0xFF]         ^ crc32cTable[6][(crc >> 8) & 0xFF] ^
+              crc32cTable[5][(crc >> 16) & 0xFF] ^ crc32cTable[4][crc >> 24]         ^
+              crc32cTable[3][data[4]]            ^ crc32cTable[2][data[5]]           ^
+              crc32cTable[1][data[6]]            ^ crc32cTable[0][data[7]];
+        data += 8;
+        length -= 8;
+    }
+    while(length--){
+        crc = (crc >> 8) ^ crc32cTable[0][(crc ^ *data++) & 0xFF];
+    }
+    return ~crc;
+}
+
+/***************************************************************************************************
+ * x86 IMPLEMENTATIONS
+ **************************************************************************************************/
+
+#ifdef CHECKSUM_X86
+
+// The buffer is taken 16 bytes at a time as a polynomial of degree 127, with the first byte on the
+// highest coefficients. Multiplying the accumulated polynomial by x^128 and adding the next 16
+// bytes keeps the same remainder, and it's done on its two halves with the constants x^192 and
+// x^128 (modulo the polynomial), so the accumulator never grows over 128 bits. The last
+// accumulator and the bytes that don't fill 16 are reduced with the tables. [length] must be 16 or
+// more.
+__attribute__((target("pclmul,ssse3")))
+static unsigned short crc16Fold(unsigned short crc, const unsigned char* data, size_t length){
+    const __m128i reverse = _mm_set_epi8(0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13, 14, 15);
+    const __m128i constants = _mm_set_epi64x(foldLow, foldHigh);
+
+    // The previous CRC gets added to the first 16 bits of the buffer.
+    __m128i acc = _mm_shuffle_epi8(_mm_loadu_si128((const __m128i*) data), reverse);
+    acc = _mm_xor_si128(acc, _mm_set_epi64x((long long) crc << 48, 0));
+    data += 16;
+    length -= 16;
+
+    while(length >= 16){
+        __m128i next = _mm_shuffle_epi8(_mm_loadu_si128((const __m128i*) data), reverse);
+        acc = _mm_xor_si128(_mm_xor_si128(_mm_clmulepi64_si128(acc, constants, 0x01),
+                                          _mm_clmulepi64_si128(acc, constants, 0x10)), next);
+        data += 16;
+        length -= 16;
+    }
+
+    unsigned char bytes[16];
+    _mm_storeu_si128((__m128i*) bytes, _mm_shuffle_epi8(acc, reverse));
+    return crc16Slicing(crc16Slicing(0, bytes, sizeof(bytes)), data, length);
+}
+
+__attribute__((target("sse4.2")))
+static unsigned int crc32cHardware(unsigned int crc, const unsigned char* data, size_t length){
+    crc = ~crc;
+#ifdef __x86_64__
+    unsigned long long crc64 = crc;
+    while(length >= 8){
+        unsigned long long word;
+        memcpy(&word, data, sizeof(word));
+        crc64 = _mm_crc32_u64(crc64, word);
+        data += 8;
+        length -= 8;
+    }
+    crc = crc64;
+#endif
+    while(length--){
+        crc = _mm_crc32_u8(crc, *data++);
+    }
+    return ~crc;
+}
+
+#endif
+
+/***************************************************************************************************
+ * SELECTION
+ **************************************************************************************************/
+
+static void initChecksums(){
+    buildTables();
+
+#ifdef CHECKSUM_X86
+    __builtin_cpu_init();
+    hasPclmul = __builtin_cpu_supports("pclmul") && __builtin_cpu_supports("ssse3");
+    hasSse42 = __builtin_cpu_supports("sse4.2");
+
+    // The instructions are only used if they give the same results as the tables.
+    unsigned char sample[SELF_CHECK_LENGTH];
+    unsigned int seed = 0x12345678;
+    for(int i = 0; i < SELF_CHECK_LENGTH; i++){
+        seed = seed*1103515245 + 12345;
+        sample[i] = seed >> 16;
+    }
+    for(size_t length = 16; length <= SELF_CHECK_LENGTH; length += 7){
+        if(hasPclmul && crc16Fold(CRC16_INITIAL, sample, length) !=
+                        crc16Slicing(CRC16_INITIAL, sample, length)){
+            hasPclmul = 0;
+        }
+        if(hasSse42 && crc32cHardware(0, sample, length) != crc32cSlicing(0, sample, length)){
+            hasSse42 = 0;
+        }
+    }
+#endif
+}
+
+/***************************************************************************************************
+ * FUNCTIONS
+ **************************************************************************************************/
+
+unsigned short crc16Update(unsigned short crc, const unsigned char* data, size_t length){
+    pthread_once(&checksumOnce, initChecksums);
+#ifdef CHECKSUM_X86
+    if(accelerationEnabled && hasPclmul && length >= CRC16_FOLD_MIN_LENGTH){
+        return crc16Fold(crc, data, length);
+    }
+#endif
+    return crc16Slicing(crc, data, length);
+}
+
+unsigned short crc16(const unsigned char* data, size_t length){
+    return crc16Update(CRC16_INITIAL, data, length);
+}
+
+unsigned int crc32c(unsigned int crc, const unsigned char* data, size_t length){
+    pthread_once(&checksumOnce, initChecksums);
+#ifdef CHECKSUM_X86
+    if(accelerationEnabled && hasSse42) return crc32cHardware(crc, data, length);
+#endif
+    return crc32cSlicing(crc, data, length);
+}
+
+void setChecksumAcceleration(int enabled){
+    accelerationEnabled = enabled;
+}
+
+const char* checksumImplementation(){
+    pthread_once(&checksumOnce, initChecksums);
+    if(!accelerationEnabled)    return "slicing-by-8";
+    if(hasPclmul && hasSse42)   return "pclmul+sse4.2";
+    if(hasPclmul)               return "pclmul";
+    if(hasSse42)                return "sse4.2";
+    return "slicing-by-8";
+}
@@ -0,0 +1,55 @@
+/***************************************************************************************************
+ * @file Checksum.h
+ * @brief CRC-16-CCITT and CRC32C with runtime selected implementations.
+ *
+ * Every checksum has a portable table-driven implementation (slicing-by-8) and one that uses the
+ * instructions of the CPU when it has them: PCLMULQDQ folding for the CRC-16 of long buffers and
+ * the SSE4.2 CRC32 instruction for the CRC32C. They are chosen the first time a checksum is
+ * computed and all of them return the same values.
+ *
+ * @version   1.0
+ * @date      2024-07-23
+ * @author    @dabecart
+ *
+ * @license
+ * This project is licensed under the MIT License - see the LICENSE file for details.
+ **************************************************************************************************/
+
+#ifndef CHECKSUM_h
+#define CHECKSUM_h
+
+#include <stddef.h>
+
+/***************************************************************************************************
+ * DEFINES
+ **************************************************************************************************/
+
+// Initial value of the CRC-16-CCITT (the "FALSE" variant: no reflection and no final XOR).
+#define CRC16_INITIAL           0xFFFF
+
+// Buffers shorter than this are not worth folding with PCLMULQDQ.
+#define CRC16_FOLD_MIN_LENGTH   64
+
+/***************************************************************************************************
+ * FUNCTIONS
+ **************************************************************************************************/
+
+// CRC-16-CCITT (polynomial 0x1021) of the [length] bytes of [data].
+unsigned short crc16(const unsigned char* data, size_t length);
+
+// Continues the CRC-16-CCITT [crc] of the previous bytes with the [length] bytes of [data].
+// crc16() is the same as starting with CRC16_INITIAL.
+unsigned short crc16Update(unsigned short crc, const unsigned char* data, size_t length);
+
+// Continues the CRC32C (Castagnoli, reflected polynomial 0x82F63B78) [crc] of the previous bytes
+// with the [length] bytes of [data]. Start with a [crc] of 0.
+unsigned int crc32c(unsigned int crc, const unsigned char* data, size_t length);
+
+// 0 forces the portable implementations, 1 (the default) uses the instructions of the CPU when
+// available. Call it before computing any checksum from several threads.
+void setChecksumAcceleration(int enabled);
+
+// Name of the implementations in use, e.g. "pclmul+sse4.2" or "slicing-by-8".
+const char* checksumImplementation();
+
+#endif
@@ -0,0 +1,196 @@
+/***************************************************************************************************
+ * @file ColumnParity.c
+ * @brief Second dimension of the code: parity across the columns of groups of blocks.
+ *
+ * @version   1.0
+ * @date      2024-07-23
+ * @author    @dabecart
+ *
+ * @license
+ * This project is licensed under the MIT License - see the LICENSE file for details.
+ **************************************************************************************************/
+
+#include "ColumnParity.h"
+#include <pthread.h>
+
+// group, parity and numGroups.
+#define COLUMN_HEADER_SIZE 16
+
+/***************************************************************************************************
+ * GF(2^8)
+ **************************************************************************************************/
+
+// Tables of GF(2^8) with the polynomial x^8 + x^4 + x^3 + x^2 + 1.
+static unsigned char gfExp[512];
+static unsigned char gfLog[256];
+static pthread_once_t gfOnce = PTHREAD_ONCE_INIT;
+
+static void initGaloisField(){
+    int value = 1;
+    for(int i = 0; i < 255; i++){
+        gfExp[i] = value;
+        gfLog[value] = i;
+        value <<= 1;
+        if(value & 0x100) value ^= 0x11D;
+    }
+    for(int i = 255; i < 512; i++) gfExp[i] = gfExp[i - 255];
+}
+
+static inline unsigned char gfMul(unsigned char a, unsigned char b){
+    if(a == 0 || b == 0) return 0;
+    return gfExp[gfLog[a] + gfLog[b]];
+}
+
+static inline unsigned char gfInv(unsigned char a){
+    return gfExp[255 - gfLog[a]];
+}
+
+// Coefficient of the block [row] on the parity row [k]: 1/(x_k + y_row), with x_k = k and 
+// y_row = parity + row. Every square submatrix of a Cauchy matrix can be inverted, so any 
+// [parity] erasures can be recuperated.
+static inline unsigned char cauchy(long k, long row, long parity){
+    return gfInv(k ^ (parity + row));
+}
+
+/***************************************************************************************************
+ * FUNCTIONS
+ **************************************************************************************************/
+
+long columnGroupBytes(long parity){
+    return parity*NUM_POINTS_SAMPLE;
+}
+
+void encodeColumns(const unsigned char* blocks, long numBlocks, long group, long parity, 
+                   unsigned char* out){
+    pthread_once(&gfOnce, initGaloisField);
+
+    for(long first = 0; first < numBlocks; first += group){
+        long rows = numBlocks - first < group ? numBlocks - first : group;
+        memset(out, 0, columnGroupBytes(parity));
+
+        for(long k = 0; k < parity; k++){
+            unsigned char* parityRow = out + k*NUM_POINTS_SAMPLE;
+            for(long row = 0; row < rows; row++){
+                unsigned char coefficient = cauchy(k, row, parity);
+                const unsigned char* block = blocks + (first + row)*NUM_POINTS_SAMPLE;
+                for(int j = 0; j < NUM_POINTS_SAMPLE; j++){
+                    parityRow[j] ^= gfMul(coefficient, block[j]);
+                }
+            }
+        }
+        out += columnGroupBytes(parity);
+    }
+}
+
+// Computes what's left of the parity row [k] once the blocks that aren't erased are removed.
+static void syndrome(const unsigned char* blocks, long numBlocks, const unsigned char* parityRow, 
+                     long k, long parity, const unsigned char* isErased, unsigned char* out){
+    memcpy(out, parityRow, NUM_POINTS_SAMPLE);
+    for(long row = 0; row < numBlocks; row++){
+        if(isErased[row]) continue;
+        unsigned char coefficient = cauchy(k, row, parity);
+        const unsigned char* block = blocks + row*NUM_POINTS_SAMPLE;
+        for(int j = 0; j < NUM_POINTS_SAMPLE; j++) out[j] ^= gfMul(coefficient, block[j]);
+    }
+}
+
+static void swapBytes(unsigned char* a, unsigned char* b, size_t length){
+    for(size_t i = 0; i < length; i++){
+        unsigned char swap = a[i];
+        a[i] = b[i];
+        b[i] = swap;
+    }
+}
+
+int decodeColumns(unsigned char* blocks, long numBlocks, const unsigned char* parityRows, 
+                  long parity, const long* erased, int numErased){
+    if(numErased == 0) return 1;
+    if(numErased > parity) return -1;
+    pthread_once(&gfOnce, initGaloisField);
+
+    unsigned char isErased[COLUMN_MAX_ROWS] = {0};
+    for(int t = 0; t < numErased; t++) isErased[erased[t]] = 1;
+
+    // The first [numErased] parity rows give a square system M*x = s, with x the erased blocks.
+    unsigned char m[COLUMN_MAX_PARITY][COLUMN_MAX_PARITY];
+    unsigned char s[COLUMN_MAX_PARITY][NUM_POINTS_SAMPLE];
+    for(int k = 0; k < numErased; k++){
+        for(int t = 0; t < numErased; t++) m[k][t] = cauchy(k, erased[t], parity);
+        syndrome(blocks, numBlocks, parityRows + k*NUM_POINTS_SAMPLE, k, parity, isErased, s[k]);
+    }
+
+    // Gauss-Jordan elimination, applied to the NUM_POINTS_SAMPLE columns at once.
+    for(int col = 0; col < numErased; col++){
+        int pivot = col;
+        while(pivot < numErased && m[pivot][col] == 0) pivot++;
+        if(pivot == numErased) return -1;
+        if(pivot != col){
+            swapBytes(m[col], m[pivot], sizeof(m[col]));
+            swapBytes(s[col], s[pivot], sizeof(s[col]));
+        }
+
+        unsigned char inverse = gfInv(m[col][col]);
+        for(int t = 0; t < numErased; t++) m[col][t] = gfMul(m[col][t], inverse);
+        for(int j = 0; j < NUM_POINTS_SAMPLE; j++) s[col][j] = gfMul(s[col][j], inverse);
+
+        for(int k = 0; k < numErased; k++){
+            unsigned char factor = m[k][col];
+            if(k == col || factor == 0) continue;
+            for(int t = 0; t < numErased; t++) m[k][t] ^= gfMul(factor, m[col][t]);
+            for(int j = 0; j < NUM_POINTS_SAMPLE; j++) s[k][j] ^= gfMul(factor, s[col][j]);
+        }
+    }
+    for(int t = 0; t < numErased; t++){
+        memcpy(blocks + erased[t]*NUM_POINTS_SAMPLE, s[t], NUM_POINTS_SAMPLE);
+    }
+
+    // The parity rows that weren't needed must match the recuperated blocks.
+    if(numErased == parity) return 0;
+    unsigned char check[NUM_POINTS_SAMPLE];
+    unsigned char none[COLUMN_MAX_ROWS] = {0};
+    for(long k = numErased; k < parity; k++){
+        syndrome(blocks, numBlocks, parityRows + k*NUM_POINTS_SAMPLE, k, parity, none, check);
+        for(int j = 0; j < NUM_POINTS_SAMPLE; j++){
+            if(check[j] != 0) return 0;
+        }
+    }
+    return 1;
+}
+
+int serializeColumnParity(const ColumnParity* columns, TrailerSection* section){
+    long length = columns->numGroups*columnGroupBytes(columns->parity);
+    memcpy(section->tag, COLUMN_SECTION_TAG, 4);
+    section->length = COLUMN_HEADER_SIZE + length;
+    section->payload = malloc(section->length);
+    if(section->payload == NULL) return -1;
+
+    putU32(section->payload, columns->group);
+    putU32(section->payload + 4, columns->parity);
+    putU64(section->payload + 8, columns->numGroups);
+    memcpy(section->payload + COLUMN_HEADER_SIZE, columns->data, length);
+    return 0;
+}
+
+int deserializeColumnParity(const TrailerSection* section, ColumnParity* columns){
+    if(section->length < COLUMN_HEADER_SIZE) return -1;
+
+    columns->group = getU32(section->payload);
+    columns->parity = getU32(section->payload + 4);
+    columns->numGroups = getU64(section->payload + 8);
+    if(columns->group < COLUMN_MIN_GROUP || columns->parity < 1 || 
+       columns->parity > COLUMN_MAX_PARITY || columns->group + columns->parity > COLUMN_MAX_ROWS){
+        return -1;
+    }
+
+    long length = columns->numGroups*columnGroupBytes(columns->parity);
+    if(section->length != COLUMN_HEADER_SIZE + length) return -1;
+    columns->data = malloc(length + 1);
+    if(columns->data == NULL) return -1;
+    memcpy(columns->data, section->payload + COLUMN_HEADER_SIZE, length);
+    return 0;
+}
+
+void freeColumnParity(ColumnParity* columns){
+    free(columns->data);
+    columns->data = NULL;
+}
@@ -0,0 +1,81 @@
+/***************************************************************************************************
+ * @file ColumnParity.h
+ * @brief Second dimension of the code: parity across the columns of groups of blocks.
+ *
+ * The blocks of the file are taken in groups of [group] blocks. Every group is a matrix with a 
+ * block on each row, and every column (the point j of all the blocks of the group) gets [parity]
+ * extra bytes from a systematic Cauchy code over GF(2^8). 
+ *
+ * The blocks that the Reed-Solomon decoder cannot fix (or that would need too many combinations) 
+ * are then erasures: their positions are known, so up to [parity] of them per group are 
+ * recuperated by solving a small linear system instead of searching any further.
+ *
+ * @version   1.0
+ * @date      2024-07-23
+ * @author    @dabecart
+ *
+ * @license
+ * This project is licensed under the MIT License - see the LICENSE file for details.
+ **************************************************************************************************/
+
+#ifndef COLUMN_PARITY_h
+#define COLUMN_PARITY_h
+
+#include "CommonDefines.h"
+#include "RecTrailer.h"
+
+/***************************************************************************************************
+ * DEFINES
+ **************************************************************************************************/
+
+// Tag of the trailer section that holds the column parity.
+#define COLUMN_SECTION_TAG      "COLP"
+
+#define COLUMN_DEFAULT_GROUP    64
+#define COLUMN_DEFAULT_PARITY   2
+
+// Limits of the sizes. The group and the parity together cannot have more than 256 rows.
+#define COLUMN_MIN_GROUP        8
+#define COLUMN_MAX_PARITY       16
+#define COLUMN_MAX_ROWS         256
+
+/***************************************************************************************************
+ * TYPES
+ **************************************************************************************************/
+
+typedef struct{
+    long group;
+    long parity;
+    long numGroups;
+    // [parity] rows of NUM_POINTS_SAMPLE bytes for every group.
+    unsigned char* data;
+} ColumnParity;
+
+/***************************************************************************************************
+ * FUNCTIONS
+ **************************************************************************************************/
+
+// Bytes of parity of every group.
+long columnGroupBytes(long parity);
+
+// Computes the parity of the [numBlocks] blocks of [blocks] into [out], a group after the other. 
+// [blocks] starts on a group and only its last group can be shorter than [group].
+void encodeColumns(const unsigned char* blocks, long numBlocks, long group, long parity, 
+                   unsigned char* out);
+
+// Recuperates the [numErased] blocks of the group [blocks] (of [numBlocks] blocks) whose indices are
+// on [erased], with the [parity] rows of [parityRows]. The rest of the blocks must be right. 
+// Returns -1 if it couldn't, 1 if the spare parity rows confirm the result and 0 if there were no
+// spare rows or they don't match (so the result has to be checked some other way).
+int decodeColumns(unsigned char* blocks, long numBlocks, const unsigned char* parityRows, 
+                  long parity, const long* erased, int numErased);
+
+// Builds the trailer section of [columns]. The payload has to be freed.
+int serializeColumnParity(const ColumnParity* columns, TrailerSection* section);
+
+// Reads [columns] from its trailer section. Returns -1 if the section is malformed.
+int deserializeColumnParity(const TrailerSection* section, ColumnParity* columns);
+
+void freeColumnParity(ColumnParity* columns);
+
+#endif //COLUMN_PARITY_h
@@ -27,6 +27,7 @@
 // If we take that the extra points are not corrupted, the computations are easier and faster to do.
 // When the EEPROM is corrupted, we don't take into account the Hamming and CRC codes, as they are 
 // redundant checks used to fix >2 bit length errors.
+// This is the default, it can be changed at runtime with setParityPolicy().
 #define EEPROM_NOT_CORRUPTED    1
 
 // Number of extra points to evaluate on the polynomial. 
@@ -37,6 +38,14 @@
 // The maximum degree of polynomials in this program.
 #define RS_MAX_POLY_DEGREE      NUM_POINTS_SAMPLE+EXTRA_POINTS
 
+// Number of bytes stored on the recuperation file per block: the extra points plus the byte that 
+// contains the Hamming and CRC codes.
+#define REC_BYTES_PER_BLOCK     (EXTRA_POINTS+1)
+
+// Value used to fill the last block of a file when its size isn't a multiple of NUM_POINTS_SAMPLE.
+// Reading past the end of the file with fgetc() gives EOF, which stored as a byte is 0xFF.
+#define PADDING_BYTE            0xFF
+
 /***************************************************************************************************
  * SIMULATION DEFINES
  **************************************************************************************************/
@@ -53,11 +62,33 @@
 // Print all inputs that were fixed incorrectly.
 #define PRINT_INCORRECTLY_FIXED_INPUTS 0
 
+/***************************************************************************************************
+ * INSTRUMENTATION DEFINES
+ **************************************************************************************************/
+
+// Count what the codec does on every thread (see Instrumentation.h). They are set by the Makefile
+// with INSTRUMENT=1 (counters) or INSTRUMENT=2 (counters and timing spans). When they are 0, the
+// instrumentation is compiled out.
+#ifndef RS_INSTRUMENTATION
+#define RS_INSTRUMENTATION          0
+#endif
+
+#ifndef RS_INSTRUMENTATION_SPANS
+#define RS_INSTRUMENTATION_SPANS    0
+#endif
+
 /***************************************************************************************************
  * ALGORITHM RETURN TYPES
  **************************************************************************************************/
 
 typedef enum{
+    // The arguments were NULL or the workspace wasn't initialized (see EmbeddedCodec.h).
+    INVALID_ARGUMENTS = -6,
+
+    // The message needed to check more combinations of points than the work budget allows (see 
+    // setDecodeBudget()). It can be retried later without a budget.
+    EXCEEDS_WORK_BUDGET = -5,
+
     // When the algorithm fixes the message incorrectly and it had more errors than the maximum that
     // the algorithm can detect.
     FIXED_INCORRECTLY_EXCEEDS_NUMBER_OF_ERRORS = -4,
@@ -0,0 +1,288 @@
+/***************************************************************************************************
+ * @file EmbeddedCodec.c
+ * @brief Codec of a single block for microcontrollers: fixed footprint, no heap and no recursion.
+ *
+ * @version   1.0
+ * @date      2024-07-23
+ * @author    @dabecart
+ *
+ * @license
+ * This project is licensed under the MIT License - see the LICENSE file for details.
+ **************************************************************************************************/
+
+#include "EmbeddedCodec.h"
+#include "ModArith.h"
+
+// Points to interpolate with: the data points.
+#define EMBEDDED_LAGRANGE_POINTS    (NUM_POINTS_SAMPLE)
+
+// First point that the search takes as recuperation data and number of points chosen before it
+// when it's trusted. They are the same bounds as on the search of ReedSolomon.c (with the
+// unparenthesised EXTRA_POINTS), so both fix every block the same way.
+#define EMBEDDED_FIRST_TRUSTED      (EMBEDDED_POINTS - EXTRA_POINTS)
+#define EMBEDDED_TRUSTED_CHOSEN     (EMBEDDED_LAGRANGE_POINTS - EXTRA_POINTS)
+
+#if EMBEDDED_TRUSTED_CHOSEN <= 0
+#error "Not enough points to interpolate with trusted recuperation data"
+#endif
+
+// Same as in Checksum.h.
+#define EMBEDDED_CRC16_POLYNOMIAL   0x1021
+#define EMBEDDED_CRC16_INITIAL      0xFFFF
+
+/***************************************************************************************************
+ * ARITHMETIC
+ **************************************************************************************************/
+
+static inline Symbol multSymbol(Symbol x, Symbol y){
+    return reduceMod((ModAcc) x*y);
+}
+
+// Inverse of [x] (not 0) as x^(MODULUS-2).
+static Symbol invertSymbol(Symbol x){
+    Symbol result = 1;
+    for(unsigned int exponent = MODULUS - 2; exponent > 0; exponent >>= 1){
+        if(exponent & 1) result = multSymbol(result, x);
+        x = multSymbol(x, x);
+    }
+    return result;
+}
+
+static inline int parityOf(unsigned int x){
+    x ^= x >> 8;
+    x ^= x >> 4;
+    x ^= x >> 2;
+    x ^= x >> 1;
+    return x & 1;
+}
+
+static int hammingOf(const Symbol* points){
+    int hamming = 0;
+    for(int i = 0; i < EMBEDDED_POINTS; i++){
+        if(parityOf(points[i])) hamming ^= i;
+    }
+    return hamming;
+}
+
+static unsigned short crc16Byte(unsigned short crc, unsigned char byte){
+    crc ^= byte << 8;
+    for(int bit = 0; bit < 8; bit++){
+        crc = (crc & 0x8000) ? (crc << 1) ^ EMBEDDED_CRC16_POLYNOMIAL : crc << 1;
+    }
+    return crc;
+}
+
+// The CRC of the points is calculated as they were 32 bit little endian integers, like the
+// recuperation files have always done.
+static unsigned short crcOf(const Symbol* points){
+    unsigned short crc = EMBEDDED_CRC16_INITIAL;
+    for(int i = 0; i < EMBEDDED_POINTS; i++){
+        crc = crc16Byte(crc, points[i] & 0xFF);
+        crc = crc16Byte(crc, points[i] >> 8);
+        crc = crc16Byte(crc, 0);
+        crc = crc16Byte(crc, 0);
+    }
+    return crc;
+}
+
+/***************************************************************************************************
+ * INTERPOLATION
+ **************************************************************************************************/
+
+AlgorithmReturn initEmbeddedWorkspace(EmbeddedWorkspace* ws){
+    if(ws == 0) return INVALID_ARGUMENTS;
+
+    ws->trustParity = EEPROM_NOT_CORRUPTED;
+    ws->maxCombinations = 0;
+    for(int t = 0; t < EMBEDDED_POINTS; t++){
+        ws->nodeProduct[t] = 1;
+        for(int j = 0; j < EMBEDDED_POINTS; j++){
+            if(t == j){
+                ws->diff[t][j] = ws->invDiff[t][j] = 0;
+                continue;
+            }
+            ws->diff[t][j] = reduceMod(t + MODULUS - j);
+            ws->invDiff[t][j] = invertSymbol(ws->diff[t][j]);
+            ws->nodeProduct[t] = multSymbol(ws->nodeProduct[t], ws->diff[t][j]);
+        }
+        ws->weight[t] = invertSymbol(ws->nodeProduct[t]);
+    }
+    ws->initialized = EMBEDDED_MAGIC;
+    return WITHOUT_ERRORS;
+}
+
+// Prepares the interpolation through the points of ws->points on the bits of [subset].
+static void interpolateSubset(EmbeddedWorkspace* ws, unsigned int subset){
+    ws->subset = subset;
+    for(int j = 0; j < EMBEDDED_POINTS; j++){
+        if(!(subset & (1u << j))) continue;
+
+        Symbol weight = ws->weight[j];
+        for(int m = 0; m < EMBEDDED_POINTS; m++){
+            if(!(subset & (1u << m)) && m != j) weight = multSymbol(weight, ws->diff[j][m]);
+        }
+        ws->scaled[j] = multSymbol(weight, ws->points[j]);
+    }
+}
+
+// Value of the current interpolation on the point [t], which is not on its subset.
+static Symbol evaluateSubset(const EmbeddedWorkspace* ws, int t){
+    Symbol nodeProduct = ws->nodeProduct[t];
+    ModAcc acc = 0;
+    for(int m = 0; m < EMBEDDED_POINTS; m++){
+        if(ws->subset & (1u << m))  acc += (ModAcc) ws->scaled[m]*ws->invDiff[t][m];
+        else if(m != t)             nodeProduct = multSymbol(nodeProduct, ws->invDiff[t][m]);
+    }
+    return multSymbol(nodeProduct, reduceMod(acc));
+}
+
+/***************************************************************************************************
+ * SEARCH
+ **************************************************************************************************/
+
+// Same as checkPoints() of ReedSolomon.c.
+static AlgorithmReturn checkSubset(EmbeddedWorkspace* ws, unsigned int subset){
+    interpolateSubset(ws, subset);
+
+    int pointsNotOk = 0;
+    for(int i = 0; i < EMBEDDED_POINTS; i++){
+        if(subset & (1u << i)) continue;
+
+        ws->evals[i] = evaluateSubset(ws, i);
+        int pointNotOk = ws->evals[i] != ws->points[i];
+        if(ws->trustParity && pointNotOk && i >= EMBEDDED_FIRST_TRUSTED) return COULDNT_BE_FIXED;
+
+        pointsNotOk += pointNotOk;
+        if(pointsNotOk > NUM_FIXABLE_ERRORS) return COULDNT_BE_FIXED;
+    }
+    if(pointsNotOk == 0) return WITHOUT_ERRORS;
+
+    for(int i = 0; i <= EMBEDDED_POINTS; i++) ws->saved[i] = ws->points[i];
+    for(int i = 0; i < EMBEDDED_POINTS; i++){
+        if(!(subset & (1u << i))) ws->points[i] = ws->evals[i];
+    }
+
+    // The Hamming and CRC have to match the fixed points.
+    if(ws->trustParity &&
+       (hammingOf(ws->points) | (crcOf(ws->points) & 0xF0)) != ws->points[EMBEDDED_POINTS]){
+        for(int i = 0; i <= EMBEDDED_POINTS; i++) ws->points[i] = ws->saved[i];
+        return COULDNT_BE_FIXED;
+    }
+    return FIXED_OK;
+}
+
+// Checks, in lexicographic order, the combinations of points whose bits of [filterMask] are
+// [wantedMask], until one of them verifies or fixes the block.
+static AlgorithmReturn searchCombinations(EmbeddedWorkspace* ws, unsigned int filterMask,
+                                          unsigned int wantedMask){
+    int n = ws->trustParity ? EMBEDDED_FIRST_TRUSTED : EMBEDDED_POINTS;
+    int k = ws->trustParity ? EMBEDDED_TRUSTED_CHOSEN : EMBEDDED_LAGRANGE_POINTS;
+
+    // With trusted recuperation data, the points after n are always taken.
+    unsigned int fixedMask = 0;
+    for(int i = n; i < EMBEDDED_POINTS; i++) fixedMask |= 1u << i;
+
+    for(int i = 0; i < k; i++) ws->indices[i] = i;
+    for(;;){
+        unsigned int subset = fixedMask;
+        for(int i = 0; i < k; i++) subset |= 1u << ws->indices[i];
+
+        if((subset & filterMask) == wantedMask){
+            if(ws->maxCombinations > 0){
+                if(ws->combinationsLeft == 0) return EXCEEDS_WORK_BUDGET;
+                ws->combinationsLeft--;
+            }
+            AlgorithmReturn ret = checkSubset(ws, subset);
+            if(ret != COULDNT_BE_FIXED) return ret;
+        }
+
+        // Next combination: increase the last index that can be increased and reset the next ones.
+        int i = k - 1;
+        while(i >= 0 && ws->indices[i] == n - k + i) i--;
+        if(i < 0) return COULDNT_BE_FIXED;
+        ws->indices[i]++;
+        for(int j = i + 1; j < k; j++) ws->indices[j] = ws->indices[j-1] + 1;
+    }
+}
+
+// Same as verifyWithParity() of ReedSolomon.c, with the retries as a loop: every time the search
+// fails, the next extra point that could have been stored as a byte gets 256 more.
+static AlgorithmReturn verifyPoints(EmbeddedWorkspace* ws){
+    for(;;){
+        AlgorithmReturn ret;
+        int hamming = hammingOf(ws->points) ^ (ws->points[EMBEDDED_POINTS] & 0x0F);
+        if(ws->trustParity && hamming < EMBEDDED_FIRST_TRUSTED){
+            // Skip the point of the Hamming first, then the combinations with it.
+            ret = searchCombinations(ws, 1u << hamming, 0);
+            if(ret < 0 && ret != EXCEEDS_WORK_BUDGET){
+                unsigned int upToHamming = (2u << hamming) - 1;
+                ret = searchCombinations(ws, upToHamming, upToHamming);
+            }
+        }else{
+            ret = searchCombinations(ws, 0, 0);
+        }
+        if(ret >= 0 || ret == EXCEEDS_WORK_BUDGET) return ret;
+
+        int i = EMBEDDED_FIRST_TRUSTED;
+        while(i < EMBEDDED_POINTS && ws->points[i] + 256 >= MODULUS) i++;
+        if(i == EMBEDDED_POINTS) return ret;
+        ws->points[i] += 256;
+    }
+}
+
+/***************************************************************************************************
+ * BLOCKS
+ **************************************************************************************************/
+
+AlgorithmReturn embeddedEncodeBlock(EmbeddedWorkspace* ws, const unsigned char* data,
+                                    unsigned char* rec){
+    if(ws == 0 || ws->initialized != EMBEDDED_MAGIC || data == 0 || rec == 0){
+        return INVALID_ARGUMENTS;
+    }
+
+    unsigned int subset = 0;
+    for(int i = 0; i < EMBEDDED_LAGRANGE_POINTS; i++){
+        ws->points[i] = data[i];
+        subset |= 1u << i;
+    }
+    interpolateSubset(ws, subset);
+    for(int i = EMBEDDED_LAGRANGE_POINTS; i < EMBEDDED_POINTS; i++){
+        ws->points[i] = evaluateSubset(ws, i);
+    }
+
+    for(int i = EMBEDDED_LAGRANGE_POINTS; i < EMBEDDED_POINTS; i++){
+        rec[i - EMBEDDED_LAGRANGE_POINTS] = ws->points[i] & 0xFF;
+    }
+    rec[REC_BYTES_PER_BLOCK - 1] = hammingOf(ws->points) | (crcOf(ws->points) & 0xF0);
+    return WITHOUT_ERRORS;
+}
+
+AlgorithmReturn embeddedDecodeBlock(EmbeddedWorkspace* ws, unsigned char* data,
+                                    const unsigned char* rec, int* errorCount){
+    if(ws == 0 || ws->initialized != EMBEDDED_MAGIC || data == 0 || rec == 0){
+        return INVALID_ARGUMENTS;
+    }
+
+    for(int i = 0; i < EMBEDDED_LAGRANGE_POINTS; i++)  ws->points[i] = data[i];
+    for(int i = 0; i < REC_BYTES_PER_BLOCK; i++){
+        ws->points[EMBEDDED_LAGRANGE_POINTS + i] = rec[i];
+    }
+
+    ws->combinationsLeft = ws->maxCombinations;
+    AlgorithmReturn ret = verifyPoints(ws);
+    if(ret < 0){
+        if(errorCount != 0) *errorCount = -1;
+        return ret;
+    }
+
+    int errors = 0;
+    for(int i = 0; i < EMBEDDED_LAGRANGE_POINTS; i++){
+        errors += (ws->points[i] & 0xFF) != data[i];
+        data[i] = ws->points[i] & 0xFF;
+    }
+    for(int i = EMBEDDED_LAGRANGE_POINTS; i < EMBEDDED_POINTS; i++){
+        errors += (ws->points[i] & 0xFF) != rec[i - EMBEDDED_LAGRANGE_POINTS];
+    }
+    if(errorCount != 0) *errorCount = errors;
+    return ret;
+}
@@ -0,0 +1,93 @@
+/***************************************************************************************************
+ * @file EmbeddedCodec.h
+ * @brief Codec of a single block for microcontrollers: fixed footprint, no heap and no recursion.
+ *
+ * It encodes and decodes exactly like encodeBlock() and decodeBlock(), but everything it needs is
+ * on an EmbeddedWorkspace given by the caller, which can be static. It doesn't use VLAs, recursion,
+ * libc nor exit(): errors are returned as AlgorithmReturn codes. It only depends on
+ * CommonDefines.h and ModArith.h, so it can be built on its own with a freestanding compiler
+ * (see "make embedded", which also writes the stack usage of every function).
+ *
+ * Worst case, with NUM_POINTS_SAMPLE 10 and NUM_FIXABLE_ERRORS 2:
+ *  - Stack: 184 bytes for embeddedDecodeBlock(), 56 for embeddedEncodeBlock() and 64 for
+ *    initEmbeddedWorkspace() (gcc -Os on x86-64, the deepest chain of "make embedded"). The
+ *    workspace is 888 bytes more.
+ *  - Work: 440 combinations of points checked with trusted recuperation data and 572 without,
+ *    half of them only if an extra point was stored as 0 but could be 256. Each combination is an
+ *    interpolation and up to RS_MAX_POLY_DEGREE evaluations. [maxCombinations] bounds it further.
+ * "./reed --embedded-bench" measures the cycles and stack of each class of errors on the host.
+ *
+ * @version   1.0
+ * @date      2024-07-23
+ * @author    @dabecart
+ *
+ * @license
+ * This project is licensed under the MIT License - see the LICENSE file for details.
+ **************************************************************************************************/
+
+#ifndef EMBEDDED_CODEC_h
+#define EMBEDDED_CODEC_h
+
+#include "CommonDefines.h"
+
+/***************************************************************************************************
+ * DEFINES
+ **************************************************************************************************/
+
+// Points of a block: the data and the extra points.
+#define EMBEDDED_POINTS         (RS_MAX_POLY_DEGREE)
+
+// Value of [initialized] on a workspace ready to use.
+#define EMBEDDED_MAGIC          0x52534543
+
+/***************************************************************************************************
+ * TYPES
+ **************************************************************************************************/
+
+typedef unsigned short Symbol;
+
+typedef struct{
+    // Configuration, set to its defaults by initEmbeddedWorkspace(). If [trustParity] is 1, the
+    // recuperation data is taken as correct (like PARITY_TRUSTED). [maxCombinations] gives up
+    // with EXCEEDS_WORK_BUDGET after that many combinations of points, 0 means no limit.
+    int trustParity;
+    unsigned long maxCombinations;
+
+    // Tables of the grid x = 0, 1, 2... (see the barycentric interpolation of ReedSolomon.c).
+    Symbol diff[EMBEDDED_POINTS][EMBEDDED_POINTS];
+    Symbol invDiff[EMBEDDED_POINTS][EMBEDDED_POINTS];
+    Symbol nodeProduct[EMBEDDED_POINTS];
+    Symbol weight[EMBEDDED_POINTS];
+
+    // The block being decoded, followed by its Hamming and CRC, and a copy to restore it.
+    Symbol points[EMBEDDED_POINTS + 1];
+    Symbol saved[EMBEDDED_POINTS + 1];
+
+    // Interpolation of the current combination of points.
+    unsigned int subset;
+    Symbol scaled[EMBEDDED_POINTS];
+    Symbol evals[EMBEDDED_POINTS];
+    unsigned char indices[EMBEDDED_POINTS];
+
+    unsigned long combinationsLeft;
+    unsigned int initialized;
+} EmbeddedWorkspace;
+
+/***************************************************************************************************
+ * FUNCTIONS
+ **************************************************************************************************/
+
+// Builds the tables of [ws]. Returns INVALID_ARGUMENTS if it's NULL and WITHOUT_ERRORS otherwise.
+AlgorithmReturn initEmbeddedWorkspace(EmbeddedWorkspace* ws);
+
+// Same as encodeBlock(): writes the REC_BYTES_PER_BLOCK bytes of [rec] for the NUM_POINTS_SAMPLE
+// bytes of [data].
+AlgorithmReturn embeddedEncodeBlock(EmbeddedWorkspace* ws, const unsigned char* data,
+                                    unsigned char* rec);
+
+// Same as decodeBlock(): verifies and, if needed, fixes [data] in place. If [errorCount] is not
+// NULL, it gets the number of points fixed, or -1 if the block couldn't be fixed.
+AlgorithmReturn embeddedDecodeBlock(EmbeddedWorkspace* ws, unsigned char* data,
+                                    const unsigned char* rec, int* errorCount);
+
+#endif
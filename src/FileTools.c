@@ -10,183 +10,3017 @@
  * This project is licensed under the MIT License - see the LICENSE file for details.
  **************************************************************************************************/
 
+// Needed for copy_file_range().
+#define _GNU_SOURCE
+
+#include "Checkpoint.h"
+#include "Checksum.h"
+#include "ColumnParity.h"
 #include "FileTools.h"
+#include "Interleave.h"
+#include "Merkle.h"
+#include "ParityCache.h"
+#include "Pipeline.h"
+#include "RecTrailer.h"
+#include "RecoveryReport.h"
+#include "Throttle.h"
+#include <dirent.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <limits.h>
+#include <pthread.h>
+#include <stdarg.h>
+#include <sys/resource.h>
+#include <sys/stat.h>
+#include <time.h>
+#include <unistd.h>
+
+// Number of blocks read from the files on every iteration when verifying them.
+#define FILE_BUFFER_BLOCKS  4096
+
+// Number of chunks of FILE_BUFFER_BLOCKS that go around the pipeline.
+#define FILE_PIPELINE_CHUNKS 8
+
+// Size of the buffer used to write the fixed blocks to the output file.
+#define OUTPUT_BUFFER_SIZE  (64*1024)
+
+// Size of the buffer that holds the messages of the recuperation until they are printed.
+#define LOG_BUFFER_SIZE     (64*1024)
+
+// Size of the buffer used to read the files when computing their checksums.
+#define CHECKSUM_BUFFER_SIZE (1024*1024)
+
+/***************************************************************************************************
+ * STREAMS
+ **************************************************************************************************/
+
+// A filename of "-" stands for the standard input or output, so the files can be pipes.
+static inline int isStdStream(const char* filename){
+    return strcmp(filename, "-") == 0;
+}
+
+// Returns the size of [file] or -1 if it cannot be known (pipes and terminals).
+static long getFileSize(FILE* file){
+    long position = ftell(file);
+    if(position < 0 || fseek(file, 0, SEEK_END) != 0){
+        clearerr(file);
+        return -1;
+    }
+    long size = ftell(file);
+    fseek(file, position, SEEK_SET);
+    return size;
+}
+
+// Tells the kernel that [file] will be read from start to end, so it reads ahead aggressively.
+static void adviseSequential(FILE* file){
+#ifdef POSIX_FADV_SEQUENTIAL
+    posix_fadvise(fileno(file), 0, 0, POSIX_FADV_SEQUENTIAL);
+#endif
+}
+
+/***************************************************************************************************
+ * CHUNKS
+ **************************************************************************************************/
+
+// The files are read, processed and written in chunks, each one on its own thread (see Pipeline.h).
+typedef struct{
+    unsigned char data[FILE_BUFFER_BLOCKS*NUM_POINTS_SAMPLE];
+    // The blocks of data, one after the other, when the file is interleaved.
+    unsigned char interleaved[FILE_BUFFER_BLOCKS*NUM_POINTS_SAMPLE];
+    unsigned char rec[FILE_BUFFER_BLOCKS*REC_BYTES_PER_BLOCK];
+    AlgorithmReturn results[FILE_BUFFER_BLOCKS];
+
+    // Points fixed on every block and, if there's a report, histogram of the decoding times.
+    int errors[FILE_BUFFER_BLOCKS];
+    long timeHistogram[REPORT_TIME_BUCKETS];
+
+    // The same data read again, if there's a second read, and the reliability of every byte of the
+    // blocks (interleaved like them).
+    unsigned char secondRead[FILE_BUFFER_BLOCKS*NUM_POINTS_SAMPLE];
+    unsigned char reliability[FILE_BUFFER_BLOCKS*NUM_POINTS_SAMPLE];
+    int hasReliability;
+
+    // Column parity of the groups of the chunk and the number of blocks recuperated with it.
+    unsigned char columns[FILE_BUFFER_BLOCKS/COLUMN_MIN_GROUP*COLUMN_MAX_PARITY*NUM_POINTS_SAMPLE];
+    long columnsFixed;
+
+    // Bytes of data read, without the padding of the last block.
+    size_t dataLength;
+    long blocks;
+
+    // The recuperation file didn't have the same number of blocks as the data on this chunk.
+    int misaligned;
+
+    // Index of the first block of the chunk on the file.
+    long firstBlock;
+    // The integrity index says that the whole chunk is OK, so it wasn't even read.
+    int verified;
+    // The chunk was already encoded before resuming the job. It's only read again for the 
+    // integrity index and the column parity.
+    int replayed;
+} FileChunk;
+
+// Reads the data of the next chunk, up to [maxBlocks] blocks. Returns the number of blocks read.
+static long readDataChunk(FileChunk* chunk, FILE* inputFile, long maxBlocks){
+    chunk->dataLength = fread(chunk->data, 1, maxBlocks*NUM_POINTS_SAMPLE, inputFile);
+    chunk->blocks = (chunk->dataLength + NUM_POINTS_SAMPLE - 1)/NUM_POINTS_SAMPLE;
+    chunk->misaligned = 0;
+    chunk->verified = 0;
+
+    // The last block of the file gets padded.
+    memset(chunk->data + chunk->dataLength, PADDING_BYTE, 
+           chunk->blocks*NUM_POINTS_SAMPLE - chunk->dataLength);
+    return chunk->blocks;
+}
+
+static FileChunk* allocateChunks(){
+    FileChunk* chunks = malloc(FILE_PIPELINE_CHUNKS*sizeof(FileChunk));
+    if(chunks == NULL){
+        perror("Error allocating the file buffers");
+        exit(-1);
+    }
+    return chunks;
+}
+
+/***************************************************************************************************
+ * INTERLEAVING
+ **************************************************************************************************/
+
+// Interleave depth of the new recuperation files. 1 means no interleaving.
+static long interleaveDepth = 1;
+
+void setInterleaveDepth(long depth){
+    if(depth < 1) depth = 1;
+    if(depth > INTERLEAVE_MAX_DEPTH) depth = INTERLEAVE_MAX_DEPTH;
+    interleaveDepth = depth;
+}
+
+// Number of blocks that hold whole groups of the interleaving and of the column parity. Returns 0
+// if they don't fit on a chunk.
+static long layoutUnit(long depth, long columnGroup){
+    long a = depth, b = columnGroup > 1 ? columnGroup : 1;
+    while(b != 0){
+        long rest = a % b;
+        a = b;
+        b = rest;
+    }
+    long unit = depth/a*(columnGroup > 1 ? columnGroup : 1);
+    return unit <= FILE_BUFFER_BLOCKS ? unit : 0;
+}
+
+// Blocks per chunk, so every chunk holds whole units of the layout.
+static long chunkBlocksFor(long unit){
+    return FILE_BUFFER_BLOCKS - FILE_BUFFER_BLOCKS % unit;
+}
+
+// Returns the position on the file of the first point of [block].
+static long blockFilePosition(long block, long depth){
+    return (block - block % depth)*NUM_POINTS_SAMPLE + block % depth;
+}
+
+// Returns the interleave depth stored on [trailer] or [fallback] if there's none.
+static long trailerInterleaveDepth(const RecTrailer* trailer, long fallback){
+    const TrailerSection* section = findTrailerSection(trailer, INTERLEAVE_SECTION_TAG);
+    if(section == NULL || section->length < 4) return fallback;
+
+    long depth = getU32(section->payload);
+    return (depth >= 1 && depth <= INTERLEAVE_MAX_DEPTH) ? depth : fallback;
+}
+
+/***************************************************************************************************
+ * COLUMN PARITY
+ **************************************************************************************************/
+
+// Size of the groups and parity rows of the column parity of the new recuperation files. A group of
+// 0 disables it.
+static long columnGroup = 0;
+static long columnParity = 0;
+
+void setColumnParity(long group, long parity){
+    columnGroup = group;
+    columnParity = parity;
+}
+
+// Reads the column parity of [trailer] for a file of [totalBlocks] blocks. If there's none or it 
+// doesn't belong to the file, [columns->data] is NULL.
+static void loadColumnParity(const RecTrailer* trailer, long totalBlocks, long depth, 
+                             ColumnParity* columns){
+    memset(columns, 0, sizeof(ColumnParity));
+    const TrailerSection* section = findTrailerSection(trailer, COLUMN_SECTION_TAG);
+    if(section == NULL || deserializeColumnParity(section, columns) < 0) return;
+
+    if(columns->numGroups != (totalBlocks + columns->group - 1)/columns->group || 
+       layoutUnit(depth, columns->group) == 0){
+        freeColumnParity(columns);
+    }
+}
+
+// Recuperates the blocks that couldn't be fixed (or exceeded the budget) on the [numBlocks] blocks 
+// of [blocks] with the column parity, taking them as erasures. [firstBlock] is the index of the 
+// first one on the file, which starts a group. A block is only accepted if the spare parity rows 
+// or its own recuperation data confirm it. If [errors] is not NULL, it gets the number of bytes that 
+// changed on every recuperated block. Returns the number of blocks recuperated.
+static long repairWithColumns(const ColumnParity* columns, long firstBlock, unsigned char* blocks, 
+                              const unsigned char* rec, AlgorithmReturn* results, int* errors,
+                              long numBlocks){
+    if(columns->data == NULL) return 0;
+
+    long recuperated = 0;
+    for(long first = 0; first < numBlocks; first += columns->group){
+        long rows = numBlocks - first < columns->group ? numBlocks - first : columns->group;
+
+        long erased[COLUMN_MAX_PARITY];
+        int numErased = 0;
+        for(long row = 0; row < rows && numErased <= columns->parity; row++){
+            if(results[first + row] >= 0) continue;
+            if(numErased < columns->parity) erased[numErased] = row;
+            numErased++;
+        }
+        if(numErased == 0 || numErased > columns->parity) continue;
+
+        unsigned char* group = blocks + first*NUM_POINTS_SAMPLE;
+        unsigned char saved[COLUMN_MAX_PARITY][NUM_POINTS_SAMPLE];
+        for(int t = 0; t < numErased; t++){
+            memcpy(saved[t], group + erased[t]*NUM_POINTS_SAMPLE, NUM_POINTS_SAMPLE);
+        }
+
+        const unsigned char* parityRows = columns->data + 
+            (firstBlock + first)/columns->group*columnGroupBytes(columns->parity);
+        int ret = decodeColumns(group, rows, parityRows, columns->parity, erased, numErased);
+
+        for(int t = 0; t < numErased; t++){
+            unsigned char* block = group + erased[t]*NUM_POINTS_SAMPLE;
+            unsigned char expected[REC_BYTES_PER_BLOCK];
+            encodeBlock(block, expected);
+            if(ret == 1 || (ret == 0 && memcmp(expected, rec + (first + erased[t])*REC_BYTES_PER_BLOCK, 
+                                               REC_BYTES_PER_BLOCK) == 0)){
+                results[first + erased[t]] = FIXED_OK;
+                if(errors != NULL){
+                    errors[first + erased[t]] = 0;
+                    for(int j = 0; j < NUM_POINTS_SAMPLE; j++){
+                        errors[first + erased[t]] += block[j] != saved[t][j];
+                    }
+                }
+                recuperated++;
+            }else{
+                memcpy(block, saved[t], NUM_POINTS_SAMPLE);
+            }
+        }
+    }
+    return recuperated;
+}
+
+/***************************************************************************************************
+ * INTEGRITY INDEX
+ **************************************************************************************************/
+
+// Blocks of every region of the integrity index. 0 disables the index.
+static long indexRegionBlocks = 0;
+
+void setIntegrityIndex(long regionBlocks){
+    indexRegionBlocks = regionBlocks > 0 ? regionBlocks : 0;
+}
+
+// Regions of the data file that don't match the integrity index of its recuperation file.
+typedef struct{
+    // One byte per region, NULL if there's no usable index.
+    unsigned char* damaged;
+    long regionBlocks;
+    long numRegions;
+    long numDamaged;
+} DamagedRegions;
+
+// Reads the integrity index of [trailer] and compares it with [inputFile], leaving the file at its 
+// start. If the index is missing, damaged or belongs to another file, [regions->damaged] is NULL 
+// and every block has to be verified.
+static void loadIntegrityIndex(FILE* inputFile, long inputFilesize, const RecTrailer* trailer,
+                               FILE* log, DamagedRegions* regions){
+    memset(regions, 0, sizeof(DamagedRegions));
+    const TrailerSection* section = findTrailerSection(trailer, MERKLE_SECTION_TAG);
+    if(section == NULL || inputFilesize < 0) return;
+
+    MerkleTree stored, computed;
+    if(deserializeMerkleTree(section, &stored) < 0){
+        fprintf(log, "The integrity index is malformed, verifying every block.\n");
+        return;
+    }
+    if(!isMerkleTreeConsistent(&stored) || stored.dataLength != inputFilesize){
+        fprintf(log, "The integrity index is damaged or doesn't belong to this file, verifying "
+                     "every block.\n");
+        freeMerkleTree(&stored);
+        return;
+    }
+
+    if(initMerkleTree(&computed, inputFilesize, stored.regionBlocks) < 0 || 
+       (regions->damaged = malloc(stored.numLeaves)) == NULL){
+        perror("Error allocating the integrity index");
+        exit(-1);
+    }
+
+    // A single pass that only hashes the data. The Reed-Solomon verification only runs on the 
+    // regions that don't match.
+    if(hashMerkleFile(&computed, inputFile) < 0){
+        free(regions->damaged);
+        regions->damaged = NULL;
+    }else{
+        regions->regionBlocks = stored.regionBlocks;
+        regions->numRegions = stored.numLeaves;
+        regions->numDamaged = diffMerkleTrees(&stored, &computed, regions->damaged);
+        fprintf(log, "Integrity index: %ld of %ld regions damaged.\n", 
+                regions->numDamaged, regions->numRegions);
+    }
+    fseek(inputFile, 0, SEEK_SET);
+
+    freeMerkleTree(&stored);
+    freeMerkleTree(&computed);
+}
+
+// Returns 1 if the [blocks] blocks starting at [firstBlock] are inside of regions that match the 
+// integrity index.
+static int areBlocksVerified(const DamagedRegions* regions, long firstBlock, long blocks){
+    if(regions->damaged == NULL || blocks <= 0) return 0;
+    long last = (firstBlock + blocks - 1)/regions->regionBlocks;
+    for(long region = firstBlock/regions->regionBlocks; region <= last; region++){
+        if(region >= regions->numRegions || regions->damaged[region]) return 0;
+    }
+    return 1;
+}
+
+// Reads what's left of a recuperation stream after its data. Returns 1 if it's empty or a valid 
+// trailer, so the stream belongs to the data that was read.
+static int isTrailerLeft(FILE* recFile){
+    size_t length = 0, capacity = 0;
+    unsigned char* bytes = NULL;
+    for(;;){
+        if(length == capacity){
+            capacity = capacity ? 2*capacity : 4096;
+            unsigned char* grown = realloc(bytes, capacity);
+            if(grown == NULL) break;
+            bytes = grown;
+        }
+        size_t readBytes = fread(bytes + length, 1, capacity - length, recFile);
+        if(readBytes == 0) break;
+        length += readBytes;
+    }
+
+    RecTrailer trailer;
+    int valid = length == 0 || parseRecTrailer(bytes, length, &trailer) == 0;
+    free(bytes);
+    return valid;
+}
+
+/***************************************************************************************************
+ * CHECKPOINTS
+ **************************************************************************************************/
+
+// File where the jobs save their progress, NULL if they don't.
+static const char* checkpointFilename = NULL;
+static long checkpointInterval = CHECKPOINT_DEFAULT_INTERVAL;
+static int resumeFromCheckpoint = 0;
+
+void setCheckpoint(const char* filename, long intervalSeconds){
+    checkpointFilename = filename;
+    checkpointInterval = intervalSeconds >= 0 ? intervalSeconds : CHECKPOINT_DEFAULT_INTERVAL;
+}
+
+void setResume(int resume){
+    resumeFromCheckpoint = resume;
+}
+
+// Returns 1 if it's time for another checkpoint, restarting the count if so.
+static int isCheckpointDue(struct timespec* last){
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    if(now.tv_sec - last->tv_sec < checkpointInterval) return 0;
+    *last = now;
+    return 1;
+}
+
+// Continues [crc] with the [length] bytes of [fd] starting at [offset]. Returns -1 if they cannot
+// be read.
+static int crcFileRange(int fd, long offset, long length, unsigned int* crc){
+    unsigned char buffer[OUTPUT_BUFFER_SIZE];
+    while(length > 0){
+        size_t chunk = length < OUTPUT_BUFFER_SIZE ? length : OUTPUT_BUFFER_SIZE;
+        ssize_t readBytes = pread(fd, buffer, chunk, offset);
+        if(readBytes < 0 && errno == EINTR) continue;
+        if(readBytes <= 0) return -1;
+        *crc = crc32c(*crc, buffer, readBytes);
+        offset += readBytes;
+        length -= readBytes;
+    }
+    return 0;
+}
+
+// Looks for a checkpoint of the same job as [job] to resume it. The input, [inputFd], and the 
+// recuperation file, [recFd] (-1 if the job only writes it), must still have what was read of them 
+// then, or the job is refused. The output, [outputFd], must still have the contents it had then; it
+// gets cut right after them. Returns 1 if the job is resumed (with its progress on [job]), 0 if it 
+// starts from the beginning and -1 on error.
+static int loadCheckpoint(Checkpoint* job, int inputFd, int recFd, int outputFd, FILE* log){
+    if(checkpointFilename == NULL || !resumeFromCheckpoint) return 0;
+
+    // Whatever was on the output is thrown away if the job starts again.
+    Checkpoint saved;
+    if(readCheckpoint(checkpointFilename, &saved) < 0){
+        fprintf(log, "No checkpoint on %s, starting from the beginning.\n", checkpointFilename);
+        return ftruncate(outputFd, 0) < 0 ? -1 : 0;
+    }
+
+    // Resuming on other files or with other options would mix two jobs on the output.
+    if(!sameCheckpointJob(&saved, job)){
+        fprintf(log, "The checkpoint on %s was made with other options, not resuming. Remove it to "
+                     "start from the beginning.\n", checkpointFilename);
+        exit(-1);
+    }
+    unsigned int inputCrc = 0, recCrc = 0;
+    if(crcFileRange(inputFd, 0, saved.inputPosition, &inputCrc) < 0 || inputCrc != saved.inputCrc ||
+       (recFd >= 0 && (crcFileRange(recFd, 0, saved.recPosition, &recCrc) < 0 || 
+                       recCrc != saved.recCrc))){
+        fprintf(log, "The checkpoint on %s was made with other files, not resuming. Remove it to "
+                     "start from the beginning.\n", checkpointFilename);
+        exit(-1);
+    }
+
+    unsigned int crc = 0;
+    if(crcFileRange(outputFd, 0, saved.outputPosition, &crc) < 0 || crc != saved.outputCrc || 
+       ftruncate(outputFd, saved.outputPosition) < 0){
+        fprintf(log, "The output of the checkpoint on %s changed, starting from the beginning.\n", 
+                checkpointFilename);
+        return ftruncate(outputFd, 0) < 0 ? -1 : 0;
+    }
+
+    *job = saved;
+    fprintf(log, "Resuming from block %ld (0x%08lX).\n", job->blocks, job->inputPosition);
+    return 1;
+}
+
+// Makes sure everything before the checkpoint is on the disk and then saves it.
+static int saveCheckpoint(const Checkpoint* checkpoint, int outputFd){
+    if(fsync(outputFd) < 0 && errno != EINVAL) return -1;
+    return writeCheckpoint(checkpointFilename, checkpoint);
+}
+
+/***************************************************************************************************
+ * FILE REPARATION
+ **************************************************************************************************/
+
+// Number of entries of the parity cache of each worker. 0 disables the cache.
+static long encodeCacheEntries = 0;
+
+void setEncodeCacheSize(long entries){
+    encodeCacheEntries = entries > 0 ? entries : 0;
+}
+
+typedef struct{
+    FILE* inputFile;
+    FILE* outputFile;
+    FILE* log;
+    long fileSize;
+    long filePosition;
+    int showProgress;
+
+    // One cache per worker, so they don't need any locking.
+    int useCache;
+    ParityCache caches[PIPELINE_MAX_WORKERS];
+
+    long depth;
+    long chunkBlocks;
+
+    // Column parity of the file, collected by the writer.
+    ColumnParity columns;
+    long columnsCapacity;
+
+    // Hashes of the regions of the integrity index, computed by the writer.
+    long regionBytes;
+    long regionFill;
+    MerkleHash regionHash;
+    MerkleHash* leaves;
+    long numLeaves;
+    long leavesCapacity;
+
+    // Progress saved on the checkpoints, updated by the writer. The chunks before [resumeBlocks]
+    // were encoded before resuming.
+    Checkpoint checkpoint;
+    struct timespec lastCheckpoint;
+    long resumeBlocks;
+    // Only used by the reader.
+    long readBlocks;
+} EncodeContext;
+
+static int readEncodeChunk(void* chunk, void* context){
+    EncodeContext* ctx = context;
+    FileChunk* c = chunk;
+    c->firstBlock = ctx->readBlocks;
+    c->replayed = c->firstBlock < ctx->resumeBlocks;
+    ctx->readBlocks += readDataChunk(c, ctx->inputFile, ctx->chunkBlocks);
+    return c->blocks > 0;
+}
+
+static void processEncodeChunk(void* chunk, void* context, int worker){
+    EncodeContext* ctx = context;
+    FileChunk* c = chunk;
+
+    // The data stays as it is on the file for the integrity index.
+    const unsigned char* blocks = c->data;
+    if(ctx->depth > 1){
+        interleaveBlocks(c->data, c->interleaved, c->blocks, ctx->depth);
+        blocks = c->interleaved;
+    }
+
+    for(long i = c->replayed ? c->blocks : 0; i < c->blocks; ){
+        if(ctx->useCache){
+            encodeBlockCached(&ctx->caches[worker], blocks + i*NUM_POINTS_SAMPLE, 
+                              c->rec + i*REC_BYTES_PER_BLOCK);
+        }else{
+            encodeBlock(blocks + i*NUM_POINTS_SAMPLE, c->rec + i*REC_BYTES_PER_BLOCK);
+        }
+
+        // Runs of the same uniform block (erased FLASH, paddings...) get the same recuperation data.
+        long uniform = countUniformBlocks(blocks + i*NUM_POINTS_SAMPLE, NULL, c->blocks - i);
+        for(long j = 1; j < uniform; j++){
+            memcpy(c->rec + (i + j)*REC_BYTES_PER_BLOCK, c->rec + i*REC_BYTES_PER_BLOCK, 
+                   REC_BYTES_PER_BLOCK);
+        }
+        i += uniform > 1 ? uniform : 1;
+    }
+
+    if(ctx->columns.group > 0){
+        encodeColumns(blocks, c->blocks, ctx->columns.group, ctx->columns.parity, c->columns);
+    }
+}
+
+// Adds the column parity of [c] to the one of the file.
+static int collectColumns(EncodeContext* ctx, const FileChunk* c){
+    ColumnParity* columns = &ctx->columns;
+    long groups = (c->blocks + columns->group - 1)/columns->group;
+    long groupBytes = columnGroupBytes(columns->parity);
+
+    if((columns->numGroups + groups)*groupBytes > ctx->columnsCapacity){
+        long capacity = ctx->columnsCapacity ? 2*ctx->columnsCapacity : 64*1024;
+        while(capacity < (columns->numGroups + groups)*groupBytes) capacity *= 2;
+        unsigned char* data = realloc(columns->data, capacity);
+        if(data == NULL) return -1;
+        columns->data = data;
+        ctx->columnsCapacity = capacity;
+    }
+    memcpy(columns->data + columns->numGroups*groupBytes, c->columns, groups*groupBytes);
+    columns->numGroups += groups;
+    return 0;
+}
+
+// Adds the region being hashed to the leaves of the integrity index.
+static int closeIndexRegion(EncodeContext* ctx){
+    if(ctx->numLeaves == ctx->leavesCapacity){
+        long capacity = ctx->leavesCapacity ? 2*ctx->leavesCapacity : 1024;
+        MerkleHash* leaves = realloc(ctx->leaves, capacity*sizeof(MerkleHash));
+        if(leaves == NULL) return -1;
+        ctx->leaves = leaves;
+        ctx->leavesCapacity = capacity;
+    }
+    ctx->leaves[ctx->numLeaves++] = ctx->regionHash;
+    ctx->regionHash = MERKLE_HASH_SEED;
+    ctx->regionFill = 0;
+    return 0;
+}
+
+// Hashes the data of [c]. The regions don't need to be aligned with the chunks.
+static int hashIndexRegions(EncodeContext* ctx, const FileChunk* c){
+    for(size_t position = 0; position < c->dataLength; ){
+        size_t length = ctx->regionBytes - ctx->regionFill;
+        if(length > c->dataLength - position) length = c->dataLength - position;
+
+        ctx->regionHash = hashBytes(ctx->regionHash, c->data + position, length);
+        ctx->regionFill += length;
+        position += length;
+        if(ctx->regionFill == ctx->regionBytes && closeIndexRegion(ctx) < 0) return -1;
+    }
+    return 0;
+}
+
+// Builds the tree of the integrity index from the leaves hashed by the writer.
+static int buildIntegrityIndex(EncodeContext* ctx, MerkleTree* tree){
+    // The last region can be shorter. An empty file still has one region.
+    if((ctx->regionFill > 0 || ctx->numLeaves == 0) && closeIndexRegion(ctx) < 0) return -1;
+
+    if(initMerkleTree(tree, ctx->filePosition, indexRegionBlocks) < 0) return -1;
+    memcpy(tree->nodes, ctx->leaves, tree->numLeaves*sizeof(MerkleHash));
+    buildMerkleTree(tree);
+    return 0;
+}
+
+// Writes the trailer of a recuperation file with an interleave [depth], its [columns] (if they 
+// have a group) and its integrity [index] (if not NULL), if there's anything to put on it.
+static int writeLayoutTrailer(FILE* out, long depth, const ColumnParity* columns, 
+                              const MerkleTree* index){
+    TrailerSection sections[3];
+    int numSections = 0;
+
+    unsigned char depthBytes[4];
+    if(depth > 1){
+        putU32(depthBytes, depth);
+        memcpy(sections[numSections].tag, INTERLEAVE_SECTION_TAG, 4);
+        sections[numSections].length = sizeof(depthBytes);
+        sections[numSections++].payload = depthBytes;
+    }
+
+    unsigned char* columnBytes = NULL;
+    if(columns->group > 0){
+        if(serializeColumnParity(columns, &sections[numSections]) < 0) return -1;
+        columnBytes = sections[numSections++].payload;
+    }
+
+    unsigned char* indexBytes = NULL;
+    if(index != NULL){
+        if(serializeMerkleTree(index, &sections[numSections]) < 0){
+            free(columnBytes);
+            return -1;
+        }
+        indexBytes = sections[numSections++].payload;
+    }
+
+    int ret = numSections > 0 ? writeRecTrailer(out, sections, numSections) : 0;
+    free(columnBytes);
+    free(indexBytes);
+    return ret;
+}
+
+// Writes the trailer at the end of the recuperation file.
+static int writeEncodeTrailer(EncodeContext* ctx){
+    MerkleTree index;
+    if(ctx->regionBytes > 0 && buildIntegrityIndex(ctx, &index) < 0) return -1;
+
+    int ret = writeLayoutTrailer(ctx->outputFile, ctx->depth, &ctx->columns, 
+                                 ctx->regionBytes > 0 ? &index : NULL);
+    if(ctx->regionBytes > 0) freeMerkleTree(&index);
+    return ret;
+}
+
+static int writeEncodeChunk(void* chunk, void* context){
+    EncodeContext* ctx = context;
+    FileChunk* c = chunk;
+
+    if(ctx->showProgress) printLoadingBar(ctx->filePosition, ctx->fileSize);
+    if(!c->replayed && 
+       fwrite(c->rec, REC_BYTES_PER_BLOCK, c->blocks, ctx->outputFile) != (size_t) c->blocks){
+        return -1;
+    }
+    if(ctx->regionBytes > 0 && hashIndexRegions(ctx, c) < 0) return -1;
+    if(ctx->columns.group > 0 && collectColumns(ctx, c) < 0) return -1;
+    ctx->filePosition += c->dataLength;
+    if(c->replayed || checkpointFilename == NULL) return 0;
+
+    Checkpoint* checkpoint = &ctx->checkpoint;
+    checkpoint->inputCrc = crc32c(checkpoint->inputCrc, c->data, c->dataLength);
+    checkpoint->outputCrc = crc32c(checkpoint->outputCrc, c->rec, c->blocks*REC_BYTES_PER_BLOCK);
+    checkpoint->blocks += c->blocks;
+    checkpoint->inputPosition = ctx->filePosition;
+    checkpoint->outputPosition += c->blocks*REC_BYTES_PER_BLOCK;
+    if(!isCheckpointDue(&ctx->lastCheckpoint)) return 0;
+    return fflush(ctx->outputFile) == 0 ? saveCheckpoint(checkpoint, fileno(ctx->outputFile)) : -1;
+}
+
+// Continues the encoding saved on the checkpoint, if there's one. The chunks before it are read 
+// again only if the integrity index or the column parity need them.
+static void resumeEncoding(EncodeContext* ctx){
+    ctx->checkpoint = (Checkpoint){
+        .kind = CHECKPOINT_ENCODE,
+        .inputSize = ctx->fileSize,
+        .depth = ctx->depth,
+        .columnGroup = ctx->columns.group,
+        .columnParity = ctx->columns.parity,
+        .regionBlocks = indexRegionBlocks,
+        .parityPolicy = getParityPolicy(),
+    };
+    clock_gettime(CLOCK_MONOTONIC, &ctx->lastCheckpoint);
+
+    int resumed = loadCheckpoint(&ctx->checkpoint, fileno(ctx->inputFile), -1, 
+                                 fileno(ctx->outputFile), ctx->log);
+    if(resumed < 0 || (resumed && fseek(ctx->outputFile, ctx->checkpoint.outputPosition, SEEK_SET) < 0)){
+        perror("Error resuming the output file");
+        exit(-1);
+    }
+    if(!resumed) return;
+
+    ctx->resumeBlocks = ctx->checkpoint.blocks;
+    if(ctx->regionBytes == 0 && ctx->columns.group == 0){
+        if(fseek(ctx->inputFile, ctx->checkpoint.inputPosition, SEEK_SET) < 0){
+            perror("Error resuming the input file");
+            exit(-1);
+        }
+        ctx->readBlocks = ctx->checkpoint.blocks;
+        ctx->filePosition = ctx->checkpoint.inputPosition;
+    }
+}
+
+void createRecuperationFile(const char* filename, const char* out){
+    if(checkpointFilename != NULL && (isStdStream(filename) || isStdStream(out))){
+        printf("Checkpoints need files, not streams.\n");
+        exit(-1);
+    }
+
+    FILE* inputFile = isStdStream(filename) ? stdin : fopen(filename, "rb");
+    if (inputFile == NULL) {
+        printf("File %s. ", filename);
+        fflush(stdout);
+        perror("Error message");
+        exit(-1);
+    }
+
+    // When resuming, the output keeps what was written before the checkpoint.
+    FILE* outputFile = NULL;
+    if(checkpointFilename != NULL && resumeFromCheckpoint) outputFile = fopen(out, "r+b");
+    if(outputFile == NULL) outputFile = isStdStream(out) ? stdout : fopen(out, "wb");
+    if (outputFile == NULL) {
+        printf("File %s. ", out);
+        fflush(stdout);
+        perror("Error creating output file");
+        fclose(inputFile);
+        exit(-1);
+    }
+    adviseSequential(inputFile);
+
+    // When the recuperation data goes to the standard output, the messages go to the error output.
+    EncodeContext ctx = {
+        .inputFile = inputFile,
+        .outputFile = outputFile,
+        .log = (outputFile == stdout) ? stderr : stdout,
+        .fileSize = getFileSize(inputFile),
+        .depth = interleaveDepth,
+        .columns = {.group = columnGroup, .parity = columnParity},
+        .regionBytes = indexRegionBlocks*NUM_POINTS_SAMPLE,
+        .regionHash = MERKLE_HASH_SEED,
+    };
+    ctx.showProgress = ctx.log == stdout && ctx.fileSize > 0;
+
+    long unit = layoutUnit(ctx.depth, ctx.columns.group);
+    if(unit == 0){
+        fprintf(ctx.log, "The groups of the interleaving (%ld) and the column parity (%ld) need more "
+                "than %d blocks together.\n", ctx.depth, ctx.columns.group, FILE_BUFFER_BLOCKS);
+        exit(-1);
+    }
+    ctx.chunkBlocks = chunkBlocksFor(unit);
+    if(checkpointFilename != NULL) resumeEncoding(&ctx);
+
+    // The file is read sequentially, so it works the same with pipes as with files.
+    FileChunk* chunks = allocateChunks();
+    Pipeline pipeline = {
+        .chunks = chunks,
+        .chunkSize = sizeof(FileChunk),
+        .numChunks = FILE_PIPELINE_CHUNKS,
+        .workers = defaultPipelineWorkers(),
+        .read = readEncodeChunk,
+        .process = processEncodeChunk,
+        .write = writeEncodeChunk,
+        .context = &ctx,
+    };
+    ctx.useCache = encodeCacheEntries > 0;
+    for(int i = 0; ctx.useCache && i < pipeline.workers; i++){
+        if(initParityCache(&ctx.caches[i], encodeCacheEntries) < 0){
+            perror("Error allocating the parity cache");
+            exit(-1);
+        }
+    }
+
+    if(runPipeline(&pipeline) < 0 || writeEncodeTrailer(&ctx) < 0){
+        fprintf(ctx.log, "\nThe program is not writing properly.\n");
+        fclose(inputFile);
+        fclose(outputFile);
+        exit(-1);
+    }
+    free(chunks);
+    free(ctx.leaves);
+    freeColumnParity(&ctx.columns);
+    if(ctx.showProgress) printLoadingBar(ctx.fileSize, ctx.fileSize);
+
+    int completed = 0;
+    if(!ferror(inputFile) && (ctx.fileSize < 0 || ctx.filePosition >= ctx.fileSize)){
+        fprintf(ctx.log, "\nFile completely error proofed! %s -> %s\n", filename, out);
+        completed = 1;
+    }else{
+        fprintf(ctx.log, "\nFile wasn't completely processed!\n");
+    }
+
+    if(ctx.useCache){
+        long hits = 0, misses = 0;
+        for(int i = 0; i < pipeline.workers; i++){
+            hits += ctx.caches[i].hits;
+            misses += ctx.caches[i].misses;
+            freeParityCache(&ctx.caches[i]);
+        }
+        fprintf(ctx.log, "Parity cache: %ld hits of %ld blocks (%0.2f%%).\n", 
+                hits, hits + misses, hits + misses ? 100.0*hits/(hits + misses) : 0.0);
+    }
+
+    fclose(inputFile);
+    // The job is done, there's nothing left to resume.
+    if(fclose(outputFile) == 0 && completed && checkpointFilename != NULL){
+        remove(checkpointFilename);
+    }
+}
+
+/***************************************************************************************************
+ * LOG BUFFER
+ **************************************************************************************************/
+
+// The messages of the blocks that couldn't be fixed are gathered here and written in one go, so 
+// the log is not written block by block.
+typedef struct{
+    FILE* out;
+    char text[LOG_BUFFER_SIZE];
+    size_t length;
+} LogBuffer;
+
+static void flushLog(LogBuffer* log){
+    fwrite(log->text, 1, log->length, log->out);
+    fflush(log->out);
+    log->length = 0;
+}
+
+static void bufferedLog(LogBuffer* log, const char* format, ...){
+    va_list args;
+    va_start(args, format);
+    int length = vsnprintf(log->text + log->length, LOG_BUFFER_SIZE - log->length, format, args);
+    va_end(args);
+    if(length < 0 || log->length + length < LOG_BUFFER_SIZE){
+        if(length > 0) log->length += length;
+        return;
+    }
+
+    // It didn't fit: write what was there and try again on the empty buffer.
+    flushLog(log);
+    va_start(args, format);
+    length = vsnprintf(log->text, LOG_BUFFER_SIZE, format, args);
+    va_end(args);
+    log->length = length < LOG_BUFFER_SIZE ? length : LOG_BUFFER_SIZE - 1;
+}
+
+/***************************************************************************************************
+ * OUTPUT WRITER
+ **************************************************************************************************/
+
+// Writes the output of recuperateFile(). Runs of data that didn't need any fix are copied straight 
+// from the input file with copy_file_range(), which can even skip the copy if the filesystem 
+// supports reflinks. Only the fixed blocks go through user space.
+typedef struct{
+    // If the input is a stream, this is -1 and everything is written from the buffer.
+    int inputFd;
+    int outputFd;
+    int useCopyRange;
+
+    // Run of unchanged data pending to be copied from the input file. It always goes after the 
+    // contents of the buffer.
+    long cleanOffset;
+    long cleanLength;
+
+    // Fixed data pending to be written.
+    unsigned char buffer[OUTPUT_BUFFER_SIZE];
+    size_t bufferLength;
+} OutputWriter;
+
+static int writeAll(int fd, const unsigned char* data, size_t length){
+    while(length > 0){
+        ssize_t written = write(fd, data, length);
+        if(written < 0){
+            if(errno == EINTR) continue;
+            return -1;
+        }
+        data += written;
+        length -= written;
+    }
+    return 0;
+}
+
+// Same as writeAll(), at [offset] of the file.
+static int pwriteAll(int fd, const unsigned char* data, size_t length, long offset){
+    while(length > 0){
+        ssize_t written = pwrite(fd, data, length, offset);
+        if(written < 0 && errno == EINTR) continue;
+        if(written <= 0) return -1;
+        data += written;
+        offset += written;
+        length -= written;
+    }
+    return 0;
+}
+
+// Reads [length] bytes at [offset] of the file. Returns the number of bytes read, which is less 
+// only if the file ends before, or -1 on error.
+static long preadAll(int fd, unsigned char* data, size_t length, long offset){
+    size_t total = 0;
+    while(total < length){
+        ssize_t readBytes = pread(fd, data + total, length - total, offset + total);
+        if(readBytes < 0 && errno == EINTR) continue;
+        if(readBytes < 0) return -1;
+        if(readBytes == 0) break;
+        total += readBytes;
+    }
+    return total;
+}
+
+static int flushOutputBuffer(OutputWriter* writer){
+    if(writeAll(writer->outputFd, writer->buffer, writer->bufferLength) < 0) return -1;
+    writer->bufferLength = 0;
+    return 0;
+}
+
+static int flushCleanRun(OutputWriter* writer){
+    if(writer->cleanLength == 0) return 0;
+    if(flushOutputBuffer(writer) < 0) return -1;
+
+    off_t offset = writer->cleanOffset;
+    long length = writer->cleanLength;
+    writer->cleanLength = 0;
+
+#ifdef __linux__
+    while(writer->useCopyRange && length > 0){
+        ssize_t copied = copy_file_range(writer->inputFd, &offset, writer->outputFd, NULL, length, 0);
+        if(copied > 0){
+            length -= copied;
+        }else if(copied < 0 && errno == EINTR){
+            continue;
+        }else if(copied < 0 && (errno == ENOSYS || errno == EXDEV || errno == EINVAL || 
+                                errno == EOPNOTSUPP || errno == EBADF)){
+            // Not supported between these files, fall back to a normal copy from now on.
+            writer->useCopyRange = 0;
+        }else{
+            return -1;
+        }
+    }
+#endif
+
+    // Copy through the buffer, which is empty at this point.
+    while(length > 0){
+        size_t chunk = length < OUTPUT_BUFFER_SIZE ? length : OUTPUT_BUFFER_SIZE;
+        ssize_t readBytes = pread(writer->inputFd, writer->buffer, chunk, offset);
+        if(readBytes < 0 && errno == EINTR) continue;
+        if(readBytes <= 0) return -1;
+        if(writeAll(writer->outputFd, writer->buffer, readBytes) < 0) return -1;
+        offset += readBytes;
+        length -= readBytes;
+    }
+    return 0;
+}
+
+// Adds [length] bytes of fixed data.
+static int writeFixedData(OutputWriter* writer, const unsigned char* data, size_t length);
+
+// Adds the [length] bytes of [data], which are the same as the input file at [offset].
+static int writeCleanData(OutputWriter* writer, long offset, const unsigned char* data, long length){
+    if(writer->inputFd < 0) return writeFixedData(writer, data, length);
+
+    if(writer->cleanLength > 0 && writer->cleanOffset + writer->cleanLength != offset){
+        if(flushCleanRun(writer) < 0) return -1;
+    }
+    if(writer->cleanLength == 0) writer->cleanOffset = offset;
+    writer->cleanLength += length;
+    return 0;
+}
+
+static int writeFixedData(OutputWriter* writer, const unsigned char* data, size_t length){
+    if(flushCleanRun(writer) < 0) return -1;
+    if(writer->bufferLength + length > OUTPUT_BUFFER_SIZE){
+        if(flushOutputBuffer(writer) < 0) return -1;
+    }
+    memcpy(writer->buffer + writer->bufferLength, data, length);
+    writer->bufferLength += length;
+    return 0;
+}
+
+/***************************************************************************************************
+ * FILE RECUPERATION
+ **************************************************************************************************/
+
+// Maximum number of combinations checked per block on the first pass of recuperateFile().
+static long decodeBudget = 0;
+
+void setDecodeBudget(long maxCombinations){
+    decodeBudget = maxCombinations > 0 ? maxCombinations : 0;
+}
+
+// Second read of the data given to recuperateFile(), if any.
+static const char* secondReadFilename = NULL;
+
+void setSecondRead(const char* filename){
+    secondReadFilename = filename;
+}
+
+// File where recuperateFile() writes its report, if any.
+static const char* reportFilename = NULL;
+static int reportBinary = 0;
+
+void setRecoveryReport(const char* filename, int binary){
+    reportFilename = filename;
+    reportBinary = binary;
+}
+
+static long long elapsedNanoseconds(const struct timespec* start){
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (now.tv_sec - start->tv_sec)*1000000000LL + (now.tv_nsec - start->tv_nsec);
+}
+
+// A block that exceeded the work budget, waiting to be fixed after the first pass.
+typedef struct{
+    unsigned char data[NUM_POINTS_SAMPLE];
+    unsigned char rec[REC_BYTES_PER_BLOCK];
+    unsigned char reliability[NUM_POINTS_SAMPLE];
+    int hasReliability;
+    long length;
+    long filePosition;
+    long correctionPosition;
+    // Index of the block on the file.
+    long block;
+} DeferredBlock;
+
+typedef struct{
+    FILE* inputFile;
+    FILE* recFile;
+    // Only if there's a second read of the data.
+    FILE* secondFile;
+    FILE* log;
+    OutputWriter* writer;
+    // Only if a report was asked for. Filled by the writer.
+    RecoveryReport* report;
+    long inputFilesize;
+    int showProgress;
+    long depth;
+    long chunkBlocks;
+
+    // Only used by the reader.
+    int readerStopped;
+    long readBlocks;
+    // Bytes of recuperation data left before the trailer.
+    long recRemaining;
+
+    // Regions that don't match the integrity index and column parity. Read-only while the 
+    // pipeline runs.
+    DamagedRegions regions;
+    ColumnParity columns;
+
+    // Only used by the writer.
+    long filePosition;
+    long correctionPosition;
+    long blocksCorrected;
+    long columnsFixed;
+    long totalBlocks;
+    int misaligned;
+
+    // Blocks that exceeded the work budget. If the output cannot be rewritten (it's a stream), they
+    // get fixed as soon as they reach the writer.
+    int canDefer;
+    DeferredBlock* deferred;
+    long numDeferred;
+    long deferredCapacity;
+
+    // Messages of the writer.
+    LogBuffer errorLog;
+
+    // Progress saved on the last checkpoint.
+    Checkpoint checkpoint;
+    struct timespec lastCheckpoint;
+} RecuperationContext;
+
+static void printBlockError(LogBuffer* log, long filePosition, long correctionPosition,
+                            const unsigned char* data, const unsigned char* rec){
+    char hex[2*(NUM_POINTS_SAMPLE + REC_BYTES_PER_BLOCK) + 4];
+    int length = 0;
+    for(int j = 0; j < NUM_POINTS_SAMPLE; j++)   length += sprintf(hex + length, "%02X", data[j]);
+    length += sprintf(hex + length, " - ");
+    for(int j = 0; j < REC_BYTES_PER_BLOCK; j++) length += sprintf(hex + length, "%02X", rec[j]);
+
+    bufferedLog(log, "\nError fixing the file at: 0x%08lX. Correction file position: 0x%08lX.\n"
+                     "Data: %s\n", filePosition, correctionPosition, hex);
+}
+
+// A block is only fixed if any of its bytes changed: the ones that only needed to retry a point of 
+// the recuperation data as 256 are clean, like scanFile() says.
+static BlockOutcome blockOutcome(AlgorithmReturn success, int errors){
+    if(success < 0)                         return BLOCK_FAILED;
+    if(success == FIXED_OK && errors > 0)   return BLOCK_FIXED;
+    return BLOCK_CLEAN;
+}
+
+// Adds the outcome of the next block to the report, if there's one.
+static int reportBlock(RecuperationContext* ctx, AlgorithmReturn success, int errors){
+    if(ctx->report == NULL) return 0;
+
+    return addBlockOutcome(ctx->report, blockOutcome(success, errors), success < 0 ? -1 : errors);
+}
+
+static int deferBlock(RecuperationContext* ctx, const unsigned char* data, const unsigned char* rec,
+                      const unsigned char* reliability, long length){
+    if(ctx->numDeferred == ctx->deferredCapacity){
+        long capacity = ctx->deferredCapacity ? 2*ctx->deferredCapacity : 64;
+        DeferredBlock* deferred = realloc(ctx->deferred, capacity*sizeof(DeferredBlock));
+        if(deferred == NULL) return -1;
+        ctx->deferred = deferred;
+        ctx->deferredCapacity = capacity;
+    }
+
+    DeferredBlock* block = &ctx->deferred[ctx->numDeferred++];
+    memcpy(block->data, data, NUM_POINTS_SAMPLE);
+    memcpy(block->rec, rec, REC_BYTES_PER_BLOCK);
+    block->hasReliability = reliability != NULL;
+    if(reliability != NULL) memcpy(block->reliability, reliability, NUM_POINTS_SAMPLE);
+    block->length = length;
+    block->filePosition = ctx->filePosition;
+    block->correctionPosition = ctx->correctionPosition;
+    block->block = ctx->totalBlocks;
+    return 0;
+}
+
+// Fixes the deferred blocks without a budget and writes them over their place on the output.
+static int drainDeferredBlocks(RecuperationContext* ctx){
+    for(long i = 0; i < ctx->numDeferred; i++){
+        DeferredBlock* block = &ctx->deferred[i];
+        struct timespec start;
+        clock_gettime(CLOCK_MONOTONIC, &start);
+        int errors;
+        AlgorithmReturn success = decodeBlockWithReliability(block->data, block->rec, 
+                                    block->hasReliability ? block->reliability : NULL, &errors, 0);
+
+        if(ctx->report != NULL){
+            ctx->report->timeHistogram[reportTimeBucket(elapsedNanoseconds(&start))]++;
+            setBlockOutcome(ctx->report, block->block, blockOutcome(success, errors), errors);
+        }
+        if(success < 0){
+            printBlockError(&ctx->errorLog, block->filePosition, block->correctionPosition, 
+                            block->data, block->rec);
+            continue;
+        }
+
+        ctx->blocksCorrected++;
+        if(success == FIXED_OK){
+            if(pwrite(ctx->writer->outputFd, block->data, block->length, block->filePosition) 
+                    != block->length){
+                return -1;
+            }
+        }
+    }
+    return 0;
+}
+
+static int readRecuperationChunk(void* chunk, void* context){
+    RecuperationContext* ctx = context;
+    FileChunk* c = chunk;
+    if(ctx->readerStopped) return 0;
+
+    c->firstBlock = ctx->readBlocks;
+
+    // Chunks that match the integrity index are copied from the input file by the writer, so they
+    // are skipped on both files.
+    long chunkBytes = ctx->inputFilesize - ctx->readBlocks*NUM_POINTS_SAMPLE;
+    if(chunkBytes > ctx->chunkBlocks*NUM_POINTS_SAMPLE) chunkBytes = ctx->chunkBlocks*NUM_POINTS_SAMPLE;
+    long chunkBlocks = (chunkBytes + NUM_POINTS_SAMPLE - 1)/NUM_POINTS_SAMPLE;
+    if(ctx->writer->inputFd >= 0 && chunkBlocks*REC_BYTES_PER_BLOCK <= ctx->recRemaining && 
+       areBlocksVerified(&ctx->regions, ctx->readBlocks, chunkBlocks)){
+        fseek(ctx->inputFile, chunkBytes, SEEK_CUR);
+        fseek(ctx->recFile, chunkBlocks*REC_BYTES_PER_BLOCK, SEEK_CUR);
+        if(ctx->secondFile != NULL) fseek(ctx->secondFile, chunkBytes, SEEK_CUR);
+        c->dataLength = chunkBytes;
+        c->blocks = chunkBlocks;
+        c->misaligned = 0;
+        c->verified = 1;
+        ctx->readBlocks += chunkBlocks;
+        ctx->recRemaining -= chunkBlocks*REC_BYTES_PER_BLOCK;
+        return 1;
+    }
+
+    // Both files are read sequentially and in chunks of the same number of blocks, so they stay 
+    // aligned without seeking. This way, any of them can be a pipe. Anything left on the 
+    // recuperation file is checked at the end.
+    readDataChunk(c, ctx->inputFile, ctx->chunkBlocks);
+    c->hasReliability = ctx->secondFile != NULL;
+    if(c->hasReliability){
+        // Whatever the second read lacks is taken as it is on the first one.
+        size_t secondLength = fread(c->secondRead, 1, c->dataLength, ctx->secondFile);
+        memcpy(c->secondRead + secondLength, c->data + secondLength, 
+               c->blocks*NUM_POINTS_SAMPLE - secondLength);
+    }
+    long recWanted = c->blocks*REC_BYTES_PER_BLOCK;
+    if(recWanted > ctx->recRemaining) recWanted = ctx->recRemaining;
+    size_t recRead = fread(c->rec, 1, recWanted, ctx->recFile);
+    ctx->recRemaining -= recRead;
+    ctx->readBlocks += c->blocks;
+    if(c->blocks*REC_BYTES_PER_BLOCK != (long) recRead){
+        c->misaligned = 1;
+        ctx->readerStopped = 1;
+        if(c->blocks > (long) (recRead/REC_BYTES_PER_BLOCK)){
+            c->blocks = recRead/REC_BYTES_PER_BLOCK;
+            c->dataLength = c->blocks*NUM_POINTS_SAMPLE;
+        }
+    }
+    // A misaligned chunk is still passed along so the writer knows about it.
+    return c->blocks > 0 || c->misaligned;
+}
+
+static void processRecuperationChunk(void* chunk, void* context, int worker){
+    // Only the encoder has a parity cache per worker.
+    (void) worker;
+    RecuperationContext* ctx = context;
+    FileChunk* c = chunk;
+
+    // The blocks of an interleaved file are fixed on their own buffer. The writer puts them back in 
+    // place if any of them changed.
+    unsigned char* blocks = c->data;
+    if(ctx->depth > 1 && !c->verified){
+        interleaveBlocks(c->data, c->interleaved, c->blocks, ctx->depth);
+        blocks = c->interleaved;
+    }
+
+    // The second read is put like the blocks and compared with them.
+    unsigned char* reliability = NULL;
+    if(c->hasReliability && !c->verified){
+        reliability = c->reliability;
+        if(ctx->depth > 1){
+            interleaveBlocks(c->secondRead, c->reliability, c->blocks, ctx->depth);
+            readReliability(blocks, c->reliability, reliability, c->blocks*NUM_POINTS_SAMPLE);
+        }else{
+            readReliability(blocks, c->secondRead, reliability, c->blocks*NUM_POINTS_SAMPLE);
+        }
+    }
+
+    if(ctx->report != NULL) memset(c->timeHistogram, 0, sizeof(c->timeHistogram));
+    for(long i = 0; i < c->blocks; i++){
+        c->errors[i] = 0;
+
+        // The points of a block are spread over its whole group.
+        long group = i - i % ctx->depth;
+        long groupBlocks = c->blocks - group < ctx->depth ? c->blocks - group : ctx->depth;
+        if(c->verified || areBlocksVerified(&ctx->regions, c->firstBlock + group, groupBlocks)){
+            c->results[i] = WITHOUT_ERRORS;
+            continue;
+        }
+
+        // Runs of uniform blocks with their expected recuperation data are OK.
+        long uniform = countUniformBlocks(blocks + i*NUM_POINTS_SAMPLE, 
+                                          c->rec + i*REC_BYTES_PER_BLOCK, c->blocks - i);
+        if(uniform > 0){
+            for(long j = 0; j < uniform; j++){
+                c->results[i + j] = WITHOUT_ERRORS;
+                c->errors[i + j] = 0;
+            }
+            i += uniform - 1;
+            continue;
+        }
+
+        struct timespec start;
+        if(ctx->report != NULL) clock_gettime(CLOCK_MONOTONIC, &start);
+        c->results[i] = decodeBlockWithReliability(blocks + i*NUM_POINTS_SAMPLE, 
+                                    c->rec + i*REC_BYTES_PER_BLOCK, 
+                                    reliability ? reliability + i*NUM_POINTS_SAMPLE : NULL, 
+                                    &c->errors[i], decodeBudget);
+        if(ctx->report != NULL){
+            c->timeHistogram[reportTimeBucket(elapsedNanoseconds(&start))]++;
+        }
+    }
+
+    // The blocks that failed are erasures for the column parity.
+    c->columnsFixed = c->verified ? 0 : 
+        repairWithColumns(&ctx->columns, c->firstBlock, blocks, c->rec, c->results, c->errors, 
+                          c->blocks);
+}
+
+// Saves the progress of the writer if it's time for another checkpoint. The checksums of the files
+// are continued with what was read and written since the last one, read back from them: the chunks
+// only keep the fixed data.
+static int checkpointRecuperation(RecuperationContext* ctx){
+    if(checkpointFilename == NULL || !isCheckpointDue(&ctx->lastCheckpoint)) return 0;
+    if(flushCleanRun(ctx->writer) < 0 || flushOutputBuffer(ctx->writer) < 0) return -1;
+
+    Checkpoint* checkpoint = &ctx->checkpoint;
+    if(crcFileRange(fileno(ctx->inputFile), checkpoint->inputPosition, 
+                    ctx->filePosition - checkpoint->inputPosition, &checkpoint->inputCrc) < 0 ||
+       crcFileRange(fileno(ctx->recFile), checkpoint->recPosition, 
+                    ctx->correctionPosition - checkpoint->recPosition, &checkpoint->recCrc) < 0 ||
+       crcFileRange(ctx->writer->outputFd, checkpoint->outputPosition, 
+                    ctx->filePosition - checkpoint->outputPosition, &checkpoint->outputCrc) < 0){
+        return -1;
+    }
+    checkpoint->blocks = ctx->totalBlocks;
+    checkpoint->inputPosition = ctx->filePosition;
+    checkpoint->recPosition = ctx->correctionPosition;
+    checkpoint->outputPosition = ctx->filePosition;
+    checkpoint->blocksCorrected = ctx->blocksCorrected;
+    checkpoint->columnsFixed = ctx->columnsFixed;
+    return saveCheckpoint(checkpoint, ctx->writer->outputFd);
+}
+
+// Same as writeRecuperationChunk(), for interleaved files. A fixed block changes bytes all over its 
+// group, so the chunk is written as a whole.
+static int writeInterleavedChunk(RecuperationContext* ctx, FileChunk* c){
+    int anyFixed = 0;
+    for(long i = 0; i < c->blocks; i++){
+        unsigned char* blockData = c->interleaved + i*NUM_POINTS_SAMPLE;
+        unsigned char* blockRec = c->rec + i*REC_BYTES_PER_BLOCK;
+        unsigned char* blockReliability = c->hasReliability ? 
+                                          c->reliability + i*NUM_POINTS_SAMPLE : NULL;
+
+        AlgorithmReturn success = c->results[i];
+        if(success == EXCEEDS_WORK_BUDGET){
+            success = decodeBlockWithReliability(blockData, blockRec, blockReliability, 
+                                                 &c->errors[i], 0);
+        }
+
+        if(success < 0){
+            printBlockError(&ctx->errorLog, ctx->filePosition + blockFilePosition(i, ctx->depth), 
+                            ctx->correctionPosition + i*REC_BYTES_PER_BLOCK, blockData, blockRec);
+        }else{
+            ctx->blocksCorrected++;
+        }
+        if(reportBlock(ctx, success, c->errors[i]) < 0) return -1;
+        anyFixed |= success == FIXED_OK;
+    }
+    ctx->totalBlocks += c->blocks;
+
+    int writeResult;
+    if(anyFixed){
+        deinterleaveBlocks(c->interleaved, c->data, c->blocks, ctx->depth);
+        writeResult = writeFixedData(ctx->writer, c->data, c->dataLength);
+    }else{
+        writeResult = writeCleanData(ctx->writer, ctx->filePosition, c->data, c->dataLength);
+    }
+    if(writeResult < 0) return -1;
+
+    ctx->filePosition += c->dataLength;
+    ctx->correctionPosition += c->blocks*REC_BYTES_PER_BLOCK;
+    return 0;
+}
+
+static int writeRecuperationChunk(void* chunk, void* context){
+    RecuperationContext* ctx = context;
+    FileChunk* c = chunk;
+
+    if(ctx->showProgress) printLoadingBar(ctx->filePosition, ctx->inputFilesize);
+    ctx->misaligned |= c->misaligned;
+    ctx->columnsFixed += c->columnsFixed;
+    if(ctx->report != NULL && !c->verified){
+        for(int i = 0; i < REPORT_TIME_BUCKETS; i++){
+            ctx->report->timeHistogram[i] += c->timeHistogram[i];
+        }
+    }
+    if(ctx->errorLog.length > LOG_BUFFER_SIZE/2) flushLog(&ctx->errorLog);
+    if(ctx->depth > 1){
+        return writeInterleavedChunk(ctx, c) < 0 ? -1 : checkpointRecuperation(ctx);
+    }
+
+    for(long i = 0; i < c->blocks; i++){
+        unsigned char* blockData = c->data + i*NUM_POINTS_SAMPLE;
+        unsigned char* blockRec = c->rec + i*REC_BYTES_PER_BLOCK;
+        unsigned char* blockReliability = c->hasReliability ? 
+                                          c->reliability + i*NUM_POINTS_SAMPLE : NULL;
+
+        // The output is as long as the input, so the padding of the last block is not written.
+        long blockLength = c->dataLength - i*NUM_POINTS_SAMPLE;
+        if(blockLength > NUM_POINTS_SAMPLE) blockLength = NUM_POINTS_SAMPLE;
+
+        AlgorithmReturn success = c->results[i];
+        if(success == EXCEEDS_WORK_BUDGET){
+            if(ctx->canDefer){
+                // For now, the block is written as it is.
+                if(deferBlock(ctx, blockData, blockRec, blockReliability, blockLength) < 0){
+                    return -1;
+                }
+            }else{
+                success = decodeBlockWithReliability(blockData, blockRec, blockReliability, 
+                                                     &c->errors[i], 0);
+            }
+        }
+
+        if(success == EXCEEDS_WORK_BUDGET){
+            // Counted once it's fixed.
+        }else if(success < 0){
+            printBlockError(&ctx->errorLog, ctx->filePosition, ctx->correctionPosition, 
+                            blockData, blockRec);
+        }else{
+            ctx->blocksCorrected++;
+        }
+        if(reportBlock(ctx, success, c->errors[i]) < 0) return -1;
+        ctx->totalBlocks++;
+
+        // Save the corrected data. The blocks that didn't change are copied from the input.
+        int writeResult;
+        if(success == FIXED_OK){
+            writeResult = writeFixedData(ctx->writer, blockData, blockLength);
+        }else{
+            writeResult = writeCleanData(ctx->writer, ctx->filePosition, blockData, blockLength);
+        }
+        if(writeResult < 0) return -1;
+
+        ctx->filePosition += blockLength;
+        ctx->correctionPosition += REC_BYTES_PER_BLOCK;
+    }
+    return checkpointRecuperation(ctx);
+}
+
+// Writes the report of recuperateFile() to the file given to setRecoveryReport().
+static void writeRecoveryReport(const RecoveryReport* report, FILE* log, const char* inputFilename,
+                                const char* recuperationFilename){
+    FILE* reportFile = fopen(reportFilename, reportBinary ? "wb" : "w");
+    if(reportFile == NULL){
+        fprintf(log, "File %s. ", reportFilename);
+        fflush(log);
+        perror("Error creating the report file");
+        return;
+    }
+
+    int ret = reportBinary ? writeReportBinary(report, reportFile) : 
+                             writeReportJson(report, reportFile, inputFilename, recuperationFilename);
+    if(fclose(reportFile) != 0 || ret < 0){
+        perror("Error writing the report file");
+    }
+}
+
+// Continues the recuperation saved on the checkpoint, if there's one: every file is taken to where
+// it was and the counters are restored.
+static void resumeRecuperation(RecuperationContext* ctx, long recFilesize){
+    ctx->checkpoint = (Checkpoint){
+        .kind = CHECKPOINT_RECUPERATE,
+        .inputSize = ctx->inputFilesize,
+        .recSize = recFilesize,
+        .depth = ctx->depth,
+        .columnGroup = ctx->columns.group,
+        .columnParity = ctx->columns.parity,
+        .regionBlocks = ctx->regions.regionBlocks,
+        .parityPolicy = getParityPolicy(),
+        .decodeBudget = decodeBudget,
+        .secondRead = ctx->secondFile != NULL,
+    };
+    clock_gettime(CLOCK_MONOTONIC, &ctx->lastCheckpoint);
+
+    int resumed = loadCheckpoint(&ctx->checkpoint, fileno(ctx->inputFile), fileno(ctx->recFile), 
+                                 ctx->writer->outputFd, ctx->log);
+    if(resumed < 0 || 
+       (resumed && lseek(ctx->writer->outputFd, ctx->checkpoint.outputPosition, SEEK_SET) < 0)){
+        perror("Error resuming the output file");
+        exit(-1);
+    }
+    if(!resumed) return;
+
+    const Checkpoint* checkpoint = &ctx->checkpoint;
+    if(fseek(ctx->inputFile, checkpoint->inputPosition, SEEK_SET) < 0 ||
+       fseek(ctx->recFile, checkpoint->recPosition, SEEK_SET) < 0 ||
+       (ctx->secondFile != NULL && fseek(ctx->secondFile, checkpoint->inputPosition, SEEK_SET) < 0)){
+        perror("Error resuming the input files");
+        exit(-1);
+    }
+    ctx->readBlocks = checkpoint->blocks;
+    ctx->recRemaining -= checkpoint->recPosition;
+    ctx->filePosition = checkpoint->inputPosition;
+    ctx->correctionPosition = checkpoint->recPosition;
+    ctx->totalBlocks = checkpoint->blocks;
+    ctx->blocksCorrected = checkpoint->blocksCorrected;
+    ctx->columnsFixed = checkpoint->columnsFixed;
+}
+
+void recuperateFile(const char* inputFilename, const char* recuperationFilename, const char* out){
+    struct timespec startTime;
+    clock_gettime(CLOCK_MONOTONIC, &startTime);
+
+    // The report holds every block, so it cannot be resumed.
+    if(checkpointFilename != NULL && (isStdStream(inputFilename) || 
+       isStdStream(recuperationFilename) || isStdStream(out) || reportFilename != NULL)){
+        printf("Checkpoints need files, not streams, and cannot be used with a report.\n");
+        exit(-1);
+    }
+
+    FILE* inputFile = isStdStream(inputFilename) ? stdin : fopen(inputFilename, "rb");
+    if (inputFile == NULL) {
+        printf("File %s. ", inputFilename);
+        fflush(stdout);
+        perror("Error opening input file");
+        exit(-1);
+    }
+
+    FILE* recFile = isStdStream(recuperationFilename) ? stdin : fopen(recuperationFilename, "rb");
+    if (recFile == NULL) {
+        printf("File %s. ", recuperationFilename);
+        fflush(stdout);
+        perror("Error opening the recuperation file");
+        fclose(inputFile);
+        exit(-1);
+    }
+
+    // With checkpoints, the output is read back for its checksum and, when resuming, it keeps what 
+    // was written before the checkpoint.
+    int streamOutput = isStdStream(out);
+    int outputFlags = O_WRONLY | O_CREAT | O_TRUNC;
+    if(checkpointFilename != NULL) outputFlags = O_RDWR | O_CREAT | (resumeFromCheckpoint ? 0 : O_TRUNC);
+    OutputWriter writer = {
+        .inputFd = (inputFile == stdin || streamOutput) ? -1 : fileno(inputFile),
+        .outputFd = streamOutput ? STDOUT_FILENO : open(out, outputFlags, 0666),
+        .useCopyRange = 1,
+    };
+    if (writer.outputFd < 0) {
+        printf("File %s. ", out);
+        fflush(stdout);
+        perror("Error creating output file");
+        fclose(inputFile);
+        fclose(recFile);
+        exit(-1);
+    }
+    adviseSequential(inputFile);
+    adviseSequential(recFile);
+
+    FILE* secondFile = NULL;
+    if(secondReadFilename != NULL){
+        secondFile = fopen(secondReadFilename, "rb");
+        if(secondFile == NULL){
+            printf("File %s. ", secondReadFilename);
+            fflush(stdout);
+            perror("Error opening the second read");
+            fclose(inputFile);
+            fclose(recFile);
+            close(writer.outputFd);
+            exit(-1);
+        }
+        adviseSequential(secondFile);
+    }
+
+    // When the fixed data goes to the standard output, the messages go to the error output.
+    RecuperationContext ctx = {
+        .inputFile = inputFile,
+        .recFile = recFile,
+        .secondFile = secondFile,
+        .log = streamOutput ? stderr : stdout,
+        .writer = &writer,
+        .inputFilesize = getFileSize(inputFile),
+        // The deferred blocks are written out of order, after the checkpoints of their chunks.
+        .canDefer = !streamOutput && checkpointFilename == NULL,
+    };
+    ctx.showProgress = ctx.log == stdout && ctx.inputFilesize > 0;
+    ctx.errorLog.out = ctx.log;
+    long recFilesize = getFileSize(recFile);
+
+    RecoveryReport report;
+    if(reportFilename != NULL){
+        initRecoveryReport(&report);
+        ctx.report = &report;
+    }
+
+    // The recuperation data ends where its trailer starts. On a stream, the trailer is checked 
+    // once the data ends.
+    RecTrailer trailer = {.parityLength = recFilesize};
+    if(recFilesize >= 0 && readRecTrailer(recFile, recFilesize, &trailer) < 0){
+        fprintf(ctx.log, "The trailer of %s is malformed.\n", recuperationFilename);
+    }
+    ctx.recRemaining = recFilesize >= 0 ? trailer.parityLength : LONG_MAX;
+
+    // The layout of the file is on its trailer. If it cannot be read first, it has to be given.
+    ctx.depth = trailerInterleaveDepth(&trailer, recFilesize >= 0 ? 1 : interleaveDepth);
+    loadColumnParity(&trailer, trailer.parityLength/REC_BYTES_PER_BLOCK, ctx.depth, &ctx.columns);
+    ctx.chunkBlocks = chunkBlocksFor(layoutUnit(ctx.depth, ctx.columns.group));
+    if(writer.inputFd >= 0){
+        loadIntegrityIndex(inputFile, ctx.inputFilesize, &trailer, ctx.log, &ctx.regions);
+    }
+    freeRecTrailer(&trailer);
+    if(checkpointFilename != NULL) resumeRecuperation(&ctx, recFilesize);
+
+    FileChunk* chunks = allocateChunks();
+    Pipeline pipeline = {
+        .chunks = chunks,
+        .chunkSize = sizeof(FileChunk),
+        .numChunks = FILE_PIPELINE_CHUNKS,
+        .read = readRecuperationChunk,
+        .process = processRecuperationChunk,
+        .write = writeRecuperationChunk,
+        .context = &ctx,
+    };
+    int writeError = runPipeline(&pipeline) < 0;
+    free(chunks);
+
+    free(ctx.regions.damaged);
+    freeColumnParity(&ctx.columns);
+
+    // Anything left on the recuperation file (but its trailer) means it doesn't belong to this 
+    // input.
+    if(!ctx.misaligned && !writeError){
+        ctx.misaligned = recFilesize >= 0 ? ctx.recRemaining > 0 : !isTrailerLeft(recFile);
+    }
+
+    if(!writeError){
+        writeError = flushCleanRun(&writer) < 0 || flushOutputBuffer(&writer) < 0;
+    }
+
+    // Second pass: the blocks that exceeded the budget.
+    struct timespec t0, t1;
+    clock_gettime(CLOCK_MONOTONIC, &t0);
+    if(!writeError){
+        writeError = drainDeferredBlocks(&ctx) < 0;
+    }
+    clock_gettime(CLOCK_MONOTONIC, &t1);
+    double drainTime = (t1.tv_sec - t0.tv_sec)*1e3 + (t1.tv_nsec - t0.tv_nsec)/1e6;
+    free(ctx.deferred);
+
+    flushLog(&ctx.errorLog);
+
+    if(writeError){
+        fprintf(ctx.log, "\n");
+        fflush(ctx.log);
+        perror("Error writing the output file");
+        fclose(inputFile);
+        fclose(recFile);
+        if(secondFile != NULL) fclose(secondFile);
+        close(writer.outputFd);
+        exit(-1);
+    }
+    if(ctx.showProgress) printLoadingBar(ctx.inputFilesize, ctx.inputFilesize);
+
+    int completed = !ctx.misaligned && !ferror(inputFile) && !ferror(recFile);
+    if(completed){
+        fprintf(ctx.log, "\nCorrection completed! %ld of %ld blocks OK! (%s, %s) -> %s\n", 
+            ctx.blocksCorrected, ctx.totalBlocks, inputFilename, recuperationFilename, out);
+        if(getParityPolicy() == PARITY_ADAPTIVE){
+            long fallbacks, fixed;
+            getParityFallbacks(&fallbacks, &fixed);
+            fprintf(ctx.log, "%ld blocks retried with untrusted recuperation data, %ld fixed.\n",
+                fallbacks, fixed);
+        }
+        if(ctx.columnsFixed > 0){
+            fprintf(ctx.log, "%ld blocks recuperated with the column parity.\n", ctx.columnsFixed);
+        }
+        if(decodeBudget > 0){
+            fprintf(ctx.log, "%ld blocks exceeded the budget of %ld combinations. Fixed in %0.3f ms.\n",
+                ctx.numDeferred, decodeBudget, drainTime);
+        }
+    }else{
+        fprintf(ctx.log, "\nThe files were misaligned or an external error happened!\n");
+        fprintf(ctx.log, "Input: %ld/%ld, Correction: %ld/%ld\n", 
+            ctx.filePosition, ctx.inputFilesize, ctx.correctionPosition, recFilesize);
+    }
+
+    if(ctx.report != NULL){
+        report.columnFixedBlocks = ctx.columnsFixed;
+        report.depth = ctx.depth;
+        report.dataLength = ctx.filePosition;
+        report.nanoseconds = elapsedNanoseconds(&startTime);
+        writeRecoveryReport(&report, ctx.log, inputFilename, recuperationFilename);
+        freeRecoveryReport(&report);
+    }
+
+    fclose(inputFile);
+    fclose(recFile);
+    if(secondFile != NULL) fclose(secondFile);
+
+    // The job is done, there's nothing left to resume.
+    if(close(writer.outputFd) == 0 && completed && checkpointFilename != NULL){
+        remove(checkpointFilename);
+    }
+}
+
+/***************************************************************************************************
+ * RANGE RECUPERATION
+ **************************************************************************************************/
+
+void recuperateRange(const char* inputFilename, const char* recuperationFilename, const char* out,
+                     long offset, long length){
+    FILE* inputFile = fopen(inputFilename, "rb");
+    if (inputFile == NULL) {
+        printf("File %s. ", inputFilename);
+        fflush(stdout);
+        perror("Error opening input file");
+        exit(-1);
+    }
+
+    FILE* recFile = fopen(recuperationFilename, "rb");
+    if (recFile == NULL) {
+        printf("File %s. ", recuperationFilename);
+        fflush(stdout);
+        perror("Error opening the recuperation file");
+        fclose(inputFile);
+        exit(-1);
+    }
+
+    long inputFilesize = getFileSize(inputFile);
+    if(offset < 0 || length <= 0 || offset >= inputFilesize){
+        printf("The range 0x%08lX+%ld is outside of %s (%ld bytes).\n", 
+               offset, length, inputFilename, inputFilesize);
+        fclose(inputFile);
+        fclose(recFile);
+        exit(-1);
+    }
+    if(length > inputFilesize - offset) length = inputFilesize - offset;
+
+    FILE* outputFile = isStdStream(out) ? stdout : fopen(out, "wb");
+    if (outputFile == NULL) {
+        printf("File %s. ", out);
+        fflush(stdout);
+        perror("Error creating output file");
+        fclose(inputFile);
+        fclose(recFile);
+        exit(-1);
+    }
+    FILE* log = (outputFile == stdout) ? stderr : stdout;
+    LogBuffer errorLog = {.out = log};
+
+    long totalBlocks = (inputFilesize + NUM_POINTS_SAMPLE - 1)/NUM_POINTS_SAMPLE;
+    RecTrailer trailer;
+    ColumnParity columns;
+    readRecTrailer(recFile, getFileSize(recFile), &trailer);
+    long depth = trailerInterleaveDepth(&trailer, 1);
+    loadColumnParity(&trailer, totalBlocks, depth, &columns);
+    long parityLength = trailer.parityLength;
+    freeRecTrailer(&trailer);
+
+    // Only the blocks that cover the range (whole groups, if the file is interleaved or has column 
+    // parity) are read, straight from their position on both files.
+    long unit = layoutUnit(depth, columns.group);
+    long firstBlock = offset/NUM_POINTS_SAMPLE;
+    long lastBlock = (offset + length - 1)/NUM_POINTS_SAMPLE;
+    firstBlock -= firstBlock % unit;
+    lastBlock += unit - 1 - lastBlock % unit;
+    if(lastBlock >= totalBlocks) lastBlock = totalBlocks - 1;
+    fseek(inputFile, firstBlock*NUM_POINTS_SAMPLE, SEEK_SET);
+    fseek(recFile, firstBlock*REC_BYTES_PER_BLOCK, SEEK_SET);
+
+    unsigned char data[FILE_BUFFER_BLOCKS*NUM_POINTS_SAMPLE];
+    unsigned char interleaved[FILE_BUFFER_BLOCKS*NUM_POINTS_SAMPLE];
+    unsigned char rec[FILE_BUFFER_BLOCKS*REC_BYTES_PER_BLOCK];
+    AlgorithmReturn results[FILE_BUFFER_BLOCKS];
+    long chunkBlocks = chunkBlocksFor(unit);
+    long blocksCorrected = 0;
+    int misaligned = (lastBlock + 1)*REC_BYTES_PER_BLOCK > parityLength;
+    for(long block = firstBlock; block <= lastBlock && !misaligned; block += chunkBlocks){
+        long blocks = lastBlock - block + 1;
+        if(blocks > chunkBlocks) blocks = chunkBlocks;
+        long filePosition = block*NUM_POINTS_SAMPLE;
+
+        // The last block of the file gets padded the same way as when it was encoded.
+        size_t dataRead = fread(data, 1, blocks*NUM_POINTS_SAMPLE, inputFile);
+        memset(data + dataRead, PADDING_BYTE, blocks*NUM_POINTS_SAMPLE - dataRead);
+        if(fread(rec, REC_BYTES_PER_BLOCK, blocks, recFile) != (size_t) blocks){
+            misaligned = 1;
+            break;
+        }
+
+        unsigned char* blockData = data;
+        if(depth > 1){
+            interleaveBlocks(data, interleaved, blocks, depth);
+            blockData = interleaved;
+        }
+
+        for(long i = 0; i < blocks; i++){
+            results[i] = decodeBlock(blockData + i*NUM_POINTS_SAMPLE, rec + i*REC_BYTES_PER_BLOCK, 
+                                     NULL);
+        }
+        repairWithColumns(&columns, block, blockData, rec, results, NULL, blocks);
+
+        int anyFixed = 0;
+        for(long i = 0; i < blocks; i++){
+            AlgorithmReturn success = results[i];
+            if(success < 0){
+                printBlockError(&errorLog, blockFilePosition(block + i, depth), 
+                                (block + i)*REC_BYTES_PER_BLOCK, 
+                                blockData + i*NUM_POINTS_SAMPLE, rec + i*REC_BYTES_PER_BLOCK);
+            }else{
+                blocksCorrected++;
+            }
+            anyFixed |= success == FIXED_OK;
+        }
+        if(depth > 1 && anyFixed) deinterleaveBlocks(interleaved, data, blocks, depth);
+
+        // Only the part of the blocks inside of the range is written.
+        long start = offset > filePosition ? offset - filePosition : 0;
+        long end = offset + length - filePosition;
+        if(end > blocks*NUM_POINTS_SAMPLE) end = blocks*NUM_POINTS_SAMPLE;
+        if(end <= start) continue;
+        if(fwrite(data + start, 1, end - start, outputFile) != (size_t) (end - start)){
+            flushLog(&errorLog);
+            fprintf(log, "\nThe program is not writing properly.\n");
+            fclose(inputFile);
+            fclose(recFile);
+            fclose(outputFile);
+            exit(-1);
+        }
+    }
+
+    flushLog(&errorLog);
+    if(!misaligned){
+        fprintf(log, "Range 0x%08lX-0x%08lX recuperated! %ld of %ld blocks OK! (%s, %s) -> %s\n",
+                offset, offset + length - 1, blocksCorrected, lastBlock - firstBlock + 1, 
+                inputFilename, recuperationFilename, out);
+    }else{
+        fprintf(log, "The recuperation file is too short for the range 0x%08lX-0x%08lX!\n",
+                offset, offset + length - 1);
+    }
+
+    freeColumnParity(&columns);
+    fclose(inputFile);
+    fclose(recFile);
+    fclose(outputFile);
+}
+
+/***************************************************************************************************
+ * INCREMENTAL UPDATE
+ **************************************************************************************************/
+
+typedef struct{
+    FILE* inputFile;
+    FILE* recFile;
+    long inputFilesize;
+    long totalBlocks;
+    long depth;
+    long unit;
+    long chunkBlocks;
+
+    // Column parity of the recuperation file, if it has one. It's updated with the blocks.
+    ColumnParity columns;
+
+    // Integrity index of the recuperation file, if it has one. The regions with any updated block 
+    // get hashed again at the end.
+    int hasIndex;
+    MerkleTree tree;
+    unsigned char* dirtyRegions;
+
+    long blocksUpdated;
+} UpdateContext;
+
+// Encodes the [blocks] blocks of [data] starting at [firstBlock] and writes their recuperation data
+// over the old one. If the file is interleaved or has column parity, they are whole groups.
+static int updateBlocks(UpdateContext* ctx, long firstBlock, unsigned char* data, long blocks){
+    unsigned char rec[FILE_BUFFER_BLOCKS*REC_BYTES_PER_BLOCK];
+    unsigned char interleaved[FILE_BUFFER_BLOCKS*NUM_POINTS_SAMPLE];
+    if(ctx->depth > 1){
+        interleaveBlocks(data, interleaved, blocks, ctx->depth);
+        data = interleaved;
+    }
+    for(long i = 0; i < blocks; i++){
+        encodeBlock(data + i*NUM_POINTS_SAMPLE, rec + i*REC_BYTES_PER_BLOCK);
+    }
+    if(ctx->columns.data != NULL){
+        encodeColumns(data, blocks, ctx->columns.group, ctx->columns.parity, ctx->columns.data + 
+                      firstBlock/ctx->columns.group*columnGroupBytes(ctx->columns.parity));
+    }
+
+    fseek(ctx->recFile, firstBlock*REC_BYTES_PER_BLOCK, SEEK_SET);
+    if(fwrite(rec, REC_BYTES_PER_BLOCK, blocks, ctx->recFile) != (size_t) blocks) return -1;
+
+    if(ctx->hasIndex){
+        long last = (firstBlock + blocks - 1)/ctx->tree.regionBlocks;
+        for(long region = firstBlock/ctx->tree.regionBlocks; region <= last; region++){
+            ctx->dirtyRegions[region] = 1;
+        }
+    }
+    ctx->blocksUpdated += blocks;
+    return 0;
+}
+
+// Reads the blocks [firstBlock, lastBlock] of the input file, extended to whole groups, and updates
+// them.
+static int updateBlockRange(UpdateContext* ctx, long firstBlock, long lastBlock){
+    unsigned char data[FILE_BUFFER_BLOCKS*NUM_POINTS_SAMPLE];
+    firstBlock -= firstBlock % ctx->unit;
+    lastBlock += ctx->unit - 1 - lastBlock % ctx->unit;
+    if(lastBlock >= ctx->totalBlocks) lastBlock = ctx->totalBlocks - 1;
+
+    for(long block = firstBlock; block <= lastBlock; block += ctx->chunkBlocks){
+        long blocks = lastBlock - block + 1;
+        if(blocks > ctx->chunkBlocks) blocks = ctx->chunkBlocks;
+
+        // The last block of the file gets padded the same way as when it's encoded.
+        fseek(ctx->inputFile, block*NUM_POINTS_SAMPLE, SEEK_SET);
+        size_t dataRead = fread(data, 1, blocks*NUM_POINTS_SAMPLE, ctx->inputFile);
+        memset(data + dataRead, PADDING_BYTE, blocks*NUM_POINTS_SAMPLE - dataRead);
+
+        if(updateBlocks(ctx, block, data, blocks) < 0) return -1;
+    }
+    return 0;
+}
+
+// Compares the input file with [oldFile] and updates the runs of blocks (or groups, if the file is
+// interleaved or has column parity) that changed. Both files are read sequentially, but only the 
+// changes are encoded.
+static int updateChangedBlocks(UpdateContext* ctx, FILE* oldFile, long comparedBlocks){
+    unsigned char data[FILE_BUFFER_BLOCKS*NUM_POINTS_SAMPLE];
+    unsigned char oldData[FILE_BUFFER_BLOCKS*NUM_POINTS_SAMPLE];
+    long unit = ctx->unit;
+
+    fseek(ctx->inputFile, 0, SEEK_SET);
+    for(long block = 0; block < comparedBlocks; block += ctx->chunkBlocks){
+        long blocks = comparedBlocks - block;
+        if(blocks > ctx->chunkBlocks) blocks = ctx->chunkBlocks;
+
+        size_t dataRead = fread(data, 1, blocks*NUM_POINTS_SAMPLE, ctx->inputFile);
+        memset(data + dataRead, PADDING_BYTE, blocks*NUM_POINTS_SAMPLE - dataRead);
+        size_t oldRead = fread(oldData, 1, blocks*NUM_POINTS_SAMPLE, oldFile);
+        memset(oldData + oldRead, PADDING_BYTE, blocks*NUM_POINTS_SAMPLE - oldRead);
+        if(memcmp(data, oldData, blocks*NUM_POINTS_SAMPLE) == 0) continue;
+
+        for(long i = 0; i < blocks; ){
+            long run = 0;
+            while(i + run < blocks){
+                long length = blocks - i - run < unit ? blocks - i - run : unit;
+                if(memcmp(data + (i + run)*NUM_POINTS_SAMPLE, oldData + (i + run)*NUM_POINTS_SAMPLE, 
+                          length*NUM_POINTS_SAMPLE) == 0){
+                    break;
+                }
+                run += length;
+            }
+
+            if(run == 0){
+                i += unit;
+                continue;
+            }
+            if(updateBlocks(ctx, block + i, data + i*NUM_POINTS_SAMPLE, run) < 0) return -1;
+            i += run;
+        }
+    }
+    return 0;
+}
+
+// Hashes again the regions of the integrity index with updated blocks. If the number of regions
+// changed, the new tree keeps the hashes of the regions that are still the same.
+static int updateIntegrityIndex(UpdateContext* ctx){
+    MerkleTree* tree = &ctx->tree;
+    if(tree->dataLength != ctx->inputFilesize){
+        MerkleTree resized;
+        if(initMerkleTree(&resized, ctx->inputFilesize, tree->regionBlocks) < 0) return -1;
+
+        // Only the regions that were full on both files can be kept.
+        long shortest = tree->dataLength < ctx->inputFilesize ? tree->dataLength : ctx->inputFilesize;
+        long keptRegions = shortest/merkleRegionBytes(tree);
+        unsigned char* dirtyRegions = calloc(resized.numLeaves, 1);
+        if(dirtyRegions == NULL) return -1;
+        for(long i = 0; i < resized.numLeaves; i++){
+            if(i < keptRegions && !ctx->dirtyRegions[i]){
+                resized.nodes[i] = tree->nodes[i];
+            }else{
+                dirtyRegions[i] = 1;
+            }
+        }
+        freeMerkleTree(tree);
+        free(ctx->dirtyRegions);
+        *tree = resized;
+        ctx->dirtyRegions = dirtyRegions;
+
+        for(long i = 0; i < tree->numLeaves; i++){
+            if(dirtyRegions[i] && hashMerkleRegion(tree, ctx->inputFile, i, &tree->nodes[i]) < 0){
+                return -1;
+            }
+        }
+        buildMerkleTree(tree);
+        return 0;
+    }
+
+    for(long i = 0; i < tree->numLeaves; i++){
+        if(!ctx->dirtyRegions[i]) continue;
+        MerkleHash hash;
+        if(hashMerkleRegion(tree, ctx->inputFile, i, &hash) < 0) return -1;
+        updateMerkleLeaf(tree, i, hash);
+    }
+    return 0;
+}
+
+void updateRecuperationFile(const char* inputFilename, const char* recuperationFilename, 
+                            const char* oldFilename, const long* offsets, const long* lengths, 
+                            int numRanges){
+    FILE* inputFile = fopen(inputFilename, "rb");
+    if (inputFile == NULL) {
+        printf("File %s. ", inputFilename);
+        fflush(stdout);
+        perror("Error opening input file");
+        exit(-1);
+    }
+
+    FILE* recFile = fopen(recuperationFilename, "r+b");
+    if (recFile == NULL) {
+        printf("File %s. ", recuperationFilename);
+        fflush(stdout);
+        perror("Error opening the recuperation file");
+        fclose(inputFile);
+        exit(-1);
+    }
+
+    FILE* oldFile = NULL;
+    if(oldFilename != NULL && (oldFile = fopen(oldFilename, "rb")) == NULL){
+        printf("File %s. ", oldFilename);
+        fflush(stdout);
+        perror("Error opening the old input file");
+        fclose(inputFile);
+        fclose(recFile);
+        exit(-1);
+    }
+
+    UpdateContext ctx = {
+        .inputFile = inputFile,
+        .recFile = recFile,
+        .inputFilesize = getFileSize(inputFile),
+    };
+    ctx.totalBlocks = (ctx.inputFilesize + NUM_POINTS_SAMPLE - 1)/NUM_POINTS_SAMPLE;
+
+    RecTrailer trailer;
+    if(readRecTrailer(recFile, getFileSize(recFile), &trailer) < 0){
+        printf("The trailer of %s is malformed.\n", recuperationFilename);
+        exit(-1);
+    }
+    long oldBlocks = trailer.parityLength/REC_BYTES_PER_BLOCK;
+    if(trailer.parityLength % REC_BYTES_PER_BLOCK != 0 || (oldFile != NULL && 
+       (getFileSize(oldFile) + NUM_POINTS_SAMPLE - 1)/NUM_POINTS_SAMPLE != oldBlocks)){
+        printf("The recuperation file %s doesn't belong to %s.\n", recuperationFilename, 
+               oldFile != NULL ? oldFilename : "the old data");
+        exit(-1);
+    }
+
+    // The layout of the file cannot change without encoding it again. The column parity gets the 
+    // groups of the new size.
+    ctx.depth = trailerInterleaveDepth(&trailer, 1);
+    loadColumnParity(&trailer, oldBlocks, ctx.depth, &ctx.columns);
+    if(ctx.columns.data != NULL){
+        ctx.columns.numGroups = (ctx.totalBlocks + ctx.columns.group - 1)/ctx.columns.group;
+        unsigned char* data = realloc(ctx.columns.data, 
+                                      ctx.columns.numGroups*columnGroupBytes(ctx.columns.parity) + 1);
+        if(data == NULL){
+            perror("Error allocating the column parity");
+            exit(-1);
+        }
+        ctx.columns.data = data;
+    }else if(findTrailerSection(&trailer, COLUMN_SECTION_TAG) != NULL){
+        printf("The column parity is damaged, it will be removed.\n");
+    }
+    ctx.unit = layoutUnit(ctx.depth, ctx.columns.group);
+    ctx.chunkBlocks = chunkBlocksFor(ctx.unit);
+
+    // The index is updated too. If it was already damaged, it gets dropped.
+    const TrailerSection* section = findTrailerSection(&trailer, MERKLE_SECTION_TAG);
+    if(section != NULL && deserializeMerkleTree(section, &ctx.tree) == 0){
+        if(isMerkleTreeConsistent(&ctx.tree)){
+            ctx.hasIndex = 1;
+            ctx.dirtyRegions = calloc(ctx.tree.numLeaves + 
+                                      ctx.totalBlocks/ctx.tree.regionBlocks + 1, 1);
+        }else{
+            printf("The integrity index is damaged, it will be removed.\n");
+            freeMerkleTree(&ctx.tree);
+        }
+    }
+
+    // Blocks that exist on both versions are only updated if they changed. The last block of the 
+    // old file (its padding can change) and the new blocks are always encoded.
+    long sharedBlocks = oldBlocks < ctx.totalBlocks ? oldBlocks : ctx.totalBlocks;
+    int ret = 0;
+    if(oldFile != NULL){
+        ret = updateChangedBlocks(&ctx, oldFile, sharedBlocks);
+    }else{
+        for(int i = 0; i < numRanges && ret == 0; i++){
+            if(offsets[i] < 0 || lengths[i] <= 0 || offsets[i] >= ctx.inputFilesize) continue;
+            ret = updateBlockRange(&ctx, offsets[i]/NUM_POINTS_SAMPLE, 
+                                   (offsets[i] + lengths[i] - 1)/NUM_POINTS_SAMPLE);
+        }
+    }
+    if(ret == 0 && ctx.totalBlocks > 0){
+        ret = updateBlockRange(&ctx, sharedBlocks > 0 ? sharedBlocks - 1 : 0, ctx.totalBlocks - 1);
+    }
+
+    // The trailer goes right after the new recuperation data. Its other sections stay the same.
+    TrailerSection sections[TRAILER_MAX_SECTIONS];
+    int numSections = 0;
+    for(int i = 0; i < trailer.numSections; i++){
+        if(memcmp(trailer.sections[i].tag, MERKLE_SECTION_TAG, 4) != 0 && 
+           memcmp(trailer.sections[i].tag, COLUMN_SECTION_TAG, 4) != 0){
+            sections[numSections++] = trailer.sections[i];
+        }
+    }
+    unsigned char* columns = NULL;
+    if(ret == 0 && ctx.columns.data != NULL){
+        ret = serializeColumnParity(&ctx.columns, &sections[numSections]);
+        if(ret == 0) columns = sections[numSections++].payload;
+    }
+    unsigned char* index = NULL;
+    if(ret == 0 && ctx.hasIndex){
+        ret = updateIntegrityIndex(&ctx);
+        if(ret == 0) ret = serializeMerkleTree(&ctx.tree, &sections[numSections]);
+        if(ret == 0) index = sections[numSections++].payload;
+    }
+    fseek(recFile, ctx.totalBlocks*REC_BYTES_PER_BLOCK, SEEK_SET);
+    if(ret == 0 && numSections > 0) ret = writeRecTrailer(recFile, sections, numSections);
+    free(columns);
+    free(index);
+    freeRecTrailer(&trailer);
+    freeColumnParity(&ctx.columns);
+    if(ret == 0) ret = fflush(recFile) != 0 || ftruncate(fileno(recFile), ftell(recFile)) < 0 ? -1 : 0;
+
+    if(ret < 0){
+        perror("Error updating the recuperation file");
+        exit(-1);
+    }
+    printf("Recuperation file updated! %ld of %ld blocks encoded again. (%s) -> %s\n",
+           ctx.blocksUpdated, ctx.totalBlocks, inputFilename, recuperationFilename);
+
+    if(ctx.hasIndex){
+        freeMerkleTree(&ctx.tree);
+        free(ctx.dirtyRegions);
+    }
+    if(oldFile != NULL) fclose(oldFile);
+    fclose(inputFile);
+    fclose(recFile);
+}
 
 /***************************************************************************************************
- * FILE REPARATION
+ * FILE SCAN
  **************************************************************************************************/
 
-void createRecuperationFile(const char* filename, const char* out){
-    FILE* inputFile = fopen(filename, "rb");
+// scanFile() writes the blocks it can fix back to the data file.
+static int scanRepair = 0;
+
+void setScanRepair(int repair){
+    scanRepair = repair;
+}
+
+// Writes the [blocks] blocks of the chunk starting at [firstBlock] back to [inputFile] if any of 
+// them was fixed. Returns the number of blocks fixed or -1 on error.
+static long repairChunk(FILE* inputFile, long firstBlock, unsigned char* data, 
+                        unsigned char* blocksData, const AlgorithmReturn* results, long blocks, 
+                        size_t dataLength, long depth){
+    long fixed = 0;
+    for(long i = 0; i < blocks; i++) fixed += results[i] == FIXED_OK;
+    if(fixed == 0) return 0;
+
+    // The blocks that couldn't be fixed are left as they were.
+    if(depth > 1) deinterleaveBlocks(blocksData, data, blocks, depth);
+    if(pwriteAll(fileno(inputFile), data, dataLength, firstBlock*NUM_POINTS_SAMPLE) < 0) return -1;
+    return fixed;
+}
+
+// A run of consecutive damaged blocks.
+typedef struct{
+    long firstBlock;
+    long lastBlock;
+    // Estimated number of wrong points. Blocks that couldn't be fixed count as EXTRA_POINTS errors,
+    // which is the minimum needed to get a block out of reach of the algorithm.
+    long errors;
+    long unrepairable;
+} DamagedRange;
+
+// On interleaved files, the bytes of the range are the ones of the groups of its blocks.
+static void printDamagedRange(DamagedRange* range, long depth, long inputFilesize, int jsonOutput, 
+                              int isFirst){
+    long offset = (range->firstBlock - range->firstBlock % depth)*NUM_POINTS_SAMPLE;
+    long end = (range->lastBlock - range->lastBlock % depth + depth)*NUM_POINTS_SAMPLE;
+    if(end > inputFilesize) end = inputFilesize;
+
+    if(jsonOutput){
+        printf("%s\n    {\"first_block\": %ld, \"last_block\": %ld, \"offset\": %ld, \"length\": %ld, "
+               "\"errors\": %ld, \"unrepairable\": %ld}", 
+               isFirst ? "" : ",", range->firstBlock, range->lastBlock, offset, end - offset, 
+               range->errors, range->unrepairable);
+    }else{
+        printf("Blocks %ld-%ld (0x%08lX-0x%08lX): %ld errors%s\n", 
+               range->firstBlock, range->lastBlock, offset, end - 1, range->errors, 
+               range->unrepairable ? " (unrepairable)" : "");
+    }
+}
+
+ScanStatus scanFile(const char* inputFilename, const char* recuperationFilename, int jsonOutput){
+    FILE* inputFile = fopen(inputFilename, scanRepair ? "r+b" : "rb");
     if (inputFile == NULL) {
-        printf("File %s. ", filename);
+        printf("File %s. ", inputFilename);
         fflush(stdout);
-        perror("Error message");
+        perror("Error opening input file");
         exit(-1);
     }
 
-    FILE* outputFile = fopen(out, "wb");
-    if (outputFile == NULL) {
-        printf("File %s. ", out);
+    // The recuperation data of the blocks whose data is known to be right gets repaired too.
+    FILE* recFile = fopen(recuperationFilename, scanRepair ? "r+b" : "rb");
+    if (recFile == NULL) {
+        printf("File %s. ", recuperationFilename);
         fflush(stdout);
-        perror("Error creating output file");
+        perror("Error opening the recuperation file");
         fclose(inputFile);
         exit(-1);
     }
 
     fseek(inputFile, 0, SEEK_END);
-    long fileSize = ftell(inputFile);
+    long inputFilesize = ftell(inputFile);
     fseek(inputFile, 0, SEEK_SET);
 
-    int x[NUM_POINTS_SAMPLE];
-    int y[NUM_POINTS_SAMPLE];
+    fseek(recFile, 0, SEEK_END);
+    long recFilesize = ftell(recFile);
+    fseek(recFile, 0, SEEK_SET);
+
+    // Only the recuperation data is compared with the blocks of the input, not the trailer.
+    RecTrailer trailer;
+    int malformedTrailer = readRecTrailer(recFile, recFilesize, &trailer) < 0;
+    long parityLength = trailer.parityLength;
 
-    for(int i = 0; i < NUM_POINTS_SAMPLE; i++)    x[i] = i;
+    // The integrity index messages would break the JSON output.
+    DamagedRegions regions;
+    loadIntegrityIndex(inputFile, inputFilesize, &trailer, jsonOutput ? stderr : stdout, &regions);
+    long depth = trailerInterleaveDepth(&trailer, 1);
 
-    long filePosition = 0;
-    while(filePosition < fileSize){
-        printLoadingBar(filePosition, fileSize);
-        memset(y, 0, sizeof(y));
+    long totalBlocks = (inputFilesize + NUM_POINTS_SAMPLE - 1)/NUM_POINTS_SAMPLE;
+    int misaligned = malformedTrailer || parityLength != totalBlocks*REC_BYTES_PER_BLOCK;
+    if(misaligned && parityLength/REC_BYTES_PER_BLOCK < totalBlocks){
+        totalBlocks = parityLength/REC_BYTES_PER_BLOCK;
+    }
+
+    // The blocks the column parity can recuperate are damaged but not unrepairable.
+    ColumnParity columns;
+    loadColumnParity(&trailer, parityLength/REC_BYTES_PER_BLOCK, depth, &columns);
+    long chunkBlocks = chunkBlocksFor(layoutUnit(depth, columns.group));
+    freeRecTrailer(&trailer);
+
+    if(jsonOutput){
+        printf("{\n  \"data\": \"%s\",\n  \"recuperation\": \"%s\",\n  \"ranges\": [", 
+               inputFilename, recuperationFilename);
+    }
 
-        for(int i = 0; i < NUM_POINTS_SAMPLE; i++){
-            unsigned char read = fgetc(inputFile);
+    unsigned char data[FILE_BUFFER_BLOCKS*NUM_POINTS_SAMPLE];
+    unsigned char interleaved[FILE_BUFFER_BLOCKS*NUM_POINTS_SAMPLE];
+    unsigned char rec[FILE_BUFFER_BLOCKS*REC_BYTES_PER_BLOCK];
+    AlgorithmReturn results[FILE_BUFFER_BLOCKS];
+    int errorsFound[FILE_BUFFER_BLOCKS];
+    unsigned char parityDamaged[FILE_BUFFER_BLOCKS];
+
+    DamagedRange range = {.firstBlock = -1};
+    long damagedBlocks = 0;
+    long damagedParityBlocks = 0;
+    long unrepairableBlocks = 0;
+    long columnsRecovered = 0;
+    long repairedBlocks = 0;
+    long numRanges = 0;
+
+    for(long block = 0; block < totalBlocks; block += chunkBlocks){
+        long blocks = totalBlocks - block;
+        if(blocks > chunkBlocks) blocks = chunkBlocks;
+
+        // The last block of the file gets padded the same way as when it was encoded.
+        throttleRead(blocks*(NUM_POINTS_SAMPLE + REC_BYTES_PER_BLOCK));
+        size_t dataRead = fread(data, 1, blocks*NUM_POINTS_SAMPLE, inputFile);
+        memset(data + dataRead, PADDING_BYTE, blocks*NUM_POINTS_SAMPLE - dataRead);
+        if(fread(rec, REC_BYTES_PER_BLOCK, blocks, recFile) != (size_t) blocks){
+            misaligned = 1;
+            break;
+        }
 
-            if(read == EOF) break;
+        unsigned char* blocksData = data;
+        if(depth > 1){
+            interleaveBlocks(data, interleaved, blocks, depth);
+            blocksData = interleaved;
+        }
 
-            y[i] = read; 
+        for(long i = 0; i < blocks; i++){
+            results[i] = WITHOUT_ERRORS;
+            parityDamaged[i] = 0;
         }
+        long parityFixed = 0;
+        for(long i = 0; i < blocks; i++){
+            unsigned char* blockData = blocksData + i*NUM_POINTS_SAMPLE;
+            unsigned char* blockRec = rec + i*REC_BYTES_PER_BLOCK;
+
+            // Runs of uniform blocks with their expected recuperation data are OK.
+            long uniform = countUniformBlocks(blockData, blockRec, blocks - i);
+            if(uniform > 0){
+                i += uniform - 1;
+                continue;
+            }
+
+            // Fast check: if the data generates the same recuperation data, the block is OK.
+            unsigned char expected[REC_BYTES_PER_BLOCK];
+            encodeBlock(blockData, expected);
+            if(memcmp(expected, blockRec, REC_BYTES_PER_BLOCK) == 0) continue;
 
-        int xx[RS_MAX_POLY_DEGREE];
-        int yy[RS_MAX_POLY_DEGREE + 1];
-        addErrorCorrectionFields(x, y, NUM_POINTS_SAMPLE, xx, yy);
+            // The integrity index only covers the data: if it says the data is right, the 
+            // recuperation data is the one that went bad. The points of a block are spread over its 
+            // whole group.
+            long group = i - i % depth;
+            long groupBlocks = blocks - group < depth ? blocks - group : depth;
+            if(areBlocksVerified(&regions, block + group, groupBlocks)){
+                parityDamaged[i] = 1;
+                errorsFound[i] = 0;
+                for(int j = 0; j < REC_BYTES_PER_BLOCK; j++) errorsFound[i] += expected[j] != blockRec[j];
+                memcpy(blockRec, expected, REC_BYTES_PER_BLOCK);
+                parityFixed++;
+                continue;
+            }
+
+            // Otherwise, decode it to estimate how many errors there are.
+            results[i] = decodeBlock(blockData, blockRec, &errorsFound[i]);
+            if(results[i] == WITHOUT_ERRORS) results[i] = FIXED_OK;
+        }
+        columnsRecovered += repairWithColumns(&columns, block, blocksData, rec, results, errorsFound, 
+                                              blocks);
+        // The files of a misaligned pair don't belong together, so nothing is written.
+        if(scanRepair && !misaligned){
+            long fixed = repairChunk(inputFile, block, data, blocksData, results, blocks, dataRead, 
+                                     depth);
+            if(fixed < 0){
+                perror("Error repairing the input file");
+                exit(-1);
+            }
+            repairedBlocks += fixed;
 
-        for(int j = NUM_POINTS_SAMPLE; j < RS_MAX_POLY_DEGREE+1; j++){
-            unsigned char putData = yy[j] & 0xFF;
-            int writeResult = fputc(putData, outputFile);
-            if(writeResult == EOF){
-                printf("\nThe program is not writing properly. %d => %d\n", putData, writeResult);
-                fclose(inputFile);
-                fclose(outputFile);
+            if(parityFixed > 0 && pwriteAll(fileno(recFile), rec, blocks*REC_BYTES_PER_BLOCK, 
+                                            block*REC_BYTES_PER_BLOCK) < 0){
+                perror("Error repairing the recuperation file");
                 exit(-1);
             }
+            repairedBlocks += parityFixed;
         }
 
-        filePosition += NUM_POINTS_SAMPLE;
-        fseek(inputFile, filePosition, SEEK_SET);
+        for(long i = 0; i < blocks; i++){
+            if(results[i] == WITHOUT_ERRORS && !parityDamaged[i]) continue;
+            int errors = errorsFound[i];
+
+            // Extend the current range or close it and start a new one.
+            if(range.firstBlock < 0 || range.lastBlock != block + i - 1){
+                if(range.firstBlock >= 0){
+                    printDamagedRange(&range, depth, inputFilesize, jsonOutput, numRanges++ == 0);
+                }
+                range = (DamagedRange){.firstBlock = block + i};
+            }
+            range.lastBlock = block + i;
+            range.errors += errors < 0 ? EXTRA_POINTS : errors;
+            range.unrepairable += results[i] < 0;
+
+            damagedBlocks++;
+            damagedParityBlocks += parityDamaged[i];
+            unrepairableBlocks += results[i] < 0;
+        }
+    }
+    if(range.firstBlock >= 0){
+        printDamagedRange(&range, depth, inputFilesize, jsonOutput, numRanges++ == 0);
     }
-    printLoadingBar(fileSize, fileSize);
+    free(regions.damaged);
+    freeColumnParity(&columns);
 
-    if(filePosition >= fileSize){
-        printf("\nFile completely error proofed! %s -> %s\n", filename, out);
+    ScanStatus status = SCAN_CLEAN;
+    if(damagedBlocks > 0)       status = SCAN_REPAIRABLE;
+    if(unrepairableBlocks > 0)  status = SCAN_UNREPAIRABLE;
+    if(misaligned)              status = SCAN_MISALIGNED;
+
+    const char* statusNames[] = {"clean", "repairable", "unrepairable", "misaligned"};
+    if(jsonOutput){
+        printf("%s],\n  \"blocks\": %ld,\n  \"damaged_blocks\": %ld,\n  \"unrepairable_blocks\": %ld,\n"
+               "  \"column_recuperable_blocks\": %ld,\n  \"damaged_parity_blocks\": %ld,\n"
+               "  \"status\": \"%s\"\n}\n", 
+               numRanges ? "\n  " : "", totalBlocks, damagedBlocks, unrepairableBlocks, 
+               columnsRecovered, damagedParityBlocks, statusNames[status]);
     }else{
-        printf("\nFile wasn't completely processed!\n");
+        printf("Scan completed: %ld of %ld blocks damaged, %ld unrepairable", 
+               damagedBlocks, totalBlocks, unrepairableBlocks);
+        if(columnsRecovered > 0) printf(" (%ld of them recuperable with the column parity)", columnsRecovered);
+        if(damagedParityBlocks > 0){
+            printf(" (%ld of them with damaged recuperation data)", damagedParityBlocks);
+        }
+        printf(". Status: %s (%s, %s)\n", statusNames[status], inputFilename, recuperationFilename);
+        if(scanRepair) printf("%ld blocks repaired in place.\n", repairedBlocks);
+    }
+    if(repairedBlocks > 0 && (fsync(fileno(inputFile)) < 0 || fsync(fileno(recFile)) < 0)){
+        perror("Error repairing the input file");
+        exit(-1);
     }
 
     fclose(inputFile);
-    fclose(outputFile);
+    fclose(recFile);
+    return status;
 }
 
-void recuperateFile(const char* inputFilename, const char* recuperationFilename, const char* out){
-    FILE* inputFile = fopen(inputFilename, "rb");
+/***************************************************************************************************
+ * FILE CHECKSUM
+ **************************************************************************************************/
+
+int checksumFile(const char* inputFilename, const char* expected){
+    FILE* inputFile = isStdStream(inputFilename) ? stdin : fopen(inputFilename, "rb");
     if (inputFile == NULL) {
         printf("File %s. ", inputFilename);
         fflush(stdout);
         perror("Error opening input file");
         exit(-1);
     }
+    adviseSequential(inputFile);
 
-    FILE* recFile = fopen(recuperationFilename, "rb");
-    if (recFile == NULL) {
-        printf("File %s. ", recuperationFilename);
-        fflush(stdout);
-        perror("Error opening the recuperation file");
-        fclose(inputFile);
+    unsigned char* buffer = malloc(CHECKSUM_BUFFER_SIZE);
+    if(buffer == NULL){
+        perror("Error allocating the checksum buffer");
         exit(-1);
     }
 
-    FILE* outputFile = fopen(out, "wb");
-    if (outputFile == NULL) {
-        printf("File %s. ", out);
-        fflush(stdout);
-        perror("Error creating output file");
-        fclose(inputFile);
-        fclose(recFile);
+    unsigned int crc32 = 0;
+    unsigned short crc = CRC16_INITIAL;
+    long size = 0;
+    size_t bytesRead;
+    while((bytesRead = fread(buffer, 1, CHECKSUM_BUFFER_SIZE, inputFile)) > 0){
+        crc32 = crc32c(crc32, buffer, bytesRead);
+        crc = crc16Update(crc, buffer, bytesRead);
+        size += bytesRead;
+    }
+    if(ferror(inputFile)){
+        perror("Error reading the input file");
         exit(-1);
     }
+    free(buffer);
+    if(inputFile != stdin) fclose(inputFile);
 
-    fseek(inputFile, 0, SEEK_END);
-    long inputFilesize = ftell(inputFile);
-    fseek(inputFile, 0, SEEK_SET);
+    printf("CRC32C: %08X CRC-16: %04X Size: %ld (%s, %s)\n", 
+           crc32, crc, size, inputFilename, checksumImplementation());
+    if(expected == NULL) return 0;
 
-    fseek(recFile, 0, SEEK_END);
-    long recFilesize = ftell(recFile);
-    fseek(recFile, 0, SEEK_SET);
+    int matches = strtoul(expected, NULL, 16) == crc32;
+    printf("Checksum %s: expected %s.\n", matches ? "OK" : "MISMATCH", expected);
+    return matches ? 0 : 1;
+}
 
-    int x[RS_MAX_POLY_DEGREE];
-    int y[RS_MAX_POLY_DEGREE+1];
+/***************************************************************************************************
+ * BATCH
+ **************************************************************************************************/
 
-    for(int i = 0; i < RS_MAX_POLY_DEGREE; i++)    x[i] = i;
+// Blocks of every task of a batch. Larger files are split in ranges of about this size, so they 
+// are shared by the threads like the small ones.
+#define BATCH_RANGE_BLOCKS      (128*1024)
 
-    long filePosition = 0;
-    long correctionPosition = 0;
-    long blocksCorrected = 0;
-    long totalBlocks = 0;
-    while(filePosition < inputFilesize && correctionPosition < recFilesize){
-        printLoadingBar(filePosition, inputFilesize);
-        memset(y, 0, sizeof(y));
+// Files of a batch that can be open at the same time, each with its data and recuperation files. 
+// It's lowered if the process can't open that many files.
+#define BATCH_MAX_OPEN_FILES    64
+
+typedef struct{
+    char* dataFilename;
+    char* recFilename;
+    int dataFd;
+    int recFd;
+    // Stream of [recFd] when the trailer is read or written through it.
+    FILE* recFile;
+    long dataSize;
+    long blocks;
+
+    // Layout of the recuperation file. The integrity index is only built when encoding.
+    long depth;
+    ColumnParity columns;
+    MerkleTree index;
+    int hasIndex;
+    int misaligned;
+
+    // CRC32C of the recuperation file on the list, if it came from the results of another batch.
+    int hasExpectedCrc;
+    unsigned int expectedCrc;
+
+    // Set up when the file is opened: the tasks are ranges of [rangeBlocks] blocks.
+    long rangeBlocks;
+    struct timespec start;
+
+    // Updated by the workers with the lock of the batch. A file is opened by the worker that takes 
+    // it from the list and it's ready once its ranges are known.
+    int ready;
+    long nextBlock;
+    long rangesToGive;
+    long rangesLeft;
+    long long nanoseconds;
+    long damagedBlocks;
+    long unrepairableBlocks;
+    int failed;
+
+    // Set by the worker of the last task, which closes the file.
+    long recSize;
+    unsigned int recCrc;
+} BatchFile;
+
+// A range of blocks of a file.
+typedef struct{
+    BatchFile* file;
+    long firstBlock;
+    long blocks;
+} BatchTask;
+
+typedef struct{
+    BatchFile* files;
+    long numFiles;
+    long filesCapacity;
 
-        for(int i = 0; i < NUM_POINTS_SAMPLE; i++){
-            unsigned char read = fgetc(inputFile);
+    // The files are opened in order. The ones before [firstPending] have given all their ranges.
+    long nextFile;
+    long firstPending;
+    int openFiles;
+    int openingFiles;
+    int maxOpenFiles;
 
-            if(read == EOF) break;
+    int verify;
+    pthread_mutex_t lock;
+    // Signaled when a file is ready or closed.
+    pthread_cond_t changed;
+} Batch;
 
-            y[i] = read; 
+static void addBatchFile(Batch* batch, const char* dataFilename, const unsigned int* expectedCrc){
+    if(batch->numFiles == batch->filesCapacity){
+        long capacity = batch->filesCapacity ? 2*batch->filesCapacity : 64;
+        BatchFile* files = realloc(batch->files, capacity*sizeof(BatchFile));
+        if(files == NULL){
+            perror("Error allocating the batch");
+            exit(-1);
         }
+        batch->files = files;
+        batch->filesCapacity = capacity;
+    }
+
+    BatchFile* file = &batch->files[batch->numFiles++];
+    memset(file, 0, sizeof(BatchFile));
+    file->dataFilename = strdup(dataFilename);
+    file->recFilename = malloc(strlen(dataFilename) + 5);
+    if(file->dataFilename == NULL || file->recFilename == NULL){
+        perror("Error allocating the batch");
+        exit(-1);
+    }
+    sprintf(file->recFilename, "%s.rec", dataFilename);
+    file->dataFd = file->recFd = -1;
+    file->hasExpectedCrc = expectedCrc != NULL;
+    if(expectedCrc != NULL) file->expectedCrc = *expectedCrc;
+}
+
+static int endsWith(const char* text, const char* suffix){
+    size_t length = strlen(text), suffixLength = strlen(suffix);
+    return length >= suffixLength && strcmp(text + length - suffixLength, suffix) == 0;
+}
 
-        for(int i = NUM_POINTS_SAMPLE; i < RS_MAX_POLY_DEGREE+1; i++){
-            unsigned char read = fgetc(recFile);
+// Adds every file of [path] and its subdirectories but the recuperation files.
+static void listBatchDirectory(Batch* batch, const char* path){
+    DIR* dir = opendir(path);
+    if(dir == NULL){
+        printf("Directory %s. ", path);
+        fflush(stdout);
+        perror("Error opening it");
+        return;
+    }
 
-            if(read == EOF) break;
+    struct dirent* entry;
+    while((entry = readdir(dir)) != NULL){
+        if(strcmp(entry->d_name, ".") == 0 || strcmp(entry->d_name, "..") == 0) continue;
 
-            y[i] = read; 
+        char child[strlen(path) + strlen(entry->d_name) + 2];
+        sprintf(child, "%s/%s", path, entry->d_name);
+        struct stat info;
+        if(lstat(child, &info) < 0) continue;
+        if(S_ISDIR(info.st_mode)){
+            listBatchDirectory(batch, child);
+        }else if(S_ISREG(info.st_mode) && !endsWith(child, ".rec") && !endsWith(child, ".tmp")){
+            addBatchFile(batch, child, NULL);
         }
+    }
+    closedir(dir);
+}
 
-        AlgorithmReturn success = verifyMessage(x, y, RS_MAX_POLY_DEGREE, NUM_POINTS_SAMPLE);
-        if(success < 0){
-            printf("\nError fixing the file at: 0x%08lX. Correction file position: 0x%08lX.\nData: ", filePosition, correctionPosition);
-            for(int i = 0; i < RS_MAX_POLY_DEGREE+1; i++){
-                if(i==NUM_POINTS_SAMPLE) printf(" - ");
-                printf("%02X", y[i]);
-            }
-            printf("\n");
+static int compareBatchFiles(const void* a, const void* b){
+    return strcmp(((const BatchFile*) a)->dataFilename, ((const BatchFile*) b)->dataFilename);
+}
+
+// Reads the files of a batch from [listFilename]: a directory, a list with a file per line or the 
+// results of another batch (see writeBatchResults()).
+static void readBatchList(Batch* batch, const char* listFilename){
+    struct stat info;
+    if(stat(listFilename, &info) == 0 && S_ISDIR(info.st_mode)){
+        listBatchDirectory(batch, listFilename);
+        qsort(batch->files, batch->numFiles, sizeof(BatchFile), compareBatchFiles);
+        return;
+    }
+
+    FILE* list = fopen(listFilename, "r");
+    if(list == NULL){
+        printf("File %s. ", listFilename);
+        fflush(stdout);
+        perror("Error opening the list of files");
+        exit(-1);
+    }
+
+    char* line = NULL;
+    size_t capacity = 0;
+    ssize_t length;
+    while((length = getline(&line, &capacity, list)) > 0){
+        if(line[length - 1] == '\n') line[--length] = '\0';
+        if(length == 0 || line[0] == '#') continue;
+
+        char status[16];
+        long dataSize, recSize, damaged;
+        long long microseconds;
+        unsigned int crc;
+        int nameStart = 0;
+        if(sscanf(line, "%15s %ld %ld %x %ld %lld %n", status, &dataSize, &recSize, &crc, &damaged, 
+                  &microseconds, &nameStart) == 6 && nameStart > 0 && line[nameStart] != '\0'){
+            addBatchFile(batch, line + nameStart, strcmp(status, "failed") != 0 ? &crc : NULL);
         }else{
-            blocksCorrected++;
+            addBatchFile(batch, line, NULL);
+        }
+    }
+    free(line);
+    fclose(list);
+}
+
+static long greatestCommonDivisor(long a, long b){
+    while(b != 0){
+        long rest = a % b;
+        a = b;
+        b = rest;
+    }
+    return a;
+}
+
+// Opens the files of [file] and splits it in ranges that hold whole units of the layout and whole
+// regions of the integrity index, so they can be done on their own. Called without the lock.
+static void openBatchFile(const Batch* batch, BatchFile* file){
+    clock_gettime(CLOCK_MONOTONIC, &file->start);
+    file->dataFd = open(file->dataFilename, O_RDONLY);
+    if(file->dataFd >= 0 && batch->verify){
+        file->recFile = fopen(file->recFilename, "rb");
+        if(file->recFile != NULL) file->recFd = fileno(file->recFile);
+    }else if(file->dataFd >= 0){
+        file->recFd = open(file->recFilename, O_RDWR | O_CREAT | O_TRUNC, 0666);
+    }
+    struct stat info;
+    if(file->dataFd < 0 || file->recFd < 0 || fstat(file->dataFd, &info) < 0){
+        printf("File %s. ", file->dataFd < 0 ? file->dataFilename : file->recFilename);
+        fflush(stdout);
+        perror("Error opening it");
+        if(file->dataFd >= 0)       close(file->dataFd);
+        if(file->recFile != NULL)   fclose(file->recFile);
+        else if(file->recFd >= 0)   close(file->recFd);
+        file->recFile = NULL;
+        file->failed = 1;
+        return;
+    }
+    file->dataSize = info.st_size;
+    file->blocks = (file->dataSize + NUM_POINTS_SAMPLE - 1)/NUM_POINTS_SAMPLE;
+
+    if(batch->verify){
+        // The same checks as scanFile().
+        long recSize = fstat(file->recFd, &info) == 0 ? info.st_size : 0;
+        RecTrailer trailer;
+        int malformed = readRecTrailer(file->recFile, recSize, &trailer) < 0;
+
+        file->depth = trailerInterleaveDepth(&trailer, 1);
+        file->misaligned = malformed || trailer.parityLength != file->blocks*REC_BYTES_PER_BLOCK;
+        if(file->misaligned && trailer.parityLength/REC_BYTES_PER_BLOCK < file->blocks){
+            file->blocks = trailer.parityLength/REC_BYTES_PER_BLOCK;
+        }
+        loadColumnParity(&trailer, trailer.parityLength/REC_BYTES_PER_BLOCK, file->depth, 
+                         &file->columns);
+        freeRecTrailer(&trailer);
+    }else{
+        file->depth = interleaveDepth;
+        if(columnGroup > 0){
+            file->columns = (ColumnParity){.group = columnGroup, .parity = columnParity};
+            file->columns.numGroups = (file->blocks + columnGroup - 1)/columnGroup;
+            file->columns.data = malloc(file->columns.numGroups*columnGroupBytes(columnParity) + 1);
+        }
+        file->hasIndex = indexRegionBlocks > 0;
+        if((columnGroup > 0 && file->columns.data == NULL) || 
+           (file->hasIndex && initMerkleTree(&file->index, file->dataSize, indexRegionBlocks) < 0)){
+            perror("Error allocating the batch");
+            exit(-1);
+        }
+        // An empty file still has one region.
+        if(file->hasIndex) file->index.nodes[0] = MERKLE_HASH_SEED;
+    }
+
+    long unit = layoutUnit(file->depth, file->columns.group);
+    if(file->hasIndex) unit = unit/greatestCommonDivisor(unit, indexRegionBlocks)*indexRegionBlocks;
+    file->rangeBlocks = (BATCH_RANGE_BLOCKS + unit - 1)/unit*unit;
+
+    // Even an empty file has a task, which writes its trailer.
+    file->rangesToGive = (file->blocks + file->rangeBlocks - 1)/file->rangeBlocks;
+    if(file->rangesToGive == 0) file->rangesToGive = 1;
+    file->rangesLeft = file->rangesToGive;
+}
+
+// Encodes the range of [task], like processEncodeChunk() and writeEncodeChunk() do with a chunk.
+static int encodeBatchRange(const BatchTask* task, unsigned char* data, unsigned char* interleaved, 
+                            unsigned char* rec){
+    BatchFile* file = task->file;
+    long dataLength = file->dataSize - task->firstBlock*NUM_POINTS_SAMPLE;
+    if(dataLength > task->blocks*NUM_POINTS_SAMPLE) dataLength = task->blocks*NUM_POINTS_SAMPLE;
+    if(preadAll(file->dataFd, data, dataLength, task->firstBlock*NUM_POINTS_SAMPLE) != dataLength){
+        return -1;
+    }
+    memset(data + dataLength, PADDING_BYTE, task->blocks*NUM_POINTS_SAMPLE - dataLength);
+
+    const unsigned char* blocks = data;
+    if(file->depth > 1){
+        interleaveBlocks(data, interleaved, task->blocks, file->depth);
+        blocks = interleaved;
+    }
+
+    for(long i = 0; i < task->blocks; ){
+        encodeBlock(blocks + i*NUM_POINTS_SAMPLE, rec + i*REC_BYTES_PER_BLOCK);
+        long uniform = countUniformBlocks(blocks + i*NUM_POINTS_SAMPLE, NULL, task->blocks - i);
+        for(long j = 1; j < uniform; j++){
+            memcpy(rec + (i + j)*REC_BYTES_PER_BLOCK, rec + i*REC_BYTES_PER_BLOCK, REC_BYTES_PER_BLOCK);
+        }
+        i += uniform > 1 ? uniform : 1;
+    }
+    if(pwriteAll(file->recFd, rec, task->blocks*REC_BYTES_PER_BLOCK, 
+                 task->firstBlock*REC_BYTES_PER_BLOCK) < 0){
+        return -1;
+    }
+
+    // The range starts on a group of the column parity and on a region of the index.
+    if(file->columns.group > 0){
+        encodeColumns(blocks, task->blocks, file->columns.group, file->columns.parity, 
+                      file->columns.data + task->firstBlock/file->columns.group*
+                                           columnGroupBytes(file->columns.parity));
+    }
+    if(file->hasIndex){
+        long regionBytes = merkleRegionBytes(&file->index);
+        long firstLeaf = task->firstBlock/file->index.regionBlocks;
+        for(long position = 0; position < dataLength; position += regionBytes){
+            long length = dataLength - position < regionBytes ? dataLength - position : regionBytes;
+            file->index.nodes[firstLeaf + position/regionBytes] = 
+                hashBytes(MERKLE_HASH_SEED, data + position, length);
         }
-        totalBlocks++;
+    }
+    return 0;
+}
+
+// Checks the range of [task], like scanFile() does with a chunk.
+static int verifyBatchRange(const BatchTask* task, unsigned char* data, unsigned char* interleaved, 
+                            unsigned char* rec, AlgorithmReturn* results, long* damaged, 
+                            long* unrepairable){
+    BatchFile* file = task->file;
+    long dataLength = file->dataSize - task->firstBlock*NUM_POINTS_SAMPLE;
+    if(dataLength > task->blocks*NUM_POINTS_SAMPLE) dataLength = task->blocks*NUM_POINTS_SAMPLE;
+    long recLength = task->blocks*REC_BYTES_PER_BLOCK;
+    if(preadAll(file->dataFd, data, dataLength, task->firstBlock*NUM_POINTS_SAMPLE) < 0 ||
+       preadAll(file->recFd, rec, recLength, task->firstBlock*REC_BYTES_PER_BLOCK) != recLength){
+        return -1;
+    }
+    memset(data + dataLength, PADDING_BYTE, task->blocks*NUM_POINTS_SAMPLE - dataLength);
 
-        // Save the corrected data.
-        for(int j = 0; j < NUM_POINTS_SAMPLE; j++){
-            char putData = y[j] & 0xFF;
-            fputc(putData, outputFile);
+    unsigned char* blocks = data;
+    if(file->depth > 1){
+        interleaveBlocks(data, interleaved, task->blocks, file->depth);
+        blocks = interleaved;
+    }
+
+    for(long i = 0; i < task->blocks; i++) results[i] = WITHOUT_ERRORS;
+    for(long i = 0; i < task->blocks; i++){
+        unsigned char* blockData = blocks + i*NUM_POINTS_SAMPLE;
+        unsigned char* blockRec = rec + i*REC_BYTES_PER_BLOCK;
+
+        long uniform = countUniformBlocks(blockData, blockRec, task->blocks - i);
+        if(uniform > 0){
+            i += uniform - 1;
+            continue;
         }
 
-        filePosition += NUM_POINTS_SAMPLE;
-        fseek(inputFile, filePosition, SEEK_SET);
-        correctionPosition += EXTRA_POINTS+1;
-        fseek(inputFile, filePosition, SEEK_SET);
+        unsigned char expected[REC_BYTES_PER_BLOCK];
+        encodeBlock(blockData, expected);
+        if(memcmp(expected, blockRec, REC_BYTES_PER_BLOCK) == 0) continue;
+
+        results[i] = decodeBlock(blockData, blockRec, NULL);
+        if(results[i] == WITHOUT_ERRORS) results[i] = FIXED_OK;
+    }
+    repairWithColumns(&file->columns, task->firstBlock, blocks, rec, results, NULL, task->blocks);
+
+    for(long i = 0; i < task->blocks; i++){
+        *damaged += results[i] != WITHOUT_ERRORS;
+        *unrepairable += results[i] < 0;
+    }
+    return 0;
+}
+
+// Done by the worker of the last task of [file]: the trailer of the recuperation file, its 
+// checksum and the time it took. The files are closed.
+static void finishBatchFile(const Batch* batch, BatchFile* file){
+    if(!batch->verify && !file->failed){
+        if(file->hasIndex) buildMerkleTree(&file->index);
+        file->recFile = fdopen(file->recFd, "r+b");
+        if(file->recFile == NULL || 
+           fseek(file->recFile, file->blocks*REC_BYTES_PER_BLOCK, SEEK_SET) < 0 ||
+           writeLayoutTrailer(file->recFile, file->depth, &file->columns, 
+                              file->hasIndex ? &file->index : NULL) < 0 || 
+           fflush(file->recFile) != 0){
+            file->failed = 1;
+        }
     }
-    printLoadingBar(inputFilesize, inputFilesize);
 
-    if(filePosition >= inputFilesize && correctionPosition >= recFilesize){
-        printf("\nCorrection completed! %ld of %ld blocks OK! (%s, %s) -> %s\n", 
-            blocksCorrected, totalBlocks, inputFilename, recuperationFilename, out);
+    struct stat info;
+    file->recSize = fstat(file->recFd, &info) == 0 ? info.st_size : 0;
+    if(crcFileRange(file->recFd, 0, file->recSize, &file->recCrc) < 0) file->failed = 1;
+
+    close(file->dataFd);
+    if(file->recFile != NULL){
+        if(fclose(file->recFile) != 0) file->failed = 1;
+        file->recFile = NULL;
     }else{
-        printf("\nThe files were misaligned or an external error happened!\n");
-        printf("Input: %ld/%ld, Correction: %ld/%ld\n", 
-            filePosition, inputFilesize, correctionPosition, recFilesize);
+        close(file->recFd);
     }
+    freeColumnParity(&file->columns);
+    if(file->hasIndex) freeMerkleTree(&file->index);
+    file->nanoseconds = elapsedNanoseconds(&file->start);
+}
 
-    fclose(inputFile);
-    fclose(recFile);
-    fclose(outputFile);
-}
\ No newline at end of file
+// Takes the next range of the open files or, if they have given them all, opens the next file of
+// the list, as long as there are less than [maxOpenFiles] open. Returns 0 when there's nothing 
+// left.
+static int nextBatchTask(Batch* batch, BatchTask* task){
+    pthread_mutex_lock(&batch->lock);
+    for(;;){
+        while(batch->firstPending < batch->nextFile && batch->files[batch->firstPending].ready && 
+              batch->files[batch->firstPending].rangesToGive == 0){
+            batch->firstPending++;
+        }
+        for(long i = batch->firstPending; i < batch->nextFile; i++){
+            BatchFile* file = &batch->files[i];
+            if(!file->ready || file->rangesToGive == 0) continue;
+
+            long blocks = file->blocks - file->nextBlock;
+            if(blocks > file->rangeBlocks) blocks = file->rangeBlocks;
+            *task = (BatchTask){file, file->nextBlock, blocks};
+            file->nextBlock += blocks;
+            file->rangesToGive--;
+            pthread_mutex_unlock(&batch->lock);
+            return 1;
+        }
+
+        if(batch->nextFile < batch->numFiles && batch->openFiles < batch->maxOpenFiles){
+            BatchFile* file = &batch->files[batch->nextFile++];
+            batch->openFiles++;
+            batch->openingFiles++;
+            pthread_mutex_unlock(&batch->lock);
+
+            openBatchFile(batch, file);
+
+            pthread_mutex_lock(&batch->lock);
+            file->ready = 1;
+            batch->openingFiles--;
+            // A file that couldn't be opened has nothing to do.
+            if(file->failed){
+                file->rangesToGive = 0;
+                batch->openFiles--;
+            }
+            pthread_cond_broadcast(&batch->changed);
+            continue;
+        }
+
+        // Every file has been opened and given all its ranges.
+        if(batch->nextFile == batch->numFiles && batch->openingFiles == 0){
+            pthread_mutex_unlock(&batch->lock);
+            return 0;
+        }
+        pthread_cond_wait(&batch->changed, &batch->lock);
+    }
+}
+
+static void* runBatchWorker(void* argument){
+    Batch* batch = argument;
+    unsigned char* buffers = NULL;
+    AlgorithmReturn* results = NULL;
+    long capacity = 0;
+
+    BatchTask taskData;
+    const BatchTask* task = &taskData;
+    while(nextBatchTask(batch, &taskData)){
+        BatchFile* file = task->file;
+
+        // The ranges of the files with a bigger layout are a bit longer.
+        if(task->blocks > capacity){
+            capacity = task->blocks;
+            free(buffers);
+            free(results);
+            buffers = malloc(capacity*(2*NUM_POINTS_SAMPLE + REC_BYTES_PER_BLOCK));
+            results = malloc(capacity*sizeof(AlgorithmReturn));
+            if(buffers == NULL || results == NULL){
+                perror("Error allocating the batch");
+                exit(-1);
+            }
+        }
+        unsigned char* data = buffers;
+        unsigned char* interleaved = data + capacity*NUM_POINTS_SAMPLE;
+        unsigned char* rec = interleaved + capacity*NUM_POINTS_SAMPLE;
+
+        long damaged = 0, unrepairable = 0;
+        int ret = batch->verify ? 
+            verifyBatchRange(task, data, interleaved, rec, results, &damaged, &unrepairable) :
+            encodeBatchRange(task, data, interleaved, rec);
+
+        pthread_mutex_lock(&batch->lock);
+        file->failed |= ret < 0;
+        file->damagedBlocks += damaged;
+        file->unrepairableBlocks += unrepairable;
+        int isLast = --file->rangesLeft == 0;
+        pthread_mutex_unlock(&batch->lock);
+
+        // Nobody else touches the file now.
+        if(isLast){
+            finishBatchFile(batch, file);
+            pthread_mutex_lock(&batch->lock);
+            batch->openFiles--;
+            pthread_cond_broadcast(&batch->changed);
+            pthread_mutex_unlock(&batch->lock);
+        }
+    }
+
+    free(buffers);
+    free(results);
+    return NULL;
+}
+
+static ScanStatus batchFileStatus(const BatchFile* file){
+    ScanStatus status = SCAN_CLEAN;
+    if(file->damagedBlocks > 0)         status = SCAN_REPAIRABLE;
+    if(file->unrepairableBlocks > 0)    status = SCAN_UNREPAIRABLE;
+    if(file->misaligned)                status = SCAN_MISALIGNED;
+    return status;
+}
+
+// One line per file, which can be given back as the list of files of another batch:
+//   <status> <data bytes> <recuperation bytes> <CRC32C of the recuperation file> <damaged blocks> 
+//   <microseconds> <data file>
+static void writeBatchResults(const Batch* batch, const char* resultsFilename){
+    FILE* results = fopen(resultsFilename, "w");
+    if(results == NULL){
+        printf("File %s. ", resultsFilename);
+        fflush(stdout);
+        perror("Error creating the results file");
+        exit(-1);
+    }
+
+    const char* statusNames[] = {"clean", "repairable", "unrepairable", "misaligned"};
+    fprintf(results, "# reed batch %s: <status> <data bytes> <rec bytes> <rec CRC32C> "
+                     "<damaged blocks> <microseconds> <data file>\n", 
+            batch->verify ? "verify" : "encode");
+    for(long i = 0; i < batch->numFiles; i++){
+        const BatchFile* file = &batch->files[i];
+        const char* status = file->failed ? "failed" : 
+                             batch->verify ? statusNames[batchFileStatus(file)] : "encoded";
+        fprintf(results, "%s %ld %ld %08X %ld %lld %s\n", status, file->dataSize, file->recSize, 
+                file->recCrc, file->damagedBlocks, file->nanoseconds/1000, file->dataFilename);
+    }
+    if(fclose(results) != 0){
+        perror("Error writing the results file");
+        exit(-1);
+    }
+}
+
+// Runs a whole batch and returns the worst ScanStatus of its files. The ones that failed count as
+// misaligned.
+static ScanStatus runBatch(const char* listFilename, const char* resultsFilename, int verify){
+    struct timespec startTime;
+    clock_gettime(CLOCK_MONOTONIC, &startTime);
+
+    Batch batch = {.verify = verify, .maxOpenFiles = BATCH_MAX_OPEN_FILES};
+    pthread_mutex_init(&batch.lock, NULL);
+    pthread_cond_init(&batch.changed, NULL);
+    readBatchList(&batch, listFilename);
+    if(!verify && layoutUnit(interleaveDepth, columnGroup) == 0){
+        printf("The groups of the interleaving (%ld) and the column parity (%ld) need more "
+               "than %d blocks together.\n", interleaveDepth, columnGroup, FILE_BUFFER_BLOCKS);
+        exit(-1);
+    }
+
+    // Two descriptors per open file, leaving some for the standard streams and the rest.
+    struct rlimit limit;
+    if(getrlimit(RLIMIT_NOFILE, &limit) == 0 && limit.rlim_cur != RLIM_INFINITY){
+        rlim_t allowed = limit.rlim_cur > 18 ? (limit.rlim_cur - 16)/2 : 1;
+        if(allowed < (rlim_t) batch.maxOpenFiles) batch.maxOpenFiles = allowed;
+    }
+
+    int numWorkers = defaultPipelineWorkers();
+    pthread_t workers[PIPELINE_MAX_WORKERS];
+    for(int i = 0; i < numWorkers; i++){
+        if(pthread_create(&workers[i], NULL, runBatchWorker, &batch) != 0){
+            perror("Error creating the batch threads");
+            exit(-1);
+        }
+    }
+    for(int i = 0; i < numWorkers; i++) pthread_join(workers[i], NULL);
+    pthread_mutex_destroy(&batch.lock);
+    pthread_cond_destroy(&batch.changed);
+    writeBatchResults(&batch, resultsFilename);
+
+    ScanStatus worst = SCAN_CLEAN;
+    long counts[SCAN_MISALIGNED + 1] = {0};
+    long failed = 0, changed = 0, bytes = 0;
+    for(long i = 0; i < batch.numFiles; i++){
+        BatchFile* file = &batch.files[i];
+        ScanStatus status = file->failed ? SCAN_MISALIGNED : batchFileStatus(file);
+        if(verify && status > worst) worst = status;
+        counts[status] += !file->failed;
+        failed += file->failed;
+        changed += !file->failed && file->hasExpectedCrc && file->expectedCrc != file->recCrc;
+        bytes += file->dataSize;
+        if(file->failed) worst = SCAN_MISALIGNED;
+    }
+    double seconds = elapsedNanoseconds(&startTime)/1e9;
+
+    printf("Batch %s completed: %ld files, %ld failed. %0.2f MB in %0.3f s (%0.2f MB/s) with %d "
+           "threads. Results on %s.\n", verify ? "verification" : "encoding", batch.numFiles, 
+           failed, bytes/1e6, seconds, seconds > 0 ? bytes/1e6/seconds : 0.0, numWorkers, 
+           resultsFilename);
+    if(verify){
+        printf("%ld clean, %ld repairable, %ld unrepairable, %ld misaligned.\n", counts[SCAN_CLEAN], 
+               counts[SCAN_REPAIRABLE], counts[SCAN_UNREPAIRABLE], counts[SCAN_MISALIGNED]);
+        if(changed > 0){
+            printf("%ld recuperation files changed since they were listed.\n", changed);
+        }
+    }
+
+    for(long i = 0; i < batch.numFiles; i++){
+        free(batch.files[i].dataFilename);
+        free(batch.files[i].recFilename);
+    }
+    free(batch.files);
+    return worst;
+}
+
+int batchEncode(const char* listFilename, const char* resultsFilename){
+    return runBatch(listFilename, resultsFilename, 0) == SCAN_CLEAN ? 0 : 1;
+}
+
+ScanStatus batchVerify(const char* listFilename, const char* resultsFilename){
+    return runBatch(listFilename, resultsFilename, 1);
+}
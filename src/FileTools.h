@@ -16,6 +16,25 @@
 #include "CommonDefines.h"
 #include "ReedSolomon.h"
 
+/***************************************************************************************************
+ * TYPES
+ **************************************************************************************************/
+
+// Result of scanFile(). It's also used as the exit status of the program.
+typedef enum{
+    // Every block is OK.
+    SCAN_CLEAN = 0,
+
+    // Some blocks are damaged, but all of them can be fixed.
+    SCAN_REPAIRABLE = 1,
+
+    // At least one block cannot be fixed.
+    SCAN_UNREPAIRABLE = 2,
+
+    // The sizes of the data and the recuperation files don't match.
+    SCAN_MISALIGNED = 3,
+} ScanStatus;
+
 /***************************************************************************************************
  * FUNCTIONS
  **************************************************************************************************/
@@ -24,7 +43,98 @@
 // corrupted.
 void createRecuperationFile(const char* filename, const char* out);
 
+// Makes createRecuperationFile() keep the recuperation data of the last blocks encoded on a cache of
+// [entries] entries per thread, so repeated blocks are not encoded again. 0 (the default) disables 
+// the cache.
+void setEncodeCacheSize(long entries);
+
+// Makes createRecuperationFile() append an integrity index to the recuperation file: a hash tree
+// over regions of [regionBlocks] blocks of the data (see Merkle.h). recuperateFile() and scanFile()
+// only run the Reed-Solomon verification on the regions that don't match it. 0 (the default) 
+// disables the index.
+void setIntegrityIndex(long regionBlocks);
+
+// Makes createRecuperationFile() interleave the blocks of the file with a depth of [depth] blocks
+// (see Interleave.h), so bursts of errors get spread over many blocks. The depth is saved on the 
+// recuperation file; it only needs to be given again to recuperate from a stream. 1 (the default) 
+// disables interleaving.
+void setInterleaveDepth(long depth);
+
+// Makes createRecuperationFile() add a column parity to the recuperation file: [parity] parity rows
+// for every [group] blocks (see ColumnParity.h). The blocks the Reed-Solomon decoder cannot fix get
+// recuperated with it as erasures, up to [parity] per group. It's not used when the recuperation 
+// data comes from a stream. A group of 0 (the default) disables it.
+void setColumnParity(long group, long parity);
+
+// Limits the number of combinations of points recuperateFile() checks per block on its first pass.
+// The blocks that need more get deferred and are fixed at the end, so a few bad blocks don't stall
+// the rest of the file. 0 (the default) means no limit.
+void setDecodeBudget(long maxCombinations);
+
+// Makes recuperateFile() compare the data with a second read of it, [filename], to know which bytes
+// are less reliable and try to fix those first.
+void setSecondRead(const char* filename);
+
+// Makes createRecuperationFile() and recuperateFile() save their progress on [filename] every 
+// [intervalSeconds] seconds (see Checkpoint.h), after flushing their output to the disk. The file 
+// is removed once the job is done. Checkpoints need files, not streams, and recuperateFile() 
+// doesn't defer the blocks over the budget nor write a report with them. NULL (the default) 
+// disables them.
+void setCheckpoint(const char* filename, long intervalSeconds);
+
+// Makes the jobs with a checkpoint continue from it, if it belongs to the same job and its output
+// hasn't changed since then. The output is the same as if the job had never stopped.
+void setResume(int resume);
+
+// Makes recuperateFile() write a report to [filename]: the outcome of every block, the damaged 
+// ranges, histograms of the errors and decoding times and the throughput (see RecoveryReport.h).
+// As JSON or, if [binary] is 1, in binary. NULL (the default) disables it.
+void setRecoveryReport(const char* filename, int binary);
+
 // Tries to recuperate [inputFilename] with the [recuperationFilename] file. 
 void recuperateFile(const char* inputFilename, const char* recuperationFilename, const char* out);
 
+// Same as recuperateFile(), but only the [length] bytes of [inputFilename] starting at [offset] 
+// are verified and written to [out]. Only the blocks covering that range are read.
+void recuperateRange(const char* inputFilename, const char* recuperationFilename, const char* out,
+                     long offset, long length);
+
+// Updates [recuperationFilename] after a partial change of [inputFilename], encoding only the 
+// blocks that changed (and its integrity index, if it has one). The changed blocks are found by 
+// comparing it with [oldFilename] or, if it's NULL, they are the [numRanges] ranges of [lengths] 
+// bytes starting at [offsets]. The blocks added or removed at the end of the file are always 
+// updated.
+void updateRecuperationFile(const char* inputFilename, const char* recuperationFilename, 
+                            const char* oldFilename, const long* offsets, const long* lengths, 
+                            int numRanges);
+
+// Checks [inputFilename] against [recuperationFilename] without writing anything. Prints the ranges
+// of damaged blocks with their estimated number of errors (as JSON if [jsonOutput] is set).
+ScanStatus scanFile(const char* inputFilename, const char* recuperationFilename, int jsonOutput);
+
+// Makes scanFile() write the blocks it can fix back to the data file, in place. The blocks that 
+// cannot be fixed are left as they are.
+void setScanRepair(int repair);
+
+// Prints the CRC32C and the CRC-16-CCITT of the whole [inputFilename] (see Checksum.h). If 
+// [expected] is not NULL, it's compared with the CRC32C (in hexadecimal). Returns 0 if it matches, 
+// or there's nothing to compare, and 1 if it doesn't.
+int checksumFile(const char* inputFilename, const char* expected);
+
+// Encodes every file of [listFilename] (a directory, which is walked with its subdirectories, or a
+// list with a data file per line) to DATA.rec, with the options of encodeFile(). The files, and the
+// ranges of the big ones, are shared by a pool of threads. Only a few files are open at a time, so
+// the list can be longer than the limit of open files. The outcome of every file is written to
+// [resultsFilename], one line per file:
+//   <status> <data bytes> <rec bytes> <rec CRC32C> <damaged blocks> <microseconds> <data file>
+// Returns 0 if every file was encoded and 1 if any of them failed.
+int batchEncode(const char* listFilename, const char* resultsFilename);
+
+// Checks every file of [listFilename] against its DATA.rec like scanFile(), with the same pool of
+// threads as batchEncode(). The list can also be the results of another batch: the CRC32C of the
+// recuperation files is then compared with the one on the list. Writes the outcome of every file 
+// to [resultsFilename] and returns the worst ScanStatus (the files that failed count as 
+// misaligned).
+ScanStatus batchVerify(const char* listFilename, const char* resultsFilename);
+
 #endif
\ No newline at end of file
@@ -0,0 +1,122 @@
+/***************************************************************************************************
+ * @file Instrumentation.c
+ * @brief Counters and timing spans of the codec.
+ *
+ * @version   1.0
+ * @date      2024-07-23
+ * @author    @dabecart
+ *
+ * @license
+ * This project is licensed under the MIT License - see the LICENSE file for details.
+ **************************************************************************************************/
+
+#include "Instrumentation.h"
+#include <pthread.h>
+#include <string.h>
+
+/***************************************************************************************************
+ * THREADS
+ **************************************************************************************************/
+
+#if RS_INSTRUMENTATION
+
+_Thread_local CodecStats threadStats;
+_Thread_local int threadStatsRegistered = 0;
+
+// Counts of the threads that have finished.
+static CodecStats finishedStats;
+static pthread_mutex_t finishedMutex = PTHREAD_MUTEX_INITIALIZER;
+
+// Its destructor runs when a thread that counted something finishes.
+static pthread_key_t threadKey;
+static pthread_once_t threadKeyOnce = PTHREAD_ONCE_INIT;
+
+static void addStats(CodecStats* total, const CodecStats* stats){
+    total->interpolations  += stats->interpolations;
+    total->evaluations     += stats->evaluations;
+    total->combinations    += stats->combinations;
+    total->hammingHits     += stats->hammingHits;
+    total->hammingMisses   += stats->hammingMisses;
+    total->budgetExhausted += stats->budgetExhausted;
+    total->crcRejections   += stats->crcRejections;
+    total->retries         += stats->retries;
+    if(stats->maxRetryDepth > total->maxRetryDepth) total->maxRetryDepth = stats->maxRetryDepth;
+    for(int i = 0; i < NUM_SPANS; i++){
+        total->spanCycles[i] += stats->spanCycles[i];
+        total->spanCount[i]  += stats->spanCount[i];
+    }
+}
+
+static void threadFinished(void* stats){
+    pthread_mutex_lock(&finishedMutex);
+    addStats(&finishedStats, stats);
+    pthread_mutex_unlock(&finishedMutex);
+}
+
+static void createThreadKey(){
+    pthread_key_create(&threadKey, threadFinished);
+}
+
+void registerThreadStats(){
+    pthread_once(&threadKeyOnce, createThreadKey);
+    pthread_setspecific(threadKey, &threadStats);
+    threadStatsRegistered = 1;
+}
+
+#endif
+
+/***************************************************************************************************
+ * FUNCTIONS
+ **************************************************************************************************/
+
+int codecStatsEnabled(){
+    return RS_INSTRUMENTATION;
+}
+
+void getCodecStats(CodecStats* stats){
+    memset(stats, 0, sizeof(CodecStats));
+#if RS_INSTRUMENTATION
+    pthread_mutex_lock(&finishedMutex);
+    addStats(stats, &finishedStats);
+    pthread_mutex_unlock(&finishedMutex);
+    addStats(stats, &threadStats);
+#endif
+}
+
+void resetCodecStats(){
+#if RS_INSTRUMENTATION
+    pthread_mutex_lock(&finishedMutex);
+    memset(&finishedStats, 0, sizeof(CodecStats));
+    pthread_mutex_unlock(&finishedMutex);
+    memset(&threadStats, 0, sizeof(CodecStats));
+#endif
+}
+
+void printCodecStats(FILE* out){
+    if(!codecStatsEnabled()){
+        fprintf(out, "Codec statistics not available: build with make INSTRUMENT=1.\n");
+        return;
+    }
+
+    CodecStats stats;
+    getCodecStats(&stats);
+    fprintf(out, "Codec statistics:\n"
+                 "  Interpolations:         %ld\n"
+                 "  Polynomial evaluations: %ld\n"
+                 "  Combinations checked:   %ld\n"
+                 "  Hamming hits/misses:    %ld/%ld\n"
+                 "  Budget exhausted:       %ld\n"
+                 "  CRC rejections:         %ld\n"
+                 "  Retries:                %ld (max depth %ld)\n",
+            stats.interpolations, stats.evaluations, stats.combinations, stats.hammingHits,
+            stats.hammingMisses, stats.budgetExhausted, stats.crcRejections, stats.retries, 
+            stats.maxRetryDepth);
+
+    if(!RS_INSTRUMENTATION_SPANS) return;
+    const char* spanNames[NUM_SPANS] = {"Encode", "Decode", "Interpolation"};
+    for(int i = 0; i < NUM_SPANS; i++){
+        if(stats.spanCount[i] == 0) continue;
+        fprintf(out, "  %-23s %ld spans, %llu cycles on average\n", spanNames[i], stats.spanCount[i],
+                stats.spanCycles[i]/stats.spanCount[i]);
+    }
+}
@@ -0,0 +1,157 @@
+/***************************************************************************************************
+ * @file Instrumentation.h
+ * @brief Counters and timing spans of the codec.
+ *
+ * Every thread counts on its own copy of CodecStats, so the hot paths don't share any cache line.
+ * When a thread finishes, its counts are added to the totals. The STATS_* macros expand to nothing
+ * unless RS_INSTRUMENTATION is set, and the spans also need RS_INSTRUMENTATION_SPANS (see
+ * CommonDefines.h).
+ *
+ * @version   1.0
+ * @date      2024-07-23
+ * @author    @dabecart
+ *
+ * @license
+ * This project is licensed under the MIT License - see the LICENSE file for details.
+ **************************************************************************************************/
+
+#ifndef INSTRUMENTATION_h
+#define INSTRUMENTATION_h
+
+#include <stdio.h>
+#include "CommonDefines.h"
+
+#if RS_INSTRUMENTATION_SPANS && !RS_INSTRUMENTATION
+#error "RS_INSTRUMENTATION_SPANS needs RS_INSTRUMENTATION"
+#endif
+
+/***************************************************************************************************
+ * TYPES
+ **************************************************************************************************/
+
+// Timed sections of the codec.
+typedef enum{
+    SPAN_ENCODE,
+    SPAN_DECODE,
+    SPAN_INTERPOLATION,
+    NUM_SPANS,
+} StatsSpan;
+
+typedef struct{
+    // Lagrange interpolations and evaluations of their polynomials.
+    long interpolations;
+    long evaluations;
+
+    // Subsets of points checked by checkPoints().
+    long combinations;
+
+    // Blocks fixed by the pass that skips the point pointed by the Hamming, and blocks that pass 
+    // couldn't fix, so they needed the second one.
+    long hammingHits;
+    long hammingMisses;
+
+    // Searches stopped because the block ran out of its budget of combinations (see -b).
+    long budgetExhausted;
+
+    // Fixes that the Hamming and CRC of the recuperation data rejected.
+    long crcRejections;
+
+    // Retries with 256 added to an extra point, and the deepest nesting of them. [retryDepth] is 
+    // the current nesting.
+    long retries;
+    long maxRetryDepth;
+    long retryDepth;
+
+    // Cycles (or nanoseconds if there's no cycle counter) spent on each span and how many times it
+    // was entered.
+    unsigned long long spanCycles[NUM_SPANS];
+    long spanCount[NUM_SPANS];
+} CodecStats;
+
+/***************************************************************************************************
+ * FUNCTIONS
+ **************************************************************************************************/
+
+// 1 if the instrumentation was compiled in.
+int codecStatsEnabled();
+
+// Adds up the counts of the threads that have finished and the ones of the calling thread. The
+// threads still running are not included.
+void getCodecStats(CodecStats* stats);
+
+// Clears the totals and the counts of the calling thread.
+void resetCodecStats();
+
+// Prints the result of getCodecStats() on [out].
+void printCodecStats(FILE* out);
+
+/***************************************************************************************************
+ * MACROS
+ **************************************************************************************************/
+
+#if RS_INSTRUMENTATION
+
+extern _Thread_local CodecStats threadStats;
+extern _Thread_local int threadStatsRegistered;
+
+// Makes the counts of the calling thread go to the totals when it finishes.
+void registerThreadStats();
+
+static inline CodecStats* statsOfThread(){
+    if(!threadStatsRegistered) registerThreadStats();
+    return &threadStats;
+}
+
+#define STATS_ADD(field, n)     (statsOfThread()->field += (n))
+#define STATS_INC(field)        STATS_ADD(field, 1)
+
+// Nesting of the retries.
+#define STATS_RETRY_ENTER()     do{ \
+                                    CodecStats* stats = statsOfThread(); \
+                                    stats->retries++; \
+                                    if(++stats->retryDepth > stats->maxRetryDepth) \
+                                        stats->maxRetryDepth = stats->retryDepth; \
+                                }while(0)
+#define STATS_RETRY_LEAVE()     (statsOfThread()->retryDepth--)
+
+#else
+
+#define STATS_ADD(field, n)     ((void) 0)
+#define STATS_INC(field)        ((void) 0)
+#define STATS_RETRY_ENTER()     ((void) 0)
+#define STATS_RETRY_LEAVE()     ((void) 0)
+
+#endif
+
+// Cycle counter of the CPU or, if there's none, a clock in nanoseconds.
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+static inline unsigned long long readCycles(){
+    return __rdtsc();
+}
+#else
+#include <time.h>
+static inline unsigned long long readCycles(){
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return now.tv_sec*1000000000ULL + now.tv_nsec;
+}
+#endif
+
+#if RS_INSTRUMENTATION_SPANS
+
+#define STATS_SPAN_BEGIN(name)      unsigned long long name##SpanStart = readCycles()
+#define STATS_SPAN_END(span, name)  do{ \
+                                        CodecStats* stats = statsOfThread(); \
+                                        stats->spanCycles[span] += readCycles() - name##SpanStart; \
+                                        stats->spanCount[span]++; \
+                                    }while(0)
+
+#else
+
+#define STATS_SPAN_BEGIN(name)      ((void) 0)
+#define STATS_SPAN_END(span, name)  ((void) 0)
+
+#endif
+
+#endif
@@ -0,0 +1,47 @@
+/***************************************************************************************************
+ * @file Interleave.c
+ * @brief Spreads the points of the blocks across the data file.
+ *
+ * @version   1.0
+ * @date      2024-07-23
+ * @author    @dabecart
+ *
+ * @license
+ * This project is licensed under the MIT License - see the LICENSE file for details.
+ **************************************************************************************************/
+
+#include "Interleave.h"
+
+// A group is a matrix of NUM_POINTS_SAMPLE rows and [depth] columns on the file, and every block 
+// is one of its columns. The transpose goes through tiles of columns, so both the rows read and 
+// the blocks written stay on the cache.
+static void transposeGroup(const unsigned char* in, unsigned char* out, long depth, int toBlocks){
+    for(long tile = 0; tile < depth; tile += INTERLEAVE_TILE_BLOCKS){
+        long tileEnd = tile + INTERLEAVE_TILE_BLOCKS;
+        if(tileEnd > depth) tileEnd = depth;
+
+        for(long j = 0; j < NUM_POINTS_SAMPLE; j++){
+            if(toBlocks){
+                for(long i = tile; i < tileEnd; i++) out[i*NUM_POINTS_SAMPLE + j] = in[j*depth + i];
+            }else{
+                for(long i = tile; i < tileEnd; i++) out[j*depth + i] = in[i*NUM_POINTS_SAMPLE + j];
+            }
+        }
+    }
+}
+
+void interleaveBlocks(const unsigned char* data, unsigned char* blocks, long numBlocks, long depth){
+    for(long group = 0; group < numBlocks; group += depth){
+        long groupDepth = numBlocks - group < depth ? numBlocks - group : depth;
+        transposeGroup(data + group*NUM_POINTS_SAMPLE, blocks + group*NUM_POINTS_SAMPLE, 
+                       groupDepth, 1);
+    }
+}
+
+void deinterleaveBlocks(const unsigned char* blocks, unsigned char* data, long numBlocks, long depth){
+    for(long group = 0; group < numBlocks; group += depth){
+        long groupDepth = numBlocks - group < depth ? numBlocks - group : depth;
+        transposeGroup(blocks + group*NUM_POINTS_SAMPLE, data + group*NUM_POINTS_SAMPLE, 
+                       groupDepth, 0);
+    }
+}
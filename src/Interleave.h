@@ -0,0 +1,49 @@
+/***************************************************************************************************
+ * @file Interleave.h
+ * @brief Spreads the points of the blocks across the data file.
+ *
+ * With an interleave depth of D, the file is split in groups of D blocks (D*NUM_POINTS_SAMPLE 
+ * bytes) and the point j of the block i of a group is the byte j*D + i of the group. A burst of up 
+ * to D consecutive wrong bytes then only changes one point of each block, which is the cheapest 
+ * error to fix. The last group of the file is shorter if the number of blocks is not a multiple of D.
+ *
+ * The depth is stored on the trailer of the recuperation file, so the decoder knows the layout.
+ *
+ * @version   1.0
+ * @date      2024-07-23
+ * @author    @dabecart
+ *
+ * @license
+ * This project is licensed under the MIT License - see the LICENSE file for details.
+ **************************************************************************************************/
+
+#ifndef INTERLEAVE_h
+#define INTERLEAVE_h
+
+#include "CommonDefines.h"
+
+/***************************************************************************************************
+ * DEFINES
+ **************************************************************************************************/
+
+// Tag of the trailer section that holds the depth.
+#define INTERLEAVE_SECTION_TAG  "ILVD"
+
+// Maximum interleave depth. A group always fits on one chunk of the file tools.
+#define INTERLEAVE_MAX_DEPTH    4096
+
+// Number of blocks transposed at once. The points they are written to stay on the L1 cache.
+#define INTERLEAVE_TILE_BLOCKS  64
+
+/***************************************************************************************************
+ * FUNCTIONS
+ **************************************************************************************************/
+
+// Reorders the [numBlocks] blocks of [data], as they are on the file, into [blocks], one block after 
+// the other. [data] starts on a group and only its last group can be shorter than [depth].
+void interleaveBlocks(const unsigned char* data, unsigned char* blocks, long numBlocks, long depth);
+
+// Inverse of interleaveBlocks(): writes the [numBlocks] blocks of [blocks] as they go on the file.
+void deinterleaveBlocks(const unsigned char* blocks, unsigned char* data, long numBlocks, long depth);
+
+#endif //INTERLEAVE_h
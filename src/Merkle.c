@@ -0,0 +1,221 @@
+/***************************************************************************************************
+ * @file Merkle.c
+ * @brief Hash tree over the regions of a data file.
+ *
+ * @version   1.0
+ * @date      2024-07-23
+ * @author    @dabecart
+ *
+ * @license
+ * This project is licensed under the MIT License - see the LICENSE file for details.
+ **************************************************************************************************/
+
+#include "Merkle.h"
+#include "Throttle.h"
+
+// regionBlocks, dataLength and numLeaves.
+#define MERKLE_HEADER_SIZE 20
+
+MerkleHash hashBytes(MerkleHash hash, const unsigned char* data, size_t length){
+    for(size_t i = 0; i < length; i++){
+        hash ^= data[i];
+        hash *= 0x100000001B3ULL;
+    }
+    return hash;
+}
+
+static long levelSize(long size){
+    return (size + 1) / 2;
+}
+
+int initMerkleTree(MerkleTree* tree, long dataLength, long regionBlocks){
+    tree->regionBlocks = regionBlocks;
+    tree->dataLength = dataLength;
+
+    long regionBytes = regionBlocks * NUM_POINTS_SAMPLE;
+    tree->numLeaves = (dataLength + regionBytes - 1) / regionBytes;
+    if(tree->numLeaves == 0) tree->numLeaves = 1;
+
+    tree->numNodes = 0;
+    for(long size = tree->numLeaves; ; size = levelSize(size)){
+        tree->numNodes += size;
+        if(size == 1) break;
+    }
+
+    tree->nodes = calloc(tree->numNodes, sizeof(MerkleHash));
+    return tree->nodes == NULL ? -1 : 0;
+}
+
+void freeMerkleTree(MerkleTree* tree){
+    free(tree->nodes);
+    tree->nodes = NULL;
+}
+
+long merkleRegionBytes(const MerkleTree* tree){
+    return tree->regionBlocks * NUM_POINTS_SAMPLE;
+}
+
+static MerkleHash hashChildren(const MerkleHash* children, int count){
+    unsigned char bytes[16];
+    for(int i = 0; i < count; i++) putU64(bytes + 8*i, children[i]);
+    return hashBytes(MERKLE_HASH_SEED, bytes, 8*count);
+}
+
+// Computes the parents of a whole tree into [nodes]. 
+static void computeParents(const MerkleTree* tree, MerkleHash* nodes){
+    long level = 0;
+    for(long size = tree->numLeaves; size > 1; size = levelSize(size)){
+        MerkleHash* parents = nodes + level + size;
+        for(long i = 0; i < size; i += 2){
+            parents[i/2] = hashChildren(nodes + level + i, (i+1 < size) ? 2 : 1);
+        }
+        level += size;
+    }
+}
+
+void buildMerkleTree(MerkleTree* tree){
+    computeParents(tree, tree->nodes);
+}
+
+int hashMerkleFile(MerkleTree* tree, FILE* file){
+    long regionBytes = merkleRegionBytes(tree);
+    unsigned char* buffer = malloc(regionBytes);
+    if(buffer == NULL) return -1;
+
+    long remaining = tree->dataLength;
+    for(long leaf = 0; leaf < tree->numLeaves; leaf++){
+        long length = remaining < regionBytes ? remaining : regionBytes;
+        throttleRead(length);
+        if((long) fread(buffer, 1, length, file) != length){
+            free(buffer);
+            return -1;
+        }
+        tree->nodes[leaf] = hashBytes(MERKLE_HASH_SEED, buffer, length);
+        remaining -= length;
+    }
+
+    free(buffer);
+    buildMerkleTree(tree);
+    return 0;
+}
+
+int hashMerkleRegion(const MerkleTree* tree, FILE* file, long leaf, MerkleHash* hash){
+    long regionBytes = merkleRegionBytes(tree);
+    long length = tree->dataLength - leaf*regionBytes;
+    if(length > regionBytes) length = regionBytes;
+    if(length < 0) length = 0;
+
+    unsigned char* buffer = malloc(regionBytes);
+    if(buffer == NULL) return -1;
+    fseek(file, leaf*regionBytes, SEEK_SET);
+    int ret = (long) fread(buffer, 1, length, file) == length ? 0 : -1;
+    *hash = hashBytes(MERKLE_HASH_SEED, buffer, length);
+    free(buffer);
+    return ret;
+}
+
+void updateMerkleLeaf(MerkleTree* tree, long leaf, MerkleHash hash){
+    tree->nodes[leaf] = hash;
+
+    long level = 0;
+    long index = leaf;
+    for(long size = tree->numLeaves; size > 1; size = levelSize(size)){
+        long first = index & ~1L;
+        tree->nodes[level + size + index/2] = 
+            hashChildren(tree->nodes + level + first, (first + 1 < size) ? 2 : 1);
+        level += size;
+        index /= 2;
+    }
+}
+
+int isMerkleTreeConsistent(const MerkleTree* tree){
+    MerkleHash* nodes = malloc(tree->numNodes * sizeof(MerkleHash));
+    if(nodes == NULL) return 0;
+
+    memcpy(nodes, tree->nodes, tree->numLeaves * sizeof(MerkleHash));
+    computeParents(tree, nodes);
+    int consistent = memcmp(nodes, tree->nodes, tree->numNodes * sizeof(MerkleHash)) == 0;
+
+    free(nodes);
+    return consistent;
+}
+
+long diffMerkleTrees(const MerkleTree* stored, const MerkleTree* computed, unsigned char* damaged){
+    memset(damaged, 0, stored->numLeaves);
+    if(stored->numLeaves != computed->numLeaves){
+        memset(damaged, 1, stored->numLeaves);
+        return stored->numLeaves;
+    }
+
+    // Offset and size of every level. A tree of 2^62 leaves would still fit.
+    long offsets[64], sizes[64];
+    int levels = 0;
+    long offset = 0;
+    for(long size = stored->numLeaves; ; size = levelSize(size)){
+        offsets[levels] = offset;
+        sizes[levels++] = size;
+        offset += size;
+        if(size == 1) break;
+    }
+
+    // Walk the tree from the root, keeping the nodes that differ on a stack. Every level can push
+    // at most two nodes per node popped, so 2*levels entries are enough.
+    struct { int level; long index; } stack[128];
+    int top = 0;
+    stack[top].level = levels - 1;
+    stack[top++].index = 0;
+
+    long count = 0;
+    while(top > 0){
+        int level = stack[--top].level;
+        long index = stack[top].index;
+        long node = offsets[level] + index;
+        if(stored->nodes[node] == computed->nodes[node]) continue;
+
+        if(level == 0){
+            damaged[index] = 1;
+            count++;
+            continue;
+        }
+
+        for(long child = 2*index; child < 2*index + 2 && child < sizes[level-1]; child++){
+            stack[top].level = level - 1;
+            stack[top++].index = child;
+        }
+    }
+    return count;
+}
+
+int serializeMerkleTree(const MerkleTree* tree, TrailerSection* section){
+    memcpy(section->tag, MERKLE_SECTION_TAG, 4);
+    section->length = MERKLE_HEADER_SIZE + tree->numNodes * 8;
+    section->payload = malloc(section->length);
+    if(section->payload == NULL) return -1;
+
+    putU32(section->payload, tree->regionBlocks);
+    putU64(section->payload + 4, tree->dataLength);
+    putU64(section->payload + 12, tree->numLeaves);
+    for(long i = 0; i < tree->numNodes; i++){
+        putU64(section->payload + MERKLE_HEADER_SIZE + 8*i, tree->nodes[i]);
+    }
+    return 0;
+}
+
+int deserializeMerkleTree(const TrailerSection* section, MerkleTree* tree){
+    if(section->length < MERKLE_HEADER_SIZE) return -1;
+
+    long regionBlocks = getU32(section->payload);
+    long dataLength = getU64(section->payload + 4);
+    long numLeaves = getU64(section->payload + 12);
+    if(regionBlocks <= 0 || dataLength < 0) return -1;
+    if(initMerkleTree(tree, dataLength, regionBlocks) < 0) return -1;
+
+    if(tree->numLeaves != numLeaves || section->length != MERKLE_HEADER_SIZE + tree->numNodes*8){
+        freeMerkleTree(tree);
+        return -1;
+    }
+    for(long i = 0; i < tree->numNodes; i++){
+        tree->nodes[i] = getU64(section->payload + MERKLE_HEADER_SIZE + 8*i);
+    }
+    return 0;
+}
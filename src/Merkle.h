@@ -0,0 +1,99 @@
+/***************************************************************************************************
+ * @file Merkle.h
+ * @brief Hash tree over the regions of a data file.
+ *
+ * The data file is split into regions of a fixed number of blocks. The leaves of the tree are the 
+ * hashes of the regions and every node is the hash of its two children (or of its only child), up
+ * to the root. Comparing the stored tree with the one computed from the data only descends into the
+ * subtrees whose hashes differ, so the damaged regions are found without running the Reed-Solomon 
+ * verification on the rest of the file. 
+ *
+ * The nodes are stored level by level, from the leaves to the root. The hash is a 64 bit FNV-1a: 
+ * the tree is meant to find accidental corruption, not to detect tampering.
+ *
+ * @version   1.0
+ * @date      2024-07-23
+ * @author    @dabecart
+ *
+ * @license
+ * This project is licensed under the MIT License - see the LICENSE file for details.
+ **************************************************************************************************/
+
+#ifndef MERKLE_h
+#define MERKLE_h
+
+#include "CommonDefines.h"
+#include "RecTrailer.h"
+
+/***************************************************************************************************
+ * DEFINES
+ **************************************************************************************************/
+
+// Tag of the trailer section that holds the tree.
+#define MERKLE_SECTION_TAG      "MRKL"
+
+// Default number of blocks of every region.
+#define MERKLE_DEFAULT_REGION_BLOCKS 1024
+
+#define MERKLE_HASH_SEED        0xCBF29CE484222325ULL
+
+/***************************************************************************************************
+ * TYPES
+ **************************************************************************************************/
+
+typedef unsigned long long MerkleHash;
+
+typedef struct{
+    long regionBlocks;
+    long dataLength;
+    long numLeaves;
+    long numNodes;
+    // Hashes of the nodes, level by level from the leaves (the first numLeaves) to the root (the 
+    // last one).
+    MerkleHash* nodes;
+} MerkleTree;
+
+/***************************************************************************************************
+ * FUNCTIONS
+ **************************************************************************************************/
+
+// Continues the hash [hash] with [length] bytes of [data]. Start with MERKLE_HASH_SEED.
+MerkleHash hashBytes(MerkleHash hash, const unsigned char* data, size_t length);
+
+// Allocates the tree of a file of [dataLength] bytes split in regions of [regionBlocks] blocks. 
+// Returns -1 if it couldn't be allocated.
+int initMerkleTree(MerkleTree* tree, long dataLength, long regionBlocks);
+
+void freeMerkleTree(MerkleTree* tree);
+
+// Bytes of every region.
+long merkleRegionBytes(const MerkleTree* tree);
+
+// Computes the nodes above the leaves, once all of them have been set.
+void buildMerkleTree(MerkleTree* tree);
+
+// Computes the leaves and the rest of the nodes of [tree] by reading [file] from its current 
+// position. Returns -1 if the file is shorter than the tree.
+int hashMerkleFile(MerkleTree* tree, FILE* file);
+
+// Hashes the region [leaf] of [file], which is read from its start, into [hash]. Returns -1 if the
+// file is shorter than the tree.
+int hashMerkleRegion(const MerkleTree* tree, FILE* file, long leaf, MerkleHash* hash);
+
+// Changes the hash of the region [leaf] and updates the nodes above it.
+void updateMerkleLeaf(MerkleTree* tree, long leaf, MerkleHash hash);
+
+// Checks that the nodes of [tree] match its leaves, so a damaged index is not trusted.
+int isMerkleTreeConsistent(const MerkleTree* tree);
+
+// Marks on [damaged] (one byte per leaf) the regions whose hashes differ between [stored] and 
+// [computed], descending only into the subtrees that differ. Returns the number of damaged regions.
+long diffMerkleTrees(const MerkleTree* stored, const MerkleTree* computed, unsigned char* damaged);
+
+// Builds the trailer section of [tree]. [section->payload] has to be freed.
+int serializeMerkleTree(const MerkleTree* tree, TrailerSection* section);
+
+// Reads [tree] from its trailer section. Returns -1 if the section is malformed.
+int deserializeMerkleTree(const TrailerSection* section, MerkleTree* tree);
+
+#endif //MERKLE_h
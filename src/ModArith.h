@@ -0,0 +1,66 @@
+/***************************************************************************************************
+ * @file ModArith.h
+ * @brief Modular reduction without divisions, for sums of products reduced only once.
+ *
+ * The values of the algorithm are below MODULUS, so a product of two of them is below 2^17 and a
+ * ModAcc (32 bits) can add up 2^15 of those products before it has to be reduced. A dot product
+ * or a Horner step is then a chain of multiply-adds with a single reduceMod() at the end.
+ *
+ * For MODULUS 257, 256 = -1 and 65536 = 1 (mod 257), so the reduction only needs shifts, masks
+ * and a branch-free correction. Any other prime uses Barrett's reduction.
+ *
+ * @version   1.0
+ * @date      2024-07-23
+ * @author    @dabecart
+ *
+ * @license
+ * This project is licensed under the MIT License - see the LICENSE file for details.
+ **************************************************************************************************/
+
+#ifndef MOD_ARITH_h
+#define MOD_ARITH_h
+
+#include "CommonDefines.h"
+
+/***************************************************************************************************
+ * TYPES
+ **************************************************************************************************/
+
+// Unreduced sum of products of reduced values.
+typedef unsigned int ModAcc;
+
+// Products that a ModAcc can hold before reducing it.
+#define MOD_ACC_MAX_TERMS   (1 << 15)
+
+/***************************************************************************************************
+ * FUNCTIONS
+ **************************************************************************************************/
+
+#if MODULUS == 257
+
+// Reduces any 32 bit [x] to [0, 257).
+static inline unsigned int reduceMod(ModAcc x){
+    // 65536 = 1, so the two halves are added. After two folds, x <= 0x10000.
+    x = (x & 0xFFFF) + (x >> 16);
+    x = (x & 0xFFFF) + (x >> 16);
+
+    // 256 = -1, so x = (x & 0xFF) - (x >> 8), which is in [-256, 255].
+    int r = (int) (x & 0xFF) - (int) (x >> 8);
+    return r + (257 & (r >> 31));
+}
+
+#else
+
+// floor(2^32/MODULUS).
+#define MOD_BARRETT_FACTOR  ((unsigned long long) (0x100000000ULL/MODULUS))
+
+// Reduces any 32 bit [x] to [0, MODULUS). The estimated quotient is at most one short.
+static inline unsigned int reduceMod(ModAcc x){
+    unsigned int q = (x*MOD_BARRETT_FACTOR) >> 32;
+    unsigned int r = x - q*MODULUS;
+    return r - (MODULUS & -(r >= MODULUS));
+}
+
+#endif
+
+#endif
@@ -0,0 +1,66 @@
+/***************************************************************************************************
+ * @file ParityCache.c
+ * @brief Cache of the recuperation data of the last blocks encoded.
+ *
+ * @version   1.0
+ * @date      2024-07-23
+ * @author    @dabecart
+ *
+ * @license
+ * This project is licensed under the MIT License - see the LICENSE file for details.
+ **************************************************************************************************/
+
+#include "ParityCache.h"
+
+// FNV-1a hash of the block.
+static inline size_t hashBlock(const unsigned char* data){
+    unsigned long long hash = 14695981039346656037ULL;
+    for(int i = 0; i < NUM_POINTS_SAMPLE; i++){
+        hash ^= data[i];
+        hash *= 1099511628211ULL;
+    }
+    return hash ^ (hash >> 32);
+}
+
+int initParityCache(ParityCache* cache, size_t entries){
+    size_t size = 1;
+    while(size < entries) size <<= 1;
+
+    cache->entries = calloc(size, sizeof(ParityCacheEntry));
+    cache->mask = size - 1;
+    cache->hits = 0;
+    cache->misses = 0;
+    return cache->entries == NULL ? -1 : 0;
+}
+
+void freeParityCache(ParityCache* cache){
+    free(cache->entries);
+    cache->entries = NULL;
+}
+
+void encodeBlockCached(ParityCache* cache, const unsigned char* data, unsigned char* rec){
+    size_t home = hashBlock(data);
+    ParityCacheEntry* slot = NULL;
+
+    for(size_t i = 0; i < PARITY_CACHE_PROBES; i++){
+        ParityCacheEntry* entry = &cache->entries[(home + i) & cache->mask];
+        if(!entry->used){
+            if(slot == NULL) slot = entry;
+            continue;
+        }
+        if(memcmp(entry->data, data, NUM_POINTS_SAMPLE) == 0){
+            memcpy(rec, entry->rec, REC_BYTES_PER_BLOCK);
+            cache->hits++;
+            return;
+        }
+    }
+
+    encodeBlock(data, rec);
+    cache->misses++;
+
+    // If there's no room left around its position, the block replaces the first one.
+    if(slot == NULL) slot = &cache->entries[home & cache->mask];
+    memcpy(slot->data, data, NUM_POINTS_SAMPLE);
+    memcpy(slot->rec, rec, REC_BYTES_PER_BLOCK);
+    slot->used = 1;
+}
@@ -0,0 +1,63 @@
+/***************************************************************************************************
+ * @file ParityCache.h
+ * @brief Cache of the recuperation data of the last blocks encoded.
+ *
+ * Images usually repeat many blocks (lookup tables, copies of the same resources...). This cache 
+ * keeps the recuperation data of the blocks already encoded on a fixed-size open addressing table 
+ * keyed by the bytes of the block, so repeated blocks skip the interpolation. A cache is not thread
+ * safe: every thread has to use its own one.
+ *
+ * @version   1.0
+ * @date      2024-07-23
+ * @author    @dabecart
+ *
+ * @license
+ * This project is licensed under the MIT License - see the LICENSE file for details.
+ **************************************************************************************************/
+
+#ifndef PARITY_CACHE_h
+#define PARITY_CACHE_h
+
+#include "CommonDefines.h"
+#include "ReedSolomon.h"
+
+/***************************************************************************************************
+ * DEFINES
+ **************************************************************************************************/
+
+// Number of consecutive entries checked for a block before replacing one.
+#define PARITY_CACHE_PROBES     4
+
+/***************************************************************************************************
+ * TYPES
+ **************************************************************************************************/
+
+typedef struct{
+    unsigned char data[NUM_POINTS_SAMPLE];
+    unsigned char rec[REC_BYTES_PER_BLOCK];
+    unsigned char used;
+} ParityCacheEntry;
+
+typedef struct{
+    ParityCacheEntry* entries;
+    // Number of entries - 1. The number of entries is a power of two.
+    size_t mask;
+
+    // Statistics.
+    long hits;
+    long misses;
+} ParityCache;
+
+/***************************************************************************************************
+ * FUNCTIONS
+ **************************************************************************************************/
+
+// Allocates a cache with at least [entries] entries. Returns -1 if it couldn't be allocated.
+int initParityCache(ParityCache* cache, size_t entries);
+
+void freeParityCache(ParityCache* cache);
+
+// Same as encodeBlock(), but looks for [data] on the cache first.
+void encodeBlockCached(ParityCache* cache, const unsigned char* data, unsigned char* rec);
+
+#endif //PARITY_CACHE_h
@@ -0,0 +1,195 @@
+/***************************************************************************************************
+ * @file Pipeline.c
+ * @brief Runs the read, process and write stages of the file tools on different threads.
+ *
+ * @version   1.0
+ * @date      2024-07-23
+ * @author    @dabecart
+ *
+ * @license
+ * This project is licensed under the MIT License - see the LICENSE file for details.
+ **************************************************************************************************/
+
+#include "Pipeline.h"
+#include <pthread.h>
+#include <unistd.h>
+
+/***************************************************************************************************
+ * STATE
+ **************************************************************************************************/
+
+typedef enum{
+    CHUNK_FREE,
+    CHUNK_READ,
+    CHUNK_PROCESSING,
+    CHUNK_PROCESSED,
+} ChunkState;
+
+typedef struct{
+    Pipeline* pipeline;
+
+    pthread_mutex_t lock;
+    pthread_cond_t changed;
+    ChunkState states[PIPELINE_MAX_CHUNKS];
+
+    // Sequence numbers of the next chunk to read, to process and to write. The chunk of the 
+    // sequence number n is at position n % numChunks of the ring.
+    long readSeq;
+    long processSeq;
+    long writeSeq;
+
+    // Sequence number where the input ended, or -1 if it hasn't yet.
+    long endSeq;
+    int abort;
+} PipelineState;
+
+static inline void* getChunk(PipelineState* state, long seq){
+    return (char*) state->pipeline->chunks + (seq % state->pipeline->numChunks)*state->pipeline->chunkSize;
+}
+
+static inline ChunkState* getState(PipelineState* state, long seq){
+    return &state->states[seq % state->pipeline->numChunks];
+}
+
+/***************************************************************************************************
+ * STAGES
+ **************************************************************************************************/
+
+static void* readerThread(void* arg){
+    PipelineState* state = arg;
+    Pipeline* pipeline = state->pipeline;
+
+    for(long seq = 0; ; seq++){
+        pthread_mutex_lock(&state->lock);
+        while(*getState(state, seq) != CHUNK_FREE && !state->abort){
+            pthread_cond_wait(&state->changed, &state->lock);
+        }
+        int abort = state->abort;
+        pthread_mutex_unlock(&state->lock);
+
+        int more = !abort && pipeline->read(getChunk(state, seq), pipeline->context);
+
+        pthread_mutex_lock(&state->lock);
+        if(more){
+            *getState(state, seq) = CHUNK_READ;
+            state->readSeq = seq + 1;
+        }else{
+            state->endSeq = seq;
+        }
+        pthread_cond_broadcast(&state->changed);
+        pthread_mutex_unlock(&state->lock);
+
+        if(!more) return NULL;
+    }
+}
+
+typedef struct{
+    PipelineState* state;
+    int worker;
+} WorkerArgs;
+
+static void* workerThread(void* arg){
+    PipelineState* state = ((WorkerArgs*) arg)->state;
+    int worker = ((WorkerArgs*) arg)->worker;
+    Pipeline* pipeline = state->pipeline;
+
+    while(1){
+        pthread_mutex_lock(&state->lock);
+        while(state->processSeq >= state->readSeq && state->endSeq < 0 && !state->abort){
+            pthread_cond_wait(&state->changed, &state->lock);
+        }
+        if(state->processSeq >= state->readSeq || state->abort){
+            // Everything that was read has been taken by a worker.
+            pthread_mutex_unlock(&state->lock);
+            return NULL;
+        }
+        long seq = state->processSeq++;
+        *getState(state, seq) = CHUNK_PROCESSING;
+        pthread_mutex_unlock(&state->lock);
+
+        pipeline->process(getChunk(state, seq), pipeline->context, worker);
+
+        pthread_mutex_lock(&state->lock);
+        *getState(state, seq) = CHUNK_PROCESSED;
+        pthread_cond_broadcast(&state->changed);
+        pthread_mutex_unlock(&state->lock);
+    }
+}
+
+/***************************************************************************************************
+ * FUNCTIONS
+ **************************************************************************************************/
+
+int defaultPipelineWorkers(){
+    long processors = sysconf(_SC_NPROCESSORS_ONLN);
+    if(processors < 1) processors = 1;
+    if(processors > PIPELINE_MAX_WORKERS) processors = PIPELINE_MAX_WORKERS;
+    return processors;
+}
+
+int runPipeline(Pipeline* pipeline){
+    if(pipeline->workers <= 0) pipeline->workers = defaultPipelineWorkers();
+    if(pipeline->workers > PIPELINE_MAX_WORKERS) pipeline->workers = PIPELINE_MAX_WORKERS;
+    if(pipeline->numChunks > PIPELINE_MAX_CHUNKS) pipeline->numChunks = PIPELINE_MAX_CHUNKS;
+
+    PipelineState state = {
+        .pipeline = pipeline,
+        .endSeq = -1,
+    };
+    pthread_mutex_init(&state.lock, NULL);
+    pthread_cond_init(&state.changed, NULL);
+
+    pthread_t reader;
+    pthread_t workers[PIPELINE_MAX_WORKERS];
+    WorkerArgs workerArgs[PIPELINE_MAX_WORKERS];
+    int numWorkers = 0;
+    int ret = 0;
+
+    if(pthread_create(&reader, NULL, readerThread, &state) != 0){
+        ret = -1;
+        goto cleanup;
+    }
+    for(; numWorkers < pipeline->workers; numWorkers++){
+        workerArgs[numWorkers] = (WorkerArgs){ .state = &state, .worker = numWorkers };
+        if(pthread_create(&workers[numWorkers], NULL, workerThread, &workerArgs[numWorkers]) != 0){
+            break;
+        }
+    }
+    if(numWorkers == 0){
+        pthread_mutex_lock(&state.lock);
+        state.abort = 1;
+        pthread_cond_broadcast(&state.changed);
+        pthread_mutex_unlock(&state.lock);
+        ret = -1;
+    }
+
+    // The calling thread is the writer.
+    while(ret == 0){
+        long seq = state.writeSeq;
+
+        pthread_mutex_lock(&state.lock);
+        while(*getState(&state, seq) != CHUNK_PROCESSED && !(state.endSeq >= 0 && seq >= state.endSeq)){
+            pthread_cond_wait(&state.changed, &state.lock);
+        }
+        int ended = *getState(&state, seq) != CHUNK_PROCESSED;
+        pthread_mutex_unlock(&state.lock);
+        if(ended) break;
+
+        ret = pipeline->write(getChunk(&state, seq), pipeline->context) < 0 ? -1 : 0;
+
+        pthread_mutex_lock(&state.lock);
+        *getState(&state, seq) = CHUNK_FREE;
+        state.writeSeq = seq + 1;
+        if(ret < 0) state.abort = 1;
+        pthread_cond_broadcast(&state.changed);
+        pthread_mutex_unlock(&state.lock);
+    }
+
+    pthread_join(reader, NULL);
+    for(int i = 0; i < numWorkers; i++) pthread_join(workers[i], NULL);
+
+cleanup:
+    pthread_mutex_destroy(&state.lock);
+    pthread_cond_destroy(&state.changed);
+    return ret;
+}
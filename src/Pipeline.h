@@ -0,0 +1,73 @@
+/***************************************************************************************************
+ * @file Pipeline.h
+ * @brief Runs the read, process and write stages of the file tools on different threads.
+ *
+ * A reader thread fills chunks in order, one or more worker threads process them and the calling 
+ * thread writes them back in the same order. The chunks go around a bounded ring, so the reader can
+ * be at most a ring ahead of the writer and the memory used is fixed.
+ *
+ * @version   1.0
+ * @date      2024-07-23
+ * @author    @dabecart
+ *
+ * @license
+ * This project is licensed under the MIT License - see the LICENSE file for details.
+ **************************************************************************************************/
+
+#ifndef PIPELINE_h
+#define PIPELINE_h
+
+#include <stddef.h>
+
+/***************************************************************************************************
+ * DEFINES
+ **************************************************************************************************/
+
+// Maximum number of chunks in the ring.
+#define PIPELINE_MAX_CHUNKS     16
+
+// Maximum number of worker threads.
+#define PIPELINE_MAX_WORKERS    (PIPELINE_MAX_CHUNKS - 2)
+
+/***************************************************************************************************
+ * TYPES
+ **************************************************************************************************/
+
+// Fills [chunk]. Returns 0 if there is nothing else to read. Only called from the reader thread.
+typedef int  (*PipelineRead)(void* chunk, void* context);
+
+// Processes [chunk]. Called from the worker threads, so it can only write to the chunk and to the
+// state of its [worker], which goes from 0 to the number of workers - 1.
+typedef void (*PipelineProcess)(void* chunk, void* context, int worker);
+
+// Writes [chunk]. Returns a negative value to stop the pipeline. Called from the calling thread in
+// the same order as the chunks were read.
+typedef int  (*PipelineWrite)(void* chunk, void* context);
+
+typedef struct{
+    // Array of [numChunks] chunks of [chunkSize] bytes each.
+    void* chunks;
+    size_t chunkSize;
+    int numChunks;
+
+    // Number of worker threads. If 0, it's set to defaultPipelineWorkers().
+    int workers;
+
+    PipelineRead read;
+    PipelineProcess process;
+    PipelineWrite write;
+    void* context;
+} Pipeline;
+
+/***************************************************************************************************
+ * FUNCTIONS
+ **************************************************************************************************/
+
+// Returns the number of worker threads to use by default.
+int defaultPipelineWorkers();
+
+// Runs the pipeline until there is nothing else to read. Returns 0 on success or -1 if a write 
+// failed or the threads couldn't be created.
+int runPipeline(Pipeline* pipeline);
+
+#endif //PIPELINE_h
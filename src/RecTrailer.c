@@ -0,0 +1,134 @@
+/***************************************************************************************************
+ * @file RecTrailer.c
+ * @brief Optional sections stored after the recuperation data of a file.
+ *
+ * @version   1.0
+ * @date      2024-07-23
+ * @author    @dabecart
+ *
+ * @license
+ * This project is licensed under the MIT License - see the LICENSE file for details.
+ **************************************************************************************************/
+
+#include "RecTrailer.h"
+
+/***************************************************************************************************
+ * LITTLE ENDIAN
+ **************************************************************************************************/
+
+void putU32(unsigned char* out, unsigned int value){
+    for(int i = 0; i < 4; i++) out[i] = (value >> (8*i)) & 0xFF;
+}
+
+void putU64(unsigned char* out, unsigned long long value){
+    for(int i = 0; i < 8; i++) out[i] = (value >> (8*i)) & 0xFF;
+}
+
+unsigned int getU32(const unsigned char* in){
+    unsigned int value = 0;
+    for(int i = 0; i < 4; i++) value |= (unsigned int) in[i] << (8*i);
+    return value;
+}
+
+unsigned long long getU64(const unsigned char* in){
+    unsigned long long value = 0;
+    for(int i = 0; i < 8; i++) value |= (unsigned long long) in[i] << (8*i);
+    return value;
+}
+
+/***************************************************************************************************
+ * FUNCTIONS
+ **************************************************************************************************/
+
+// Splits the [length] bytes of sections (without the footer) into [trailer].
+static int parseSections(unsigned char* bytes, size_t length, RecTrailer* trailer){
+    size_t position = 0;
+    while(position < length){
+        if(trailer->numSections >= TRAILER_MAX_SECTIONS) return -1;
+        if(length - position < TRAILER_SECTION_HEADER) return -1;
+
+        TrailerSection* section = &trailer->sections[trailer->numSections++];
+        memcpy(section->tag, bytes + position, 4);
+        section->length = getU32(bytes + position + 4);
+        position += TRAILER_SECTION_HEADER;
+
+        if(section->length > length - position) return -1;
+        section->payload = bytes + position;
+        position += section->length;
+    }
+    return 0;
+}
+
+int readRecTrailer(FILE* recFile, long fileSize, RecTrailer* trailer){
+    memset(trailer, 0, sizeof(RecTrailer));
+    trailer->parityLength = fileSize;
+    if(fileSize < TRAILER_FOOTER_SIZE) return 0;
+
+    long position = ftell(recFile);
+    unsigned char footer[TRAILER_FOOTER_SIZE];
+    fseek(recFile, fileSize - TRAILER_FOOTER_SIZE, SEEK_SET);
+    size_t footerRead = fread(footer, 1, TRAILER_FOOTER_SIZE, recFile);
+
+    int ret = 0;
+    if(footerRead == TRAILER_FOOTER_SIZE && 
+       memcmp(footer + 8, TRAILER_MAGIC, TRAILER_MAGIC_SIZE) == 0){
+        unsigned long long length = getU64(footer);
+        if(length > (unsigned long long) (fileSize - TRAILER_FOOTER_SIZE)){
+            ret = -1;
+        }else{
+            trailer->parityLength = fileSize - TRAILER_FOOTER_SIZE - length;
+            trailer->buffer = malloc(length + 1);
+            fseek(recFile, trailer->parityLength, SEEK_SET);
+            if(trailer->buffer == NULL || fread(trailer->buffer, 1, length, recFile) != length){
+                ret = -1;
+            }else{
+                ret = parseSections(trailer->buffer, length, trailer);
+            }
+        }
+    }
+
+    fseek(recFile, position, SEEK_SET);
+    if(ret < 0) freeRecTrailer(trailer);
+    return ret;
+}
+
+int parseRecTrailer(unsigned char* bytes, size_t length, RecTrailer* trailer){
+    memset(trailer, 0, sizeof(RecTrailer));
+    if(length < TRAILER_FOOTER_SIZE) return -1;
+
+    unsigned char* footer = bytes + length - TRAILER_FOOTER_SIZE;
+    if(memcmp(footer + 8, TRAILER_MAGIC, TRAILER_MAGIC_SIZE) != 0) return -1;
+    if(getU64(footer) != length - TRAILER_FOOTER_SIZE) return -1;
+    return parseSections(bytes, length - TRAILER_FOOTER_SIZE, trailer);
+}
+
+const TrailerSection* findTrailerSection(const RecTrailer* trailer, const char* tag){
+    for(int i = 0; i < trailer->numSections; i++){
+        if(memcmp(trailer->sections[i].tag, tag, 4) == 0) return &trailer->sections[i];
+    }
+    return NULL;
+}
+
+void freeRecTrailer(RecTrailer* trailer){
+    free(trailer->buffer);
+    trailer->buffer = NULL;
+    trailer->numSections = 0;
+}
+
+int writeRecTrailer(FILE* out, const TrailerSection* sections, int numSections){
+    unsigned long long length = 0;
+    for(int i = 0; i < numSections; i++){
+        unsigned char header[TRAILER_SECTION_HEADER];
+        memcpy(header, sections[i].tag, 4);
+        putU32(header + 4, sections[i].length);
+        if(fwrite(header, 1, TRAILER_SECTION_HEADER, out) != TRAILER_SECTION_HEADER) return -1;
+        if(fwrite(sections[i].payload, 1, sections[i].length, out) != sections[i].length) return -1;
+        length += TRAILER_SECTION_HEADER + sections[i].length;
+    }
+
+    unsigned char footer[TRAILER_FOOTER_SIZE];
+    putU64(footer, length);
+    memcpy(footer + 8, TRAILER_MAGIC, TRAILER_MAGIC_SIZE);
+    if(fwrite(footer, 1, TRAILER_FOOTER_SIZE, out) != TRAILER_FOOTER_SIZE) return -1;
+    return 0;
+}
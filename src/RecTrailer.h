@@ -0,0 +1,90 @@
+/***************************************************************************************************
+ * @file RecTrailer.h
+ * @brief Optional sections stored after the recuperation data of a file.
+ *
+ * The recuperation file starts with the REC_BYTES_PER_BLOCK bytes of every block, so the data of 
+ * the block n is always at n*REC_BYTES_PER_BLOCK. Anything else (indexes, checksums...) is stored 
+ * after it as a trailer:
+ *
+ *   [Recuperation data][Section 0]...[Section N][Footer]
+ *
+ * Every section is a 4 character tag, the length of its payload as a little endian uint32 and the 
+ * payload. The footer is the length of all the sections as a little endian uint64 followed by 
+ * TRAILER_MAGIC. Files without a trailer are still valid recuperation files.
+ *
+ * @version   1.0
+ * @date      2024-07-23
+ * @author    @dabecart
+ *
+ * @license
+ * This project is licensed under the MIT License - see the LICENSE file for details.
+ **************************************************************************************************/
+
+#ifndef REC_TRAILER_h
+#define REC_TRAILER_h
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+/***************************************************************************************************
+ * DEFINES
+ **************************************************************************************************/
+
+#define TRAILER_MAGIC           "RSTRAIL1"
+#define TRAILER_MAGIC_SIZE      8
+#define TRAILER_FOOTER_SIZE     (8 + TRAILER_MAGIC_SIZE)
+#define TRAILER_SECTION_HEADER  8
+
+// Maximum number of sections in a trailer.
+#define TRAILER_MAX_SECTIONS    8
+
+/***************************************************************************************************
+ * TYPES
+ **************************************************************************************************/
+
+typedef struct{
+    char tag[4];
+    unsigned int length;
+    unsigned char* payload;
+} TrailerSection;
+
+typedef struct{
+    // Bytes of recuperation data before the trailer.
+    long parityLength;
+
+    int numSections;
+    TrailerSection sections[TRAILER_MAX_SECTIONS];
+
+    // Holds the payloads of the sections.
+    unsigned char* buffer;
+} RecTrailer;
+
+/***************************************************************************************************
+ * FUNCTIONS
+ **************************************************************************************************/
+
+// Little endian helpers to build and read the payloads.
+void putU32(unsigned char* out, unsigned int value);
+void putU64(unsigned char* out, unsigned long long value);
+unsigned int getU32(const unsigned char* in);
+unsigned long long getU64(const unsigned char* in);
+
+// Reads the trailer of a seekable recuperation file of [fileSize] bytes without moving its 
+// position. If it has no trailer, [parityLength] is the size of the file and there are no sections.
+// Returns -1 if the trailer is malformed.
+int readRecTrailer(FILE* recFile, long fileSize, RecTrailer* trailer);
+
+// Parses the [length] bytes of a complete trailer (sections and footer) that are already in memory.
+// [bytes] must stay alive while the trailer is used. Returns -1 if they are not a valid trailer.
+int parseRecTrailer(unsigned char* bytes, size_t length, RecTrailer* trailer);
+
+// Returns the section with [tag] or NULL if there's none.
+const TrailerSection* findTrailerSection(const RecTrailer* trailer, const char* tag);
+
+void freeRecTrailer(RecTrailer* trailer);
+
+// Writes the [numSections] sections and the footer at the current position of [out].
+int writeRecTrailer(FILE* out, const TrailerSection* sections, int numSections);
+
+#endif //REC_TRAILER_h
@@ -0,0 +1,217 @@
+/***************************************************************************************************
+ * @file RecoveryReport.c
+ * @brief Machine-readable report of a recuperation.
+ *
+ * @version   1.0
+ * @date      2024-07-23
+ * @author    @dabecart
+ *
+ * @license
+ * This project is licensed under the MIT License - see the LICENSE file for details.
+ **************************************************************************************************/
+
+#include "RecoveryReport.h"
+#include "RecTrailer.h"
+
+#define BLOCKS_PER_BYTE 4
+
+/***************************************************************************************************
+ * OUTCOMES
+ **************************************************************************************************/
+
+void initRecoveryReport(RecoveryReport* report){
+    memset(report, 0, sizeof(RecoveryReport));
+    report->depth = 1;
+}
+
+void freeRecoveryReport(RecoveryReport* report){
+    free(report->outcomes);
+    report->outcomes = NULL;
+}
+
+static void countOutcome(RecoveryReport* report, BlockOutcome outcome, long delta){
+    switch(outcome){
+        case BLOCK_CLEAN:   report->cleanBlocks += delta;   break;
+        case BLOCK_FIXED:   report->fixedBlocks += delta;   break;
+        default:            report->failedBlocks += delta;  break;
+    }
+}
+
+BlockOutcome getBlockOutcome(const RecoveryReport* report, long block){
+    return (report->outcomes[block/BLOCKS_PER_BYTE] >> (2*(block % BLOCKS_PER_BYTE))) & 3;
+}
+
+void setBlockOutcome(RecoveryReport* report, long block, BlockOutcome outcome, int errors){
+    unsigned char* byte = &report->outcomes[block/BLOCKS_PER_BYTE];
+    int shift = 2*(block % BLOCKS_PER_BYTE);
+
+    countOutcome(report, getBlockOutcome(report, block), -1);
+    *byte = (*byte & ~(3 << shift)) | (outcome << shift);
+    countOutcome(report, outcome, 1);
+
+    if(errors >= 0 && errors < REPORT_ERROR_BUCKETS) report->errorHistogram[errors]++;
+}
+
+int addBlockOutcome(RecoveryReport* report, BlockOutcome outcome, int errors){
+    if(report->numBlocks == report->capacity*BLOCKS_PER_BYTE){
+        long capacity = report->capacity ? 2*report->capacity : 4096;
+        unsigned char* outcomes = realloc(report->outcomes, capacity);
+        if(outcomes == NULL) return -1;
+        memset(outcomes + report->capacity, 0, capacity - report->capacity);
+        report->outcomes = outcomes;
+        report->capacity = capacity;
+    }
+
+    // New blocks start as clean.
+    report->cleanBlocks++;
+    setBlockOutcome(report, report->numBlocks++, outcome, errors);
+    return 0;
+}
+
+int reportTimeBucket(long long nanoseconds){
+    int bucket = 0;
+    while(nanoseconds > 1 && bucket < REPORT_TIME_BUCKETS - 1){
+        nanoseconds >>= 1;
+        bucket++;
+    }
+    return bucket;
+}
+
+/***************************************************************************************************
+ * RANGES
+ **************************************************************************************************/
+
+// Finds the next run of damaged (fixed or failed) blocks from [*block]. Returns 0 if there are no
+// more.
+static int nextDamagedRange(const RecoveryReport* report, long* block, long* first, long* last,
+                            long* failed){
+    while(*block < report->numBlocks && getBlockOutcome(report, *block) == BLOCK_CLEAN){
+        // Skip the clean bytes at once.
+        if(*block % BLOCKS_PER_BYTE == 0 && report->outcomes[*block/BLOCKS_PER_BYTE] == 0){
+            *block += BLOCKS_PER_BYTE;
+        }else{
+            (*block)++;
+        }
+    }
+    if(*block >= report->numBlocks) return 0;
+
+    *first = *block;
+    *failed = 0;
+    BlockOutcome outcome;
+    while(*block < report->numBlocks &&
+          (outcome = getBlockOutcome(report, *block)) != BLOCK_CLEAN){
+        *failed += outcome == BLOCK_FAILED;
+        (*block)++;
+    }
+    *last = *block - 1;
+    return 1;
+}
+
+/***************************************************************************************************
+ * JSON
+ **************************************************************************************************/
+
+static void writeBase64(FILE* out, const unsigned char* data, long length){
+    const char* alphabet = "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+    for(long i = 0; i < length; i += 3){
+        unsigned int triple = data[i] << 16;
+        if(i + 1 < length) triple |= data[i+1] << 8;
+        if(i + 2 < length) triple |= data[i+2];
+
+        fputc(alphabet[(triple >> 18) & 0x3F], out);
+        fputc(alphabet[(triple >> 12) & 0x3F], out);
+        fputc(i + 1 < length ? alphabet[(triple >> 6) & 0x3F] : '=', out);
+        fputc(i + 2 < length ? alphabet[triple & 0x3F] : '=', out);
+    }
+}
+
+int writeReportJson(const RecoveryReport* report, FILE* out, const char* inputFilename,
+                    const char* recuperationFilename){
+    double seconds = report->nanoseconds/1e9;
+    fprintf(out, "{\n  \"data\": \"%s\",\n  \"recuperation\": \"%s\",\n"
+                 "  \"blocks\": %ld,\n  \"clean_blocks\": %ld,\n  \"fixed_blocks\": %ld,\n"
+                 "  \"failed_blocks\": %ld,\n  \"column_fixed_blocks\": %ld,\n"
+                 "  \"interleave_depth\": %ld,\n  \"bytes\": %ld,\n  \"seconds\": %0.6f,\n"
+                 "  \"throughput_mb_s\": %0.3f,\n  \"ranges\": [",
+            inputFilename, recuperationFilename, report->numBlocks, report->cleanBlocks,
+            report->fixedBlocks, report->failedBlocks, report->columnFixedBlocks, report->depth,
+            report->dataLength, seconds, seconds > 0 ? report->dataLength/seconds/1e6 : 0.0);
+
+    // On interleaved files, the bytes of a range are the ones of the groups of its blocks.
+    long block = 0, first, last, failed, numRanges = 0;
+    while(nextDamagedRange(report, &block, &first, &last, &failed)){
+        long offset = (first - first % report->depth)*NUM_POINTS_SAMPLE;
+        long end = (last - last % report->depth + report->depth)*NUM_POINTS_SAMPLE;
+        if(end > report->dataLength) end = report->dataLength;
+        fprintf(out, "%s\n    {\"first_block\": %ld, \"last_block\": %ld, \"offset\": %ld, "
+                     "\"length\": %ld, \"failed\": %ld}",
+                numRanges++ ? "," : "", first, last, offset, end - offset, failed);
+    }
+
+    fprintf(out, "%s],\n  \"errors_histogram\": [", numRanges ? "\n  " : "");
+    for(int i = 0; i < REPORT_ERROR_BUCKETS; i++){
+        fprintf(out, "%s%ld", i ? ", " : "", report->errorHistogram[i]);
+    }
+
+    // Only the buckets with blocks, each one from [from_ns] to twice as much.
+    fprintf(out, "],\n  \"decode_time_histogram\": [");
+    int numBuckets = 0;
+    for(int i = 0; i < REPORT_TIME_BUCKETS; i++){
+        if(report->timeHistogram[i] == 0) continue;
+        fprintf(out, "%s{\"from_ns\": %llu, \"blocks\": %ld}", numBuckets++ ? ", " : "",
+                1ULL << i, report->timeHistogram[i]);
+    }
+
+    // Four blocks per byte, from the lowest bits: 0 clean, 1 fixed and 2 failed.
+    fprintf(out, "],\n  \"outcome_bitmap\": \"");
+    writeBase64(out, report->outcomes, (report->numBlocks + BLOCKS_PER_BYTE - 1)/BLOCKS_PER_BYTE);
+    fprintf(out, "\"\n}\n");
+    return ferror(out) ? -1 : 0;
+}
+
+/***************************************************************************************************
+ * BINARY
+ **************************************************************************************************/
+
+static void writeU32(FILE* out, unsigned int value){
+    unsigned char bytes[4];
+    putU32(bytes, value);
+    fwrite(bytes, 1, sizeof(bytes), out);
+}
+
+static void writeU64(FILE* out, unsigned long long value){
+    unsigned char bytes[8];
+    putU64(bytes, value);
+    fwrite(bytes, 1, sizeof(bytes), out);
+}
+
+int writeReportBinary(const RecoveryReport* report, FILE* out){
+    fwrite(REPORT_MAGIC, 1, strlen(REPORT_MAGIC), out);
+    writeU64(out, report->numBlocks);
+    writeU64(out, report->cleanBlocks);
+    writeU64(out, report->fixedBlocks);
+    writeU64(out, report->failedBlocks);
+    writeU64(out, report->columnFixedBlocks);
+    writeU64(out, report->dataLength);
+    writeU64(out, report->nanoseconds);
+    writeU64(out, report->depth);
+
+    writeU32(out, REPORT_ERROR_BUCKETS);
+    for(int i = 0; i < REPORT_ERROR_BUCKETS; i++) writeU64(out, report->errorHistogram[i]);
+    writeU32(out, REPORT_TIME_BUCKETS);
+    for(int i = 0; i < REPORT_TIME_BUCKETS; i++)  writeU64(out, report->timeHistogram[i]);
+
+    // The ranges are counted first.
+    long block = 0, first, last, failed, numRanges = 0;
+    while(nextDamagedRange(report, &block, &first, &last, &failed)) numRanges++;
+    writeU64(out, numRanges);
+    block = 0;
+    while(nextDamagedRange(report, &block, &first, &last, &failed)){
+        writeU64(out, first);
+        writeU64(out, last);
+        writeU64(out, failed);
+    }
+
+    fwrite(report->outcomes, 1, (report->numBlocks + BLOCKS_PER_BYTE - 1)/BLOCKS_PER_BYTE, out);
+    return ferror(out) ? -1 : 0;
+}
@@ -0,0 +1,100 @@
+/***************************************************************************************************
+ * @file RecoveryReport.h
+ * @brief Machine-readable report of a recuperation.
+ *
+ * The report keeps the outcome of every block (clean, fixed or failed) on a bitmap of two bits per
+ * block, from which the damaged ranges are built, and histograms of the errors fixed per block and
+ * of the time spent decoding each one. It's written as JSON or as a binary sidecar:
+ *
+ *   "RSREPRT1"  magic
+ *   u64         blocks, clean blocks, fixed blocks, failed blocks, column fixed blocks
+ *   u64         bytes of data, nanoseconds of the whole recuperation, interleave depth
+ *   u32 + u64[] errors histogram: blocks with 0, 1, 2... errors fixed
+ *   u32 + u64[] decode time histogram: blocks that took [2^i, 2^(i+1)) ns
+ *   u64 + (u64 first block, u64 last block, u64 failed blocks)[] damaged ranges
+ *   u8[]        outcome bitmap, four blocks per byte from the lowest bits
+ *
+ * All numbers are little endian.
+ *
+ * @version   1.0
+ * @date      2024-07-23
+ * @author    @dabecart
+ *
+ * @license
+ * This project is licensed under the MIT License - see the LICENSE file for details.
+ **************************************************************************************************/
+
+#ifndef RECOVERY_REPORT_h
+#define RECOVERY_REPORT_h
+
+#include <stdio.h>
+#include "CommonDefines.h"
+
+/***************************************************************************************************
+ * DEFINES
+ **************************************************************************************************/
+
+#define REPORT_MAGIC            "RSREPRT1"
+
+// Buckets of the histograms. A block can have up to RS_MAX_POLY_DEGREE points fixed, and the
+// decode times go up to 2^32 ns (about 4 s).
+#define REPORT_ERROR_BUCKETS    (RS_MAX_POLY_DEGREE + 1)
+#define REPORT_TIME_BUCKETS     32
+
+/***************************************************************************************************
+ * TYPES
+ **************************************************************************************************/
+
+typedef enum{
+    BLOCK_CLEAN     = 0,
+    BLOCK_FIXED     = 1,
+    BLOCK_FAILED    = 2,
+} BlockOutcome;
+
+typedef struct{
+    // Two bits per block.
+    unsigned char* outcomes;
+    long numBlocks;
+    long capacity;
+
+    long cleanBlocks;
+    long fixedBlocks;
+    long failedBlocks;
+    long columnFixedBlocks;
+
+    long errorHistogram[REPORT_ERROR_BUCKETS];
+    long timeHistogram[REPORT_TIME_BUCKETS];
+
+    // Layout of the file and totals of the recuperation.
+    long depth;
+    long dataLength;
+    long long nanoseconds;
+} RecoveryReport;
+
+/***************************************************************************************************
+ * FUNCTIONS
+ **************************************************************************************************/
+
+void initRecoveryReport(RecoveryReport* report);
+
+void freeRecoveryReport(RecoveryReport* report);
+
+// Appends the outcome of the next block of the file. [errors] is the number of points fixed on it,
+// or -1 if it's not known (failed blocks and the ones recuperated with the column parity). Returns
+// -1 if there's no memory.
+int addBlockOutcome(RecoveryReport* report, BlockOutcome outcome, int errors);
+
+// Changes the outcome of a block already added, e.g. when a deferred block gets fixed.
+void setBlockOutcome(RecoveryReport* report, long block, BlockOutcome outcome, int errors);
+
+BlockOutcome getBlockOutcome(const RecoveryReport* report, long block);
+
+// Bucket of the time histogram for a decoding of [nanoseconds].
+int reportTimeBucket(long long nanoseconds);
+
+// Write the report on [out]. They return -1 on error.
+int writeReportJson(const RecoveryReport* report, FILE* out, const char* inputFilename,
+                    const char* recuperationFilename);
+int writeReportBinary(const RecoveryReport* report, FILE* out);
+
+#endif
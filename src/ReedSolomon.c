@@ -11,6 +11,11 @@
  **************************************************************************************************/
 
 #include "ReedSolomon.h"
+#include "Checksum.h"
+#include "Instrumentation.h"
+#include "ModArith.h"
+#include <pthread.h>
+#include <stdatomic.h>
 
 /***************************************************************************************************
  * BASIC MATH
@@ -38,26 +43,6 @@ static inline int arrayParity(int* x, int len){
     return par;
 }
 
-// CRC-16-CCITT
-unsigned short calculateCRC(unsigned char *data, size_t length) {
-    const unsigned short POLYNOMIAL  = 0x1021;
-    const unsigned short INITIAL_CRC = 0xFFFF;
-
-    unsigned short crc = INITIAL_CRC;
-    for (size_t byteIndex = 0; byteIndex < length; byteIndex++) {
-        crc ^= (unsigned short)data[byteIndex] << 8;
-
-        for (int bit = 0; bit < 8; bit++) {
-            if (crc & 0x8000) {
-                crc = (crc << 1) ^ POLYNOMIAL;
-            } else {
-                crc <<= 1;
-            }
-        }
-    }
-    return crc;
-}
-
 /***************************************************************************************************
  * MOD INTEGER
  **************************************************************************************************/
@@ -65,16 +50,17 @@ unsigned short calculateCRC(unsigned char *data, size_t length) {
 const ModInt ZERO = 0;
 const ModInt ONE  = 1;
 
-static inline ModInt mod(ModInt x){
-    return x%MODULUS;
+// Takes the whole 32 bits: a product like 256*256 doesn't fit in a ModInt (see ModArith.h).
+static inline ModInt mod(ModAcc x){
+    return reduceMod(x);
 }
 
 static inline ModInt sumModInt(ModInt x, ModInt y){
-    return mod(x+y);
+    return mod((ModAcc) x + y);
 }
 
 static inline ModInt multModInt(ModInt x, ModInt y){
-    return mod(x*y);
+    return mod((ModAcc) x*y);
 }
 
 // Calculates the mod of the fraction a/b. For that, this function has to obtain the multiplicative
@@ -201,46 +187,55 @@ static inline void sumPoly(Polynomial* p, Polynomial* q, Polynomial* pout){
     reducePoly(pout);
 }
 
-// This naive approach is O(n^2).
+// This naive approach is O(n^2). Every coefficient is a sum of products that gets reduced once.
 static inline void multPoly(Polynomial* p, Polynomial* q, Polynomial* pout){
-    Polynomial newP;
-    if(p == pout){
-        memcpy(&newP, p, sizeof(Polynomial));
-        p = &newP;
-        *pout = POLY_ZERO;
-    }
-
-    pout->degree = p->degree + q->degree;
-    if(pout->degree > RS_MAX_POLY_DEGREE){
+    int degree = p->degree + q->degree;
+    if(degree > RS_MAX_POLY_DEGREE){
         printf("Degree overflow\n");
         exit(-1);
     }
 
+    ModAcc acc[RS_MAX_POLY_DEGREE+1] = {0};
     for(int i = 0; i <= p->degree; i++){
         for(int j = 0; j <= q->degree; j++){
-            pout->coeffs[i+j] = sumModInt(
-                                    pout->coeffs[i+j], 
-                                    multModInt(p->coeffs[i], q->coeffs[j])
-                                );
+            acc[i+j] += (ModAcc) p->coeffs[i]*q->coeffs[j];
         }
     }
+
+    pout->degree = degree;
+    for(int i = 0; i <= degree; i++) pout->coeffs[i] = mod(acc[i]);
     reducePoly(pout);
 }
 
+// Multiplies [p] by the monic (x + c) in place, O(n).
+static inline void multPolyByMonic(Polynomial* p, ModInt c){
+    if(p->degree + 1 > RS_MAX_POLY_DEGREE){
+        printf("Degree overflow\n");
+        exit(-1);
+    }
+
+    p->degree++;
+    p->coeffs[p->degree] = p->coeffs[p->degree - 1];
+    for(int i = p->degree - 1; i > 0; i--){
+        p->coeffs[i] = mod(p->coeffs[i-1] + (ModAcc) p->coeffs[i]*c);
+    }
+    p->coeffs[0] = multModInt(p->coeffs[0], c);
+}
+
 static inline void multPolyByFrac(Polynomial* p, ModInt a, Polynomial* pout){
-    Polynomial polyA = {
-        .degree = 0,
-        .coeffs = {a},
-    };
-    multPoly(p, &polyA, pout);
+    pout->degree = p->degree;
+    for(int i = 0; i <= p->degree; i++) pout->coeffs[i] = multModInt(p->coeffs[i], a);
+    reducePoly(pout);
 }
 
 // Implementation of Horner's Method, O(n) instead of O(n^2).
 // p(x) = a + bx + cx^2 + dx^3 = a + x(b + c(x + dx))
+// Every step is a single multiply-add and a reduction without divisions.
 ModInt evaluatePoly(Polynomial* p, ModInt x){
+    STATS_INC(evaluations);
     ModInt px = p->coeffs[p->degree];
     for(int i = p->degree-1; i >= 0; i--){
-        px = sumModInt(p->coeffs[i], multModInt(px, x));
+        px = mod(p->coeffs[i] + (ModAcc) px*x);
     }
     return px;
 }
@@ -262,37 +257,144 @@ void printPoly(Polynomial* p){
  **************************************************************************************************/
 
 /***************************************************************************************************
- * \brief Calculates a function which is zero at all [x] except at [one], where it is [valueAtOne].
+ * \brief Calculates a function which is zero at all [x] except at [one]. It's left monic in [pout]
+ * and the factor that makes it [valueAtOne] at [one] is returned, so the caller can scale it.
  **************************************************************************************************/
-static inline void createSingleLagrangeInterp(int one, int* x, int count, int valueAtOne, Polynomial* pout){
+static inline ModInt createSingleLagrangeInterp(int one, int* x, int count, int valueAtOne, 
+                                                Polynomial* pout){
     *pout = POLY_ONE;
-    Polynomial zeroP = {
-        .degree = 1,
-    };
-
     for(int i = 0; i < count; i++){
         // Skip the one.
         if(x[i] == one) continue;
 
         // Add a zero to the polynomial: (x - xi) mod MODULUS === (x + MODULUS - xi) mod MODULUS,
         // supposing xi >= -MODULUS. This allows us to use unsigned short as ModInt in mod 257!
-        zeroP.coeffs[0] = MODULUS-x[i]; 
-        zeroP.coeffs[1] = ONE;
-
-        multPoly(pout, &zeroP, pout);
+        multPolyByMonic(pout, MODULUS-x[i]);
     }
 
-    ModInt pFactor = modFrac(valueAtOne, evaluatePoly(pout, one));
-    multPolyByFrac(pout, pFactor, pout);
+    return modFrac(valueAtOne, evaluatePoly(pout, one));
 }
 
+// The scaled single interpolations are added up without reducing, and reduced once at the end.
 void createLagrangeInterp(int* x, int* y, int count, Polynomial* pout){
-    *pout = POLY_ZERO;
+    STATS_INC(interpolations);
+    STATS_SPAN_BEGIN(interpolation);
+
+    ModAcc acc[RS_MAX_POLY_DEGREE+1] = {0};
     Polynomial singleLag;
     for(int i = 0; i < count; i++){
-        createSingleLagrangeInterp(x[i], x, count, y[i], &singleLag);
-        sumPoly(pout, &singleLag, pout);
+        ModInt pFactor = createSingleLagrangeInterp(x[i], x, count, y[i], &singleLag);
+        for(int j = 0; j <= singleLag.degree; j++){
+            acc[j] += (ModAcc) singleLag.coeffs[j]*pFactor;
+        }
     }
+
+    pout->degree = count > 0 ? count - 1 : 0;
+    for(int j = 0; j <= pout->degree; j++) pout->coeffs[j] = mod(acc[j]);
+    for(int j = pout->degree + 1; j <= RS_MAX_POLY_DEGREE; j++) pout->coeffs[j] = ZERO;
+    reducePoly(pout);
+
+    STATS_SPAN_END(SPAN_INTERPOLATION, interpolation);
+}
+
+/***************************************************************************************************
+ * BARYCENTRIC INTERPOLATION
+ **************************************************************************************************/
+
+// The points of a message are always at x = 0, 1, ..., RS_MAX_POLY_DEGREE-1. For a subset S of 
+// them with values y, the interpolating polynomial is, at any other point t of the grid:
+//     p(t) = l(t) * sum_{j in S} y_j*w_j/(t - j),  with l(t) = prod_{m in S} (t - m)
+//     and the weights w_j = 1/prod_{m in S, m != j} (j - m).
+// The weights of the whole grid and the inverses of all differences are tabulated, so the weights
+// of S only need the (few) points left out of it, and every value is a dot product with no 
+// inversions and no polynomial at all.
+#define GRID_POINTS (RS_MAX_POLY_DEGREE)
+
+// (t - j) and 1/(t - j), with 0 when t == j.
+static ModInt gridDiff[GRID_POINTS][GRID_POINTS];
+static ModInt gridInvDiff[GRID_POINTS][GRID_POINTS];
+// Weight of every point on the whole grid, and the inverse of it.
+static ModInt gridWeight[GRID_POINTS];
+static ModInt gridNodeProduct[GRID_POINTS];
+static pthread_once_t gridOnce = PTHREAD_ONCE_INIT;
+
+static void initGrid(){
+    for(int t = 0; t < GRID_POINTS; t++){
+        gridNodeProduct[t] = ONE;
+        for(int j = 0; j < GRID_POINTS; j++){
+            if(t == j) continue;
+            gridDiff[t][j] = mod(t + MODULUS - j);
+            gridInvDiff[t][j] = modFrac(ONE, gridDiff[t][j]);
+            gridNodeProduct[t] = multModInt(gridNodeProduct[t], gridDiff[t][j]);
+        }
+        gridWeight[t] = modFrac(ONE, gridNodeProduct[t]);
+    }
+}
+
+typedef struct{
+    // Points of S, as a mask of the grid, and the ones of the grid left out.
+    int mask;
+    int count;
+    int nodes[GRID_POINTS];
+    int numOutside;
+    int outside[GRID_POINTS];
+
+    // y_j and y_j*w_j of the points of S, indexed by their x.
+    ModInt values[GRID_POINTS];
+    ModInt scaled[GRID_POINTS];
+} BarycentricInterp;
+
+// Prepares the interpolation through the points [x] (of the grid) with values [y] whose index, 
+// below [len], has its bit set on [subset]. The points are taken straight from the arrays, so the 
+// ones left out don't need to be copied.
+static void createBarycentricInterp(const int* x, const int* y, int len, int subset, 
+                                    BarycentricInterp* b){
+    pthread_once(&gridOnce, initGrid);
+    STATS_INC(interpolations);
+    STATS_SPAN_BEGIN(interpolation);
+
+    b->mask = 0;
+    b->count = 0;
+    for(int i = 0; i < len; i++){
+        if(!(subset & (1 << i))) continue;
+        b->nodes[b->count++] = x[i];
+        b->values[x[i]] = y[i];
+        b->mask |= 1 << x[i];
+    }
+    b->numOutside = 0;
+    for(int m = 0; m < GRID_POINTS; m++){
+        if(!(b->mask & (1 << m))) b->outside[b->numOutside++] = m;
+    }
+
+    // w_j = W_j * prod_{m not in S} (j - m).
+    for(int i = 0; i < b->count; i++){
+        int j = b->nodes[i];
+        ModInt weight = gridWeight[j];
+        for(int o = 0; o < b->numOutside; o++){
+            weight = multModInt(weight, gridDiff[j][b->outside[o]]);
+        }
+        b->scaled[j] = multModInt(weight, b->values[j]);
+    }
+    STATS_SPAN_END(SPAN_INTERPOLATION, interpolation);
+}
+
+// Value of the interpolation at the point [t] of the grid.
+static inline ModInt evaluateBarycentric(const BarycentricInterp* b, int t){
+    STATS_INC(evaluations);
+    if(b->mask & (1 << t)) return b->values[t];
+
+    // l(t) = prod_{m != t} (t - m) / prod_{m not in S, m != t} (t - m).
+    ModInt nodeProduct = gridNodeProduct[t];
+    for(int o = 0; o < b->numOutside; o++){
+        if(b->outside[o] != t) nodeProduct = multModInt(nodeProduct, gridInvDiff[t][b->outside[o]]);
+    }
+
+    ModAcc acc = 0;
+    for(int i = 0; i < b->count; i++){
+        int j = b->nodes[i];
+        acc += (ModAcc) b->scaled[j]*gridInvDiff[t][j];
+    }
+    return multModInt(nodeProduct, mod(acc));
 }
 
 /***************************************************************************************************
@@ -312,51 +414,34 @@ int calculateHamming(int* x, int* y, int len){
  * ERROR CORRECTION ALGORITHM
  **************************************************************************************************/
 
-// 0 if NO error, 1 if corrected and -1 if impossible to correct.
-AlgorithmReturn checkPoints(int* rx, int* ry, int len, int pointsPerLagrange, int* indices){
+// 0 if NO error, 1 if corrected and -1 if impossible to correct. [subset] has a bit set for every 
+// index of rx/ry used to interpolate. The points [rx] are the grid of the barycentric interpolation 
+// (0, 1, 2...).
+AlgorithmReturn checkPoints(int* rx, int* ry, int len, int subset, int trustParity){
     int pointsNotOk = 0;
-    
-    int x[pointsPerLagrange];
-    int y[pointsPerLagrange];
-    for(int i = 0; i < pointsPerLagrange; i++){
-        x[i] = rx[indices[i]];
-        y[i] = ry[indices[i]];
-        // printf("%d,", x[i]);
-    }
-    // printf("\n");
-
-    Polynomial p;
-    createLagrangeInterp(x, y, pointsPerLagrange, &p);
-
-    // Get the points from rx that aren't in indices, using the fact that they are ordered from 
-    // lesser to greater to reduce computation time from O(n^2) to O(n).
-    int i = 0, j = 0;
-    while(i < len || j < (pointsPerLagrange-1)){
-        if(rx[i] != rx[indices[j]]){
-            // Found a value that it's not on indices.
-            ModInt eval = evaluatePoly(&p, rx[i]);
-            if(eval == -1){   
-                // The result was a fraction that couldn't be inverted, therefore this function is
-                // not valid.
-                return COULDNT_BE_FIXED;
-            }else{
-                int pointNotOK = eval != ry[i];
-                
-                // If the EEPROM is OK and this comparator is saying that a point in EEPROM is wrong
-                // skip it, as this function isn't correct.
-                if(EEPROM_NOT_CORRUPTED && pointNotOK && i >= (len - EXTRA_POINTS)){
-                    return COULDNT_BE_FIXED;
-                }
-                pointsNotOk += pointNotOK; 
-            }
-        }else{
-            if(j < (pointsPerLagrange-1)) j++;
+
+    BarycentricInterp b;
+    createBarycentricInterp(rx, ry, len, subset, &b);
+
+    // Only the points that aren't in indices need to be evaluated. The rest are already on the 
+    // interpolation.
+    int evals[len];
+    for(int i = 0; i < len; i++){
+        if(b.mask & (1 << rx[i])) continue;
+
+        evals[i] = evaluateBarycentric(&b, rx[i]);
+        int pointNotOK = evals[i] != ry[i];
+
+        // If the EEPROM is OK and this comparator is saying that a point in EEPROM is wrong
+        // skip it, as this function isn't correct.
+        if(trustParity && pointNotOK && i >= (len - EXTRA_POINTS)){
+            return COULDNT_BE_FIXED;
         }
-        i++;
-    }
 
-    // There are too much errors to be fixed.
-    if(pointsNotOk >= EXTRA_POINTS)    return COULDNT_BE_FIXED;
+        // There are too much errors to be fixed, no need to evaluate the rest.
+        pointsNotOk += pointNotOK; 
+        if(pointsNotOk > NUM_FIXABLE_ERRORS)    return COULDNT_BE_FIXED;
+    }
     
     // No errors found!
     if(pointsNotOk == 0)               return WITHOUT_ERRORS;
@@ -364,19 +449,20 @@ AlgorithmReturn checkPoints(int* rx, int* ry, int len, int pointsPerLagrange, in
     int tempSave[len];
     memcpy(tempSave, ry, len*sizeof(int));
 
-    // Errors were found, but can be fixed by evaluating the polynomial.
-    for(i = 0; i < len; i++){
-        ry[i] = evaluatePoly(&p, rx[i]);
+    // Errors were found, but can be fixed with the values of the interpolation.
+    for(int i = 0; i < len; i++){
+        if(!(b.mask & (1 << rx[i]))) ry[i] = evals[i];
     }
 
     // If the EEPROM isn't corrupted, use the Hamming and CRC to double verify.
-    if(EEPROM_NOT_CORRUPTED){
+    if(trustParity){
         // Check the Hamming. The Hamming is sent after the EXTRA_POINTS in the array ry.
         // If the message is the same, when XORing the Hamming, it should return 0.
         int newHamming = calculateHamming(rx,ry, len);
-        int crc = calculateCRC((unsigned char*) ry, len*sizeof(int)) & 0xF0;
+        int crc = crc16((unsigned char*) ry, len*sizeof(int)) & 0xF0;
         if((newHamming | crc) != ry[len]){
             // Hamming wasn't correct, restore the points.
+            STATS_INC(crcRejections);
             memcpy(ry, tempSave, len*sizeof(int));
             return COULDNT_BE_FIXED;
         }
@@ -386,63 +472,199 @@ AlgorithmReturn checkPoints(int* rx, int* ry, int len, int pointsPerLagrange, in
 }
 
 /***************************************************************************************************
- * @brief Creates the combination of all points without repetition.
+ * WORK BUDGET
+ **************************************************************************************************/
+
+// Combinations left to check on the current decodeBlockWithBudget() of this thread. -1 means no 
+// limit.
+static _Thread_local long combinationsLeft = -1;
+
+/***************************************************************************************************
+ * RELIABILITY
+ **************************************************************************************************/
+
+// Reliability of every point of the message being decoded by decodeBlockWithReliability() on this
+// thread, or NULL to search in the order of the tables.
+static _Thread_local const unsigned char* pointReliability = NULL;
+
+void readReliability(const unsigned char* firstRead, const unsigned char* secondRead, 
+                     unsigned char* reliability, long length){
+    for(long i = 0; i < length; i++){
+        // Every bit that changed between the reads makes the byte less reliable.
+        int flips = __builtin_popcount(firstRead[i] ^ secondRead[i]);
+        reliability[i] = flips ? RELIABILITY_MAX - 32*flips + 1 : RELIABILITY_MAX;
+    }
+}
+
+// Cost of checking a subset: how reliable are the points it leaves out.
+typedef struct{
+    int cost;
+    int index;
+} SubsetCost;
+
+static int compareSubsetCosts(const void* a, const void* b){
+    const SubsetCost* first = a;
+    const SubsetCost* second = b;
+    if(first->cost != second->cost) return first->cost - second->cost;
+    return first->index - second->index;
+}
+
+/***************************************************************************************************
+ * PARITY POLICY
+ **************************************************************************************************/
+
+static ParityPolicy parityPolicy = EEPROM_NOT_CORRUPTED ? PARITY_TRUSTED : PARITY_UNTRUSTED;
+
+// Number of times the adaptive policy had to fall back to the untrusted search and how many of
+// those times it fixed the block.
+static atomic_long parityFallbacks = 0;
+static atomic_long parityFallbacksFixed = 0;
+
+void setParityPolicy(ParityPolicy policy){
+    parityPolicy = policy;
+}
+
+ParityPolicy getParityPolicy(){
+    return parityPolicy;
+}
+
+void getParityFallbacks(long* fallbacks, long* fixed){
+    *fallbacks = atomic_load(&parityFallbacks);
+    *fixed = atomic_load(&parityFallbacksFixed);
+}
+
+/***************************************************************************************************
+ * SUBSETS
+ **************************************************************************************************/
+
+// The subsets of points to interpolate, as bitmasks of the indices of rx/ry, for every length of 
+// message (with pointsPerLagrange = len - (EXTRA_POINTS)). They are in lexicographic order of their 
+// indices, the order in which the search tries them:
+//  - subsetsAll: every subset of len-EXTRA_POINTS points.
+//  - subsetsTrusted: the ones with the extra points, that is, the ones to try when the 
+//    recuperation data is trusted.
+typedef struct{
+    unsigned short* masks;
+    int count;
+} SubsetTable;
+
+static SubsetTable subsetsAll[RS_MAX_POLY_DEGREE + 1];
+static SubsetTable subsetsTrusted[RS_MAX_POLY_DEGREE + 1];
+static pthread_once_t subsetsOnce = PTHREAD_ONCE_INIT;
+
+static int binomial(int n, int k){
+    long result = 1;
+    for(int i = 1; i <= k; i++) result = result*(n - k + i)/i;
+    return result;
+}
+
+// Fills [table] with the subsets of [k] of the first [n] indices, plus the bits of [fixedMask].
+static void createSubsetTable(SubsetTable* table, int n, int k, unsigned short fixedMask){
+    table->count = binomial(n, k);
+    table->masks = malloc(table->count*sizeof(unsigned short));
+    if(table->masks == NULL){
+        perror("Couldn't allocate the subset tables");
+        exit(-1);
+    }
+
+    int indices[k + 1];
+    for(int i = 0; i < k; i++) indices[i] = i;
+    for(int c = 0; c < table->count; c++){
+        unsigned short mask = fixedMask;
+        for(int i = 0; i < k; i++) mask |= 1 << indices[i];
+        table->masks[c] = mask;
+
+        // Next subset: increase the last index that can be increased and reset the following ones.
+        int i = k - 1;
+        while(i >= 0 && indices[i] == n - k + i) i--;
+        if(i < 0) break;
+        indices[i]++;
+        for(int j = i + 1; j < k; j++) indices[j] = indices[j-1] + 1;
+    }
+}
+
+static void initSubsets(){
+    for(int len = (EXTRA_POINTS) + 1; len <= RS_MAX_POLY_DEGREE; len++){
+        int pointsPerLagrange = len - (EXTRA_POINTS);
+        createSubsetTable(&subsetsAll[len], len, pointsPerLagrange, 0);
+
+        // The same bounds the search has always used for the extra points.
+        if(pointsPerLagrange - EXTRA_POINTS > 0){
+            unsigned short extraMask = 0;
+            for(int i = len - EXTRA_POINTS; i < len; i++) extraMask |= 1 << i;
+            createSubsetTable(&subsetsTrusted[len], len - EXTRA_POINTS, 
+                              pointsPerLagrange - EXTRA_POINTS, extraMask);
+        }else{
+            subsetsTrusted[len] = subsetsAll[len];
+        }
+    }
+}
+
+// Which subsets of the table to check, given the point pointed by the Hamming. The two Hamming 
+// filters never share a subset, so the second pass doesn't check again any of the first one.
+typedef enum{
+    SUBSETS_ANY,
+    // The ones without the point of the Hamming.
+    SUBSETS_WITHOUT_HAMMING,
+    // The ones with the point of the Hamming and all the points before it.
+    SUBSETS_WITH_HAMMING,
+} SubsetFilter;
+
+/***************************************************************************************************
+ * @brief Checks the subsets of points of [table] that pass the [filter], in order, until one of 
+ * them verifies or fixes the message.
  * @param rx. Array of x, the points of evaluation of the polynomials.
  * @param ry. Array of y, the received values.
  * @param len. Number of received points.
- * @param pointsPerLagrange. The number of points used to create the first lagragian.
- * @param indices. The indices/points which will be used to create the polynomial.
- * @param indexValue. Which index is currently being written.
- * @param indexPosition. To which position is the previous index value being written to [indices].
- * @param hammingBehaviour. If 0, nevermind the Hamming. If 1, only run the points which contain 
- * the Hamming. If -1, only run the points which don't contain the Hamming.
+ * @param table. Subsets to check.
+ * @param filter. Whether the subsets must, or mustn't, have the point [hammingValue].
  * @param hammingValue. The value of the Hamming, aka. on which position the wrong point is.
- * @param hammingIndex. Where in [indices] is the Hamming.
+ * @param trustParity. If 1, the extra points and the Hamming are taken as correct (the EEPROM is
+ * not corrupted).
  **************************************************************************************************/
-AlgorithmReturn doCombinations(int* rx, int* ry, int len, int pointsPerLagrange, 
-                   int* indices, int indexValue, int indexPosition,
-                   int hammingBehaviour, int hammingValue, int hammingIndex){
-    // If the number of points taken are enough, create the polynomial and check.
-    if(indexPosition >= pointsPerLagrange){
-        if((hammingBehaviour == 0) || (hammingBehaviour == -1) || 
-           (hammingBehaviour ==  1 && (indices[hammingIndex] == hammingValue))){
-            return checkPoints(rx, ry, len, pointsPerLagrange, indices);
+static AlgorithmReturn searchSubsets(int* rx, int* ry, int len, const SubsetTable* table,
+                                     SubsetFilter filter, int hammingValue, int trustParity){
+    int hammingMask = filter == SUBSETS_ANY ? 0 : 
+                      filter == SUBSETS_WITH_HAMMING ? (2 << hammingValue) - 1 : 1 << hammingValue;
+    int wantedMask = filter == SUBSETS_WITH_HAMMING ? hammingMask : 0;
+
+    // With the reliability of the points, the subsets that leave out the least reliable ones go 
+    // first. Ties keep the order of the table.
+    int numSubsets = 0;
+    SubsetCost order[table->count];
+    for(int c = 0; c < table->count; c++){
+        int subset = table->masks[c];
+        if((subset & hammingMask) != wantedMask) continue;
+
+        order[numSubsets].index = c;
+        order[numSubsets].cost = 0;
+        for(int i = 0; pointReliability != NULL && i < len; i++){
+            if(!(subset & (1 << i))) order[numSubsets].cost += pointReliability[i];
         }
-        return COULDNT_BE_FIXED;
+        numSubsets++;
     }
+    if(pointReliability != NULL) qsort(order, numSubsets, sizeof(SubsetCost), compareSubsetCosts);
 
-    for(int i = indexValue; i < len; i++){
-        indices[indexPosition] = rx[i];
+    for(int c = 0; c < numSubsets; c++){
+        int subset = table->masks[order[c].index];
 
-        if(i == hammingValue){
-            if(hammingBehaviour == -1)  continue;
-            hammingIndex = i;
+        if(combinationsLeft == 0){
+            STATS_INC(budgetExhausted);
+            return EXCEEDS_WORK_BUDGET;
         }
+        if(combinationsLeft > 0)    combinationsLeft--;
+        STATS_INC(combinations);
 
-        int nextIndex = i + 1;
-        // If we know the EEPROM is working, then we should always try to use the extra points 
-        // stored in it. So, when we have pointsPerLagrange-EXTRA_POINTS points from the actual 
-        // data, use the EEPROM points.
-        if(EEPROM_NOT_CORRUPTED && (indexPosition+1) == (pointsPerLagrange-EXTRA_POINTS)){
-            nextIndex = len - EXTRA_POINTS;
-            // If the next index is the current one, no more checks to do.
-            if(i >= nextIndex){
-                break;
-            }
-        }
-
-        AlgorithmReturn ret = doCombinations(rx, ry, len, pointsPerLagrange, 
-                                 indices, nextIndex, indexPosition + 1,
-                                 hammingBehaviour, hammingValue, hammingIndex);
-        // If the combination cannot be checked, continue searching for a new combination.
         // If no error was found or the error was fixed, no need to continue searching.
-        if(ret != COULDNT_BE_FIXED)   return ret;
+        AlgorithmReturn ret = checkPoints(rx, ry, len, subset, trustParity);
+        if(ret != COULDNT_BE_FIXED) return ret;
     }
     // If this is reached, there are more errors than the maximum able for the algorithm to fix.
     return COULDNT_BE_FIXED;
 }
 
-AlgorithmReturn verifyMessage(int* rx, int* ry, int len, int pointsPerLagrange){
+static AlgorithmReturn verifyWithParity(int* rx, int* ry, int len, int pointsPerLagrange, 
+                                        int trustParity){
     // Using Bi<a,b>=a!/b!/(a-b)! ...
     // Number of combinations when EEPROM is faulty: 
     //    > Bi<len, pointsPerLagrange> 
@@ -450,10 +672,11 @@ AlgorithmReturn verifyMessage(int* rx, int* ry, int len, int pointsPerLagrange){
     //    > Bi<len - EXTRA_POINTS, pointsPerLagrange - EXTRA_POINTS>
     // Example:
     //    > Using 10 points, with 3 EXTRA_POINTS: Faulty: 286 checks, Non faulty: 120 checks (~42%).
-    int indices[pointsPerLagrange];
+    pthread_once(&subsetsOnce, initSubsets);
+    const SubsetTable* table = trustParity ? &subsetsTrusted[len] : &subsetsAll[len];
     AlgorithmReturn verificationStatus = UNDEFINED;
     
-    if(EEPROM_NOT_CORRUPTED){
+    if(trustParity){
         // If the EEPROM is right, we can use the Hamming code to indicate which point to SKIP in 
         // the case there's ONLY ONE ERROR (which should be the most common case if the 
         // interlacing works ok). 
@@ -467,15 +690,15 @@ AlgorithmReturn verifyMessage(int* rx, int* ry, int len, int pointsPerLagrange){
         // The Hamming's value is the point on which an error occurred. If there are are more than a
         // single error then the Hamming cannot be trusted.
         if(currentHamming < (len - EXTRA_POINTS)){
-            verificationStatus = 
-                        doCombinations(rx, ry, len, pointsPerLagrange,
-                                    indices, 0, 0, 
-                                    -1, currentHamming, 0);       // Skip the Hamming.
-            if(verificationStatus < 0){
-                verificationStatus =  
-                        doCombinations(rx, ry, len, pointsPerLagrange, 
-                                    indices, 0, 0, 
-                                    1, currentHamming, 0); // Only run Hamming's combinations.
+            verificationStatus = searchSubsets(rx, ry, len, table, SUBSETS_WITHOUT_HAMMING,
+                                               currentHamming, 1);
+            // Only a real fix guided by the Hamming is a hit. A clean block or a run out of budget 
+            // tells nothing about it.
+            if(verificationStatus == FIXED_OK)          STATS_INC(hammingHits);
+            if(verificationStatus == COULDNT_BE_FIXED)  STATS_INC(hammingMisses);
+            if(verificationStatus < 0 && verificationStatus != EXCEEDS_WORK_BUDGET){
+                verificationStatus = searchSubsets(rx, ry, len, table, SUBSETS_WITH_HAMMING,
+                                                   currentHamming, 1);
             }
         }else{
             goto dontUseHamming;
@@ -483,7 +706,7 @@ AlgorithmReturn verifyMessage(int* rx, int* ry, int len, int pointsPerLagrange){
     }else{
         dontUseHamming:        
         // Never mind the Hamming.
-        verificationStatus = doCombinations(rx, ry, len, pointsPerLagrange, indices, 0, 0, 0, 0, 0);
+        verificationStatus = searchSubsets(rx, ry, len, table, SUBSETS_ANY, 0, trustParity);
     }
 
 
@@ -491,17 +714,43 @@ AlgorithmReturn verifyMessage(int* rx, int* ry, int len, int pointsPerLagrange){
     // exceeded the 255 value set by the byte limit. Remember that extra points are in [0, MODULUS).
     // Example: 256 trimmed as a byte would be 0, so a 0 on the extra points could be 0 or a 256 too
     // if MODULUS was greater than or equal to 255!
-    for(int i = len-EXTRA_POINTS; (verificationStatus < 0) && (i < len); i++){
-        while((verificationStatus < 0) && (ry[i]+256 < MODULUS)){
+    // If the work budget ran out, there's no point in trying.
+    int retry = (verificationStatus < 0) && (verificationStatus != EXCEEDS_WORK_BUDGET);
+    for(int i = len-EXTRA_POINTS; retry && (i < len); i++){
+        while(retry && (ry[i]+256 < MODULUS)){
             ry[i] += 256;
             // Do it recursively to try all possible combinations.
-            verificationStatus = verifyMessage(rx, ry, len, pointsPerLagrange);
+            STATS_RETRY_ENTER();
+            verificationStatus = verifyWithParity(rx, ry, len, pointsPerLagrange, trustParity);
+            STATS_RETRY_LEAVE();
+            retry = (verificationStatus < 0) && (verificationStatus != EXCEEDS_WORK_BUDGET);
         }
     }
 
     return verificationStatus;
 }
 
+AlgorithmReturn verifyMessage(int* rx, int* ry, int len, int pointsPerLagrange){
+    if(parityPolicy != PARITY_ADAPTIVE){
+        return verifyWithParity(rx, ry, len, pointsPerLagrange, parityPolicy == PARITY_TRUSTED);
+    }
+
+    // Most of the time the EEPROM is fine, so try first the faster way.
+    int saved[len + 1];
+    memcpy(saved, ry, sizeof(saved));
+
+    AlgorithmReturn verificationStatus = verifyWithParity(rx, ry, len, pointsPerLagrange, 1);
+    if(verificationStatus < 0 && verificationStatus != EXCEEDS_WORK_BUDGET){
+        // Maybe it's the recuperation data the one that is wrong.
+        memcpy(ry, saved, sizeof(saved));
+        verificationStatus = verifyWithParity(rx, ry, len, pointsPerLagrange, 0);
+
+        atomic_fetch_add(&parityFallbacks, 1);
+        if(verificationStatus > 0) atomic_fetch_add(&parityFallbacksFixed, 1);
+    }
+    return verificationStatus;
+}
+
 // Adds the correction fields at the end of the array (EXTRA_POINTS + 1).
 void addErrorCorrectionFields(int* x, int* y, int numPoints, int* xx, int* yy){
     if(x == NULL || y == NULL){
@@ -509,14 +758,14 @@ void addErrorCorrectionFields(int* x, int* y, int numPoints, int* xx, int* yy){
         exit(-1);
     }
 
-    Polynomial p;
-    createLagrangeInterp(x, y, numPoints, &p);
+    BarycentricInterp b;
+    createBarycentricInterp(x, y, numPoints, (1 << numPoints) - 1, &b);
 
     // TODO: Modify this so it starts from numPoints instead of 0.
     for(int i = 0; i < numPoints+EXTRA_POINTS; i++){
         xx[i] = i;
 
-        yy[i] = evaluatePoly(&p, xx[i]);
+        yy[i] = evaluateBarycentric(&b, xx[i]);
         
         if(yy[i] == -1){
             printf("Error modding the following message:\n");
@@ -535,6 +784,137 @@ void addErrorCorrectionFields(int* x, int* y, int numPoints, int* xx, int* yy){
     }
 
     // Add CRC.
-    int crc = calculateCRC((unsigned char*)yy, (numPoints+EXTRA_POINTS)*sizeof(int)) & 0xF0;
+    int crc = crc16((unsigned char*) yy, (numPoints + EXTRA_POINTS)*sizeof(int)) & 0xF0;
     yy[numPoints + EXTRA_POINTS] |= crc;
-}
\ No newline at end of file
+}
+/***************************************************************************************************
+ * BLOCK INTERPOLATION
+ **************************************************************************************************/
+
+static void interpolateBlock(const unsigned char* data, unsigned char* rec){
+    int x[NUM_POINTS_SAMPLE];
+    int y[NUM_POINTS_SAMPLE];
+    for(int i = 0; i < NUM_POINTS_SAMPLE; i++){
+        x[i] = i;
+        y[i] = data[i];
+    }
+
+    int xx[RS_MAX_POLY_DEGREE];
+    int yy[RS_MAX_POLY_DEGREE + 1];
+    addErrorCorrectionFields(x, y, NUM_POINTS_SAMPLE, xx, yy);
+
+    for(int i = 0; i < REC_BYTES_PER_BLOCK; i++){
+        rec[i] = yy[NUM_POINTS_SAMPLE + i] & 0xFF;
+    }
+}
+
+/***************************************************************************************************
+ * UNIFORM BLOCKS
+ **************************************************************************************************/
+
+// Erased FLASH (0xFF) and paddings (0x00) fill whole blocks with the same byte. The recuperation 
+// data of those blocks is always the same, so it's calculated once for every possible value.
+static unsigned char uniformRec[MAX_DATA_VALUE + 1][REC_BYTES_PER_BLOCK];
+static pthread_once_t uniformRecOnce = PTHREAD_ONCE_INIT;
+
+static void initUniformRec(){
+    unsigned char data[NUM_POINTS_SAMPLE];
+    for(int value = 0; value <= MAX_DATA_VALUE; value++){
+        memset(data, value, NUM_POINTS_SAMPLE);
+        interpolateBlock(data, uniformRec[value]);
+    }
+}
+
+static inline int isUniform(const unsigned char* data){
+    return memcmp(data, data + 1, NUM_POINTS_SAMPLE - 1) == 0;
+}
+
+static inline const unsigned char* getUniformRec(unsigned char value){
+    pthread_once(&uniformRecOnce, initUniformRec);
+    return uniformRec[value];
+}
+
+long countUniformBlocks(const unsigned char* data, const unsigned char* rec, long blocks){
+    if(blocks <= 0 || !isUniform(data)) return 0;
+    if(rec != NULL && memcmp(rec, getUniformRec(data[0]), REC_BYTES_PER_BLOCK) != 0) return 0;
+
+    long count = 1;
+    while(count < blocks && 
+          memcmp(data, data + count*NUM_POINTS_SAMPLE, NUM_POINTS_SAMPLE) == 0 &&
+          (rec == NULL || memcmp(rec, rec + count*REC_BYTES_PER_BLOCK, REC_BYTES_PER_BLOCK) == 0)){
+        count++;
+    }
+    return count;
+}
+
+/***************************************************************************************************
+ * BYTE INTERFACE
+ **************************************************************************************************/
+
+void encodeBlock(const unsigned char* data, unsigned char* rec){
+    if(isUniform(data)){
+        memcpy(rec, getUniformRec(data[0]), REC_BYTES_PER_BLOCK);
+    }else{
+        STATS_SPAN_BEGIN(encode);
+        interpolateBlock(data, rec);
+        STATS_SPAN_END(SPAN_ENCODE, encode);
+    }
+}
+
+AlgorithmReturn decodeBlock(unsigned char* data, const unsigned char* rec, int* errorCount){
+    return decodeBlockWithBudget(data, rec, errorCount, 0);
+}
+
+AlgorithmReturn decodeBlockWithBudget(unsigned char* data, const unsigned char* rec, int* errorCount,
+                                      long maxCombinations){
+    return decodeBlockWithReliability(data, rec, NULL, errorCount, maxCombinations);
+}
+
+AlgorithmReturn decodeBlockWithReliability(unsigned char* data, const unsigned char* rec, 
+                                           const unsigned char* reliability, int* errorCount,
+                                           long maxCombinations){
+    if(countUniformBlocks(data, rec, 1) == 1){
+        if(errorCount != NULL) *errorCount = 0;
+        return WITHOUT_ERRORS;
+    }
+
+    int x[RS_MAX_POLY_DEGREE];
+    int y[RS_MAX_POLY_DEGREE + 1];
+    for(int i = 0; i < RS_MAX_POLY_DEGREE; i++) x[i] = i;
+    for(int i = 0; i < NUM_POINTS_SAMPLE; i++)  y[i] = data[i];
+    for(int i = 0; i < REC_BYTES_PER_BLOCK; i++) y[NUM_POINTS_SAMPLE + i] = rec[i];
+
+    // The recuperation data is taken as fully reliable. If all the data is as reliable as it, the 
+    // order of the tables is as good as any.
+    unsigned char points[RS_MAX_POLY_DEGREE];
+    memset(points, RELIABILITY_MAX, sizeof(points));
+    int anyUnreliable = 0;
+    for(int i = 0; reliability != NULL && i < NUM_POINTS_SAMPLE; i++){
+        points[i] = reliability[i];
+        anyUnreliable |= points[i] != RELIABILITY_MAX;
+    }
+
+    STATS_SPAN_BEGIN(decode);
+    combinationsLeft = maxCombinations > 0 ? maxCombinations : -1;
+    pointReliability = anyUnreliable ? points : NULL;
+    AlgorithmReturn ret = verifyMessage(x, y, RS_MAX_POLY_DEGREE, NUM_POINTS_SAMPLE);
+    pointReliability = NULL;
+    combinationsLeft = -1;
+    STATS_SPAN_END(SPAN_DECODE, decode);
+
+    if(ret < 0){
+        if(errorCount != NULL) *errorCount = -1;
+        return ret;
+    }
+
+    int errors = 0;
+    for(int i = 0; i < NUM_POINTS_SAMPLE; i++){
+        errors += (y[i] & 0xFF) != data[i];
+        data[i] = y[i] & 0xFF;
+    }
+    for(int i = NUM_POINTS_SAMPLE; i < RS_MAX_POLY_DEGREE; i++){
+        errors += (y[i] & 0xFF) != rec[i - NUM_POINTS_SAMPLE];
+    }
+    if(errorCount != NULL) *errorCount = errors;
+    return ret;
+}
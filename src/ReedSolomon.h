@@ -35,11 +35,70 @@ typedef unsigned short ModInt;
 // #define MOD_USE_EUCLID
 #define MOD_USE_ARRAY       
 
+// Reliability of a byte that is surely right. See decodeBlockWithReliability().
+#define RELIABILITY_MAX     255
+
+/***************************************************************************************************
+ * PARITY POLICY
+ **************************************************************************************************/
+// How much the recuperation data (the extra points and the Hamming) is trusted when verifying. The
+// default is given by EEPROM_NOT_CORRUPTED.
+typedef enum{
+    // The recuperation data is always right. It's the fastest and allows to use the Hamming and CRC.
+    PARITY_TRUSTED,
+
+    // The recuperation data may be wrong too. Slower and less reliable.
+    PARITY_UNTRUSTED,
+
+    // Every block is verified first as PARITY_TRUSTED and, only if it fails, as PARITY_UNTRUSTED.
+    PARITY_ADAPTIVE,
+} ParityPolicy;
+
 /***************************************************************************************************
  * FUNCTIONS
  **************************************************************************************************/
+void setParityPolicy(ParityPolicy policy);
+
+ParityPolicy getParityPolicy();
+
+// Number of blocks that PARITY_ADAPTIVE had to verify again as PARITY_UNTRUSTED, and how many of 
+// them were fixed that way.
+void getParityFallbacks(long* fallbacks, long* fixed);
+
+// Verifies and, if needed, fixes the [len] points of [ry] at [rx] = 0, 1, 2... followed by their 
+// Hamming. [pointsPerLagrange] must be len - (EXTRA_POINTS).
 AlgorithmReturn verifyMessage(int* rx, int* ry, int len, int pointsPerLagrange);
 
 void addErrorCorrectionFields(int* x, int* y, int numPoints, int* xx, int* yy);
 
+// Byte interface of the algorithm. [data] is a block of NUM_POINTS_SAMPLE bytes and [rec] its 
+// REC_BYTES_PER_BLOCK bytes of recuperation data, as they are stored on the files.
+void encodeBlock(const unsigned char* data, unsigned char* rec);
+
+// Counts how many of the [blocks] blocks of [data], starting from the first one, are filled with the 
+// same byte as the first one and, if [rec] is not NULL, have the right recuperation data for it. 
+// Those blocks don't need to be encoded nor verified. Returns 0 if the first block is not uniform.
+long countUniformBlocks(const unsigned char* data, const unsigned char* rec, long blocks);
+
+// Verifies and, if needed, fixes [data] in place. If [errorCount] is not NULL, it stores the number
+// of points (data and recuperation) that had to be fixed, or -1 if the block couldn't be fixed.
+AlgorithmReturn decodeBlock(unsigned char* data, const unsigned char* rec, int* errorCount);
+
+// Same as decodeBlock(), but gives up with EXCEEDS_WORK_BUDGET if the block needs to check more than
+// [maxCombinations] combinations of points. 0 means no limit.
+AlgorithmReturn decodeBlockWithBudget(unsigned char* data, const unsigned char* rec, int* errorCount,
+                                      long maxCombinations);
+
+// Same as decodeBlockWithBudget(), but the combinations that leave out the least [reliability] 
+// points of [data] are checked first. [reliability] has a value per byte of [data], from 0 to 
+// RELIABILITY_MAX (fully reliable), or it's NULL to check them in the usual order.
+AlgorithmReturn decodeBlockWithReliability(unsigned char* data, const unsigned char* rec, 
+                                           const unsigned char* reliability, int* errorCount,
+                                           long maxCombinations);
+
+// Estimates the reliability of the [length] bytes read twice on [firstRead] and [secondRead]: the
+// ones that read the same are fully reliable, and the more bits changed the less reliable they are.
+void readReliability(const unsigned char* firstRead, const unsigned char* secondRead, 
+                     unsigned char* reliability, long length);
+
 #endif
\ No newline at end of file
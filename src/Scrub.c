@@ -0,0 +1,362 @@
+/***************************************************************************************************
+ * @file Scrub.c
+ * @brief Verifies a whole archive of protected files in the background, a few of them every run.
+ *
+ * @version   1.0
+ * @date      2024-07-23
+ * @author    @dabecart
+ *
+ * @license
+ * This project is licensed under the MIT License - see the LICENSE file for details.
+ **************************************************************************************************/
+
+#include "Scrub.h"
+#include "Throttle.h"
+#include <dirent.h>
+#include <sys/stat.h>
+#include <time.h>
+#include <unistd.h>
+
+// Statuses of the state file: the ScanStatus of the last scrub, or SCRUB_REPAIRED if it was
+// repaired.
+#define SCRUB_REPAIRED      4
+#define SCRUB_NUM_STATUSES  5
+
+static const char* statusNames[SCRUB_NUM_STATUSES] = {
+    "clean", "repairable", "unrepairable", "misaligned", "repaired"
+};
+
+/***************************************************************************************************
+ * OPTIONS
+ **************************************************************************************************/
+
+static long scrubInterval = SCRUB_DEFAULT_HOURS*3600L;
+static int scrubRepair = 1;
+
+void setScrubInterval(long seconds){
+    scrubInterval = seconds >= 0 ? seconds : 0;
+}
+
+void setScrubRepair(int repair){
+    scrubRepair = repair;
+}
+
+/***************************************************************************************************
+ * FILES
+ **************************************************************************************************/
+
+// A pair of files of the directory, or a line of the state file.
+typedef struct{
+    // Relative to the directory. The recuperation file is NULL on the lines of the state file.
+    char* name;
+    char* recName;
+
+    // As they were on the last scrub. The files never scrubbed have a [lastScrub] of 0.
+    long lastScrub;
+    long size;
+    long modified;
+    int status;
+
+    // It has to be scrubbed on this run.
+    int due;
+} ScrubFile;
+
+typedef struct{
+    ScrubFile* files;
+    long count;
+    long capacity;
+} ScrubList;
+
+static void addScrubFile(ScrubList* list, const ScrubFile* file){
+    if(list->count == list->capacity){
+        long capacity = list->capacity ? 2*list->capacity : 64;
+        ScrubFile* files = realloc(list->files, capacity*sizeof(ScrubFile));
+        if(files == NULL){
+            perror("Error allocating the list of files");
+            exit(-1);
+        }
+        list->files = files;
+        list->capacity = capacity;
+    }
+    list->files[list->count++] = *file;
+}
+
+static void freeScrubList(ScrubList* list){
+    for(long i = 0; i < list->count; i++){
+        free(list->files[i].name);
+        free(list->files[i].recName);
+    }
+    free(list->files);
+}
+
+// Returns a new string with [first] and [second] joined by a slash, or just [second] if [first] is
+// empty.
+static char* joinPath(const char* first, const char* second){
+    size_t length = strlen(first) + strlen(second) + 2;
+    char* path = malloc(length);
+    if(path == NULL){
+        perror("Error allocating a path");
+        exit(-1);
+    }
+    if(first[0] == '\0') snprintf(path, length, "%s", second);
+    else                 snprintf(path, length, "%s/%s", first, second);
+    return path;
+}
+
+static int endsWith(const char* text, const char* suffix){
+    size_t length = strlen(text), suffixLength = strlen(suffix);
+    return length >= suffixLength && strcmp(text + length - suffixLength, suffix) == 0;
+}
+
+static int isRegularFile(const char* path){
+    struct stat info;
+    return stat(path, &info) == 0 && S_ISREG(info.st_mode);
+}
+
+// Returns the recuperation file of [name] (relative to [directory]), or NULL if it has none.
+static char* findRecuperationFile(const char* directory, const char* name){
+    size_t length = strlen(name);
+    char* recName = malloc(length + 5);
+    if(recName == NULL){
+        perror("Error allocating a path");
+        exit(-1);
+    }
+
+    // First DATA.rec, then DATA with its extension replaced.
+    for(int attempt = 0; attempt < 2; attempt++){
+        if(attempt == 0){
+            sprintf(recName, "%s.rec", name);
+        }else{
+            const char* slash = strrchr(name, '/');
+            const char* dot = strrchr(slash ? slash + 1 : name, '.');
+            if(dot == NULL || dot == (slash ? slash + 1 : name)) break;
+            sprintf(recName, "%.*s.rec", (int) (dot - name), name);
+        }
+
+        char* path = joinPath(directory, recName);
+        int found = isRegularFile(path);
+        free(path);
+        if(found) return recName;
+    }
+    free(recName);
+    return NULL;
+}
+
+// Adds the pairs of files of [directory]/[relative] and its subdirectories to [list]. The state file
+// is not a data file.
+static void findScrubFiles(const char* directory, const char* relative, const char* stateFilename,
+                           ScrubList* list){
+    char* path = joinPath(directory, relative);
+    DIR* dir = opendir(path);
+    if(dir == NULL){
+        printf("Directory %s. ", path);
+        fflush(stdout);
+        perror("Error opening it");
+        free(path);
+        return;
+    }
+
+    struct dirent* entry;
+    while((entry = readdir(dir)) != NULL){
+        if(strcmp(entry->d_name, ".") == 0 || strcmp(entry->d_name, "..") == 0) continue;
+
+        char* name = joinPath(relative, entry->d_name);
+        char* filePath = joinPath(directory, name);
+        struct stat info;
+        if(lstat(filePath, &info) < 0){
+            // Gone since it was listed.
+        }else if(S_ISDIR(info.st_mode)){
+            findScrubFiles(directory, name, stateFilename, list);
+        }else if(S_ISREG(info.st_mode) && !endsWith(name, ".rec") && !endsWith(name, ".tmp") &&
+                 strcmp(filePath, stateFilename) != 0){
+            ScrubFile file = {.name = name, .size = -1, .modified = -1, .status = -1};
+            file.recName = findRecuperationFile(directory, name);
+            if(file.recName != NULL){
+                addScrubFile(list, &file);
+                name = NULL;
+            }
+        }
+        free(filePath);
+        free(name);
+    }
+    closedir(dir);
+    free(path);
+}
+
+/***************************************************************************************************
+ * STATE
+ **************************************************************************************************/
+
+// Reads the lines of [stateFilename]. If it doesn't exist, nothing has been scrubbed yet.
+static void loadScrubState(const char* stateFilename, ScrubList* state){
+    FILE* file = fopen(stateFilename, "r");
+    if(file == NULL) return;
+
+    char* line = NULL;
+    size_t capacity = 0;
+    ssize_t length;
+    while((length = getline(&line, &capacity, file)) > 0){
+        if(line[length - 1] == '\n') line[--length] = '\0';
+
+        ScrubFile entry = {0};
+        char status[16];
+        int nameStart = 0;
+        if(sscanf(line, "%ld %ld %ld %15s %n", &entry.lastScrub, &entry.size, &entry.modified,
+                  status, &nameStart) != 4 || nameStart == 0 || line[nameStart] == '\0'){
+            continue;
+        }
+        entry.status = -1;
+        for(int i = 0; i < SCRUB_NUM_STATUSES; i++){
+            if(strcmp(status, statusNames[i]) == 0) entry.status = i;
+        }
+        entry.name = strdup(line + nameStart);
+        if(entry.name == NULL){
+            perror("Error reading the scrub state");
+            exit(-1);
+        }
+        addScrubFile(state, &entry);
+    }
+    free(line);
+    fclose(file);
+}
+
+// Saves the state of every file of [list] on [stateFilename]. It's written aside and renamed, so a
+// scrub that gets stopped never leaves half a state.
+static int saveScrubState(const char* stateFilename, const ScrubList* list){
+    char temporary[strlen(stateFilename) + 5];
+    sprintf(temporary, "%s.tmp", stateFilename);
+    FILE* file = fopen(temporary, "w");
+    if(file == NULL) return -1;
+
+    for(long i = 0; i < list->count; i++){
+        const ScrubFile* entry = &list->files[i];
+        fprintf(file, "%ld %ld %ld %s %s\n", entry->lastScrub, entry->size, entry->modified,
+                entry->status >= 0 ? statusNames[entry->status] : "never", entry->name);
+    }
+
+    int ret = fflush(file) == 0 && fsync(fileno(file)) == 0;
+    if(fclose(file) != 0 || !ret || rename(temporary, stateFilename) != 0){
+        remove(temporary);
+        return -1;
+    }
+    return 0;
+}
+
+// The files never scrubbed go first, then the ones scrubbed longer ago.
+static int compareLastScrub(const void* a, const void* b){
+    const ScrubFile* first = a;
+    const ScrubFile* second = b;
+    if(first->lastScrub != second->lastScrub) return first->lastScrub < second->lastScrub ? -1 : 1;
+    return strcmp(first->name, second->name);
+}
+
+/***************************************************************************************************
+ * SCRUB
+ **************************************************************************************************/
+
+ScanStatus scrubDirectory(const char* directory, const char* stateFilename){
+    char* defaultState = NULL;
+    if(stateFilename == NULL) stateFilename = defaultState = joinPath(directory, SCRUB_STATE_FILENAME);
+
+    ScrubList files = {0}, state = {0};
+    findScrubFiles(directory, "", stateFilename, &files);
+    loadScrubState(stateFilename, &state);
+
+    // A file is due if its last scrub is too old or it changed since then.
+    time_t now = time(NULL);
+    long numDue = 0;
+    for(long i = 0; i < files.count; i++){
+        ScrubFile* file = &files.files[i];
+        for(long j = 0; j < state.count; j++){
+            if(strcmp(state.files[j].name, file->name) != 0) continue;
+            file->lastScrub = state.files[j].lastScrub;
+            file->size = state.files[j].size;
+            file->modified = state.files[j].modified;
+            file->status = state.files[j].status;
+            break;
+        }
+
+        char* path = joinPath(directory, file->name);
+        struct stat info;
+        int changed = stat(path, &info) < 0 || info.st_size != file->size ||
+                      info.st_mtime != file->modified;
+        free(path);
+        file->due = file->lastScrub == 0 || changed || now - file->lastScrub >= scrubInterval;
+        numDue += file->due;
+    }
+    freeScrubList(&state);
+    qsort(files.files, files.count, sizeof(ScrubFile), compareLastScrub);
+
+    printf("Scrubbing %s: %ld of %ld files due.\n", directory, numDue, files.count);
+    fflush(stdout);
+
+    // A background job: it only gets what the rest of the system leaves.
+    lowerPriority();
+    setScanRepair(scrubRepair);
+
+    struct timespec start, end;
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    ScanStatus worst = SCAN_CLEAN;
+    long counts[SCRUB_NUM_STATUSES] = {0};
+    long bytes = 0;
+    for(long i = 0; i < files.count; i++){
+        ScrubFile* file = &files.files[i];
+        if(!file->due) continue;
+        char* dataPath = joinPath(directory, file->name);
+        char* recPath = joinPath(directory, file->recName);
+
+        // scanFile() stops the program if it cannot open them.
+        if(access(dataPath, scrubRepair ? R_OK | W_OK : R_OK) < 0 || access(recPath, R_OK) < 0){
+            printf("\nFile %s. ", dataPath);
+            fflush(stdout);
+            perror("Cannot be scrubbed");
+            free(dataPath);
+            free(recPath);
+            continue;
+        }
+
+        printf("\nScrubbing %s (%s)\n", dataPath, recPath);
+        fflush(stdout);
+        ScanStatus status = scanFile(dataPath, recPath, 0);
+        if(status > worst) worst = status;
+        file->status = (status == SCAN_REPAIRABLE && scrubRepair) ? SCRUB_REPAIRED : (int) status;
+        counts[file->status]++;
+
+        // The repairs change the file, so it's saved as it's now.
+        struct stat info;
+        if(stat(dataPath, &info) == 0){
+            file->size = info.st_size;
+            file->modified = info.st_mtime;
+            bytes += info.st_size;
+        }
+        if(stat(recPath, &info) == 0) bytes += info.st_size;
+        file->lastScrub = time(NULL);
+
+        if(saveScrubState(stateFilename, &files) < 0){
+            printf("File %s. ", stateFilename);
+            fflush(stdout);
+            perror("Error saving the scrub state");
+        }
+        free(dataPath);
+        free(recPath);
+    }
+    clock_gettime(CLOCK_MONOTONIC, &end);
+    double seconds = (end.tv_sec - start.tv_sec) + (end.tv_nsec - start.tv_nsec)/1e9;
+
+    // The state is saved even if nothing was due, so it lists the new files.
+    if(numDue == 0 && saveScrubState(stateFilename, &files) < 0){
+        printf("File %s. ", stateFilename);
+        fflush(stdout);
+        perror("Error saving the scrub state");
+    }
+
+    printf("\nScrub completed: %ld clean, %ld repaired, %ld repairable, %ld unrepairable, "
+           "%ld misaligned. %0.2f MB in %0.2f s (%0.2f MB/s).\n",
+           counts[SCAN_CLEAN], counts[SCRUB_REPAIRED], counts[SCAN_REPAIRABLE],
+           counts[SCAN_UNREPAIRABLE], counts[SCAN_MISALIGNED], bytes/1e6, seconds,
+           seconds > 0 ? bytes/1e6/seconds : 0.0);
+
+    freeScrubList(&files);
+    free(defaultState);
+    return worst;
+}
@@ -0,0 +1,59 @@
+/***************************************************************************************************
+ * @file Scrub.h
+ * @brief Verifies a whole archive of protected files in the background, a few of them every run.
+ *
+ * The scrub walks a directory (and its subdirectories) looking for pairs of data and recuperation
+ * files: the recuperation file of DATA is DATA.rec or, if there's none, DATA with its extension
+ * replaced by .rec (firmware.bin and firmware.rec). Every pair is checked with scanFile() and,
+ * unless told otherwise, the blocks that can be fixed are repaired in place.
+ *
+ * The time of the last scrub of every file is kept on a state file, one line per file:
+ *
+ *   <last scrub> <size> <modification time> <status> <data file>
+ *
+ * with the times in seconds since the epoch and the data file relative to the directory. A run only
+ * checks the files whose last scrub is older than the interval, or that changed since then, oldest
+ * first. The state is saved after every file, so a run that gets stopped doesn't start over.
+ *
+ * The scrub runs with the lowest CPU and I/O priority and the limits of setThrottle().
+ *
+ * @version   1.0
+ * @date      2024-07-23
+ * @author    @dabecart
+ *
+ * @license
+ * This project is licensed under the MIT License - see the LICENSE file for details.
+ **************************************************************************************************/
+
+#ifndef SCRUB_h
+#define SCRUB_h
+
+#include "CommonDefines.h"
+#include "FileTools.h"
+
+/***************************************************************************************************
+ * DEFINES
+ **************************************************************************************************/
+
+// Name of the state file inside of the directory, if no other is given.
+#define SCRUB_STATE_FILENAME    ".reed-scrub"
+
+// Hours between the scrubs of a file by default.
+#define SCRUB_DEFAULT_HOURS     (7*24)
+
+/***************************************************************************************************
+ * FUNCTIONS
+ **************************************************************************************************/
+
+// Time between the scrubs of a file.
+void setScrubInterval(long seconds);
+
+// 1 (the default) repairs the damaged files in place, 0 only reports them.
+void setScrubRepair(int repair);
+
+// Scrubs the files of [directory] that are due. The state is kept on [stateFilename] or, if it's
+// NULL, on SCRUB_STATE_FILENAME inside of the directory. Returns the worst ScanStatus of the files
+// checked.
+ScanStatus scrubDirectory(const char* directory, const char* stateFilename);
+
+#endif
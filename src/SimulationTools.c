@@ -11,6 +11,13 @@
  **************************************************************************************************/
 
 #include "SimulationTools.h"
+#include "EmbeddedCodec.h"
+#include "FileTools.h"
+#include "Instrumentation.h"
+#include "StreamCodec.h"
+#include <fcntl.h>
+#include <pthread.h>
+#include <unistd.h>
 
 /***************************************************************************************************
  * RANDOM SIMULATION
@@ -43,7 +50,7 @@ AlgorithmReturn runSimulation(int* x, int* y, int numPoints, int* errX, int* err
     
     // New errors are introduced!
     for(int i = 0; i < numErrors; i++){
-        if(EEPROM_NOT_CORRUPTED && errX[i] >= numPoints){
+        if(getParityPolicy() == PARITY_TRUSTED && errX[i] >= numPoints){
             printf("If EEPROM is not corrupted, there cannot be errors and the EEPROM side.\n");
             exit(-1);
         }
@@ -136,7 +143,7 @@ AlgorithmReturn createSimulation(int numPoints, int minErrors, int maxErrors){
     // Generate the Xs (where the errors will happen).
     if(numErrors >= 2){
         int randX[numPoints+EXTRA_POINTS];
-        if(EEPROM_NOT_CORRUPTED){
+        if(getParityPolicy() == PARITY_TRUSTED){
             for(int i = 0; i < numPoints; i++) randX[i] = i;
             shuffleArray(randX, numPoints);
         }else{
@@ -146,7 +153,7 @@ AlgorithmReturn createSimulation(int numPoints, int minErrors, int maxErrors){
         memcpy(errX, randX, sizeof(int)*numErrors);
     }else{
         for(int i = 0; i < numErrors; i++){
-            if(EEPROM_NOT_CORRUPTED){
+            if(getParityPolicy() == PARITY_TRUSTED){
                 errX[i] = generateRandom(0, numPoints - 1);
             }else{
                 errX[i] = generateRandom(0, numPoints + EXTRA_POINTS - 1);
@@ -174,6 +181,8 @@ void testBench(int totalTests, int minErrors, int maxErrors){
     printf("Points per sample       : %d\n", NUM_POINTS_SAMPLE);
     printf("Extra points per sample : %d\n", EXTRA_POINTS);
     printf("Number of errors        : rand[%d, %d]\n", minErrors, maxErrors);
+    const char* policyNames[] = {"trusted", "untrusted", "adaptive"};
+    printf("Recuperation data       : %s\n", policyNames[getParityPolicy()]);
     printf("#############  TEST BEGIN  ###############\n");
     int fixedOk = 0;
     int noErrorFound = 0;
@@ -237,6 +246,411 @@ void testBench(int totalTests, int minErrors, int maxErrors){
     printf("Average elapsed time: %lld ns\n", averageElapsed/totalTests);
     printf("Minimum elapsed time: %lld ns\n", minElapsed);
     printf("Maximum elapsed time: %lld ns\n", maxElapsed);
+    if(getParityPolicy() == PARITY_ADAPTIVE){
+        long fallbacks, fixed;
+        getParityFallbacks(&fallbacks, &fixed);
+        printf("Retried as untrusted: %ld. Fixed: %ld.\n", fallbacks, fixed);
+    }
+}
+
+/***************************************************************************************************
+ * EMBEDDED BENCHMARK
+ **************************************************************************************************/
+
+// Stack of the thread that runs the embedded codec, filled with a pattern to find how deep it got.
+#define EMBEDDED_BENCH_STACK_SIZE   (256*1024)
+#define EMBEDDED_BENCH_STACK_FILL   0xA5
+
+typedef struct{
+    EmbeddedWorkspace* ws;
+    int blocks;
+    // 1 to encode [data] into [rec], 0 to decode [data] with [rec], -1 to only run the loop.
+    int encode;
+    unsigned char* data;
+    unsigned char* rec;
+    AlgorithmReturn* results;
+    unsigned long long* cycles;
+
+    unsigned long long totalCycles;
+    unsigned long long maxCycles;
+    // Bytes of stack used below the frame of runEmbeddedBlocks().
+    long stackUsed;
+    unsigned char* stack;
+} EmbeddedBenchRun;
+
+static void* runEmbeddedBlocks(void* arg){
+    EmbeddedBenchRun* run = arg;
+    unsigned char* frame = __builtin_frame_address(0);
+
+    for(int i = 0; i < run->blocks; i++){
+        unsigned char* data = run->data + i*NUM_POINTS_SAMPLE;
+        unsigned char* rec = run->rec + i*REC_BYTES_PER_BLOCK;
+
+        unsigned long long start = readCycles();
+        AlgorithmReturn result = WITHOUT_ERRORS;
+        if(run->encode > 0)         result = embeddedEncodeBlock(run->ws, data, rec);
+        else if(run->encode == 0)   result = embeddedDecodeBlock(run->ws, data, rec, NULL);
+        unsigned long long cycles = readCycles() - start;
+
+        run->results[i] = result;
+        run->cycles[i] = cycles;
+        run->totalCycles += cycles;
+        if(cycles > run->maxCycles) run->maxCycles = cycles;
+    }
+
+    unsigned char* deepest = run->stack;
+    while(deepest < frame && *deepest == EMBEDDED_BENCH_STACK_FILL) deepest++;
+    run->stackUsed = frame - deepest;
+    return NULL;
+}
+
+// Runs [run] on a thread with a painted stack. Returns -1 if the thread couldn't be created.
+static int measureEmbeddedRun(EmbeddedBenchRun* run){
+    run->totalCycles = run->maxCycles = 0;
+    memset(run->stack, EMBEDDED_BENCH_STACK_FILL, EMBEDDED_BENCH_STACK_SIZE);
+
+    pthread_attr_t attributes;
+    pthread_t thread;
+    pthread_attr_init(&attributes);
+    pthread_attr_setstack(&attributes, run->stack, EMBEDDED_BENCH_STACK_SIZE);
+    int ret = pthread_create(&thread, &attributes, runEmbeddedBlocks, run);
+    pthread_attr_destroy(&attributes);
+    if(ret != 0) return -1;
+    pthread_join(thread, NULL);
+    return 0;
+}
+
+static int compareCycles(const void* a, const void* b){
+    unsigned long long first = *(const unsigned long long*) a;
+    unsigned long long second = *(const unsigned long long*) b;
+    return (first > second) - (first < second);
+}
+
+// The maximum includes the interruptions of the host, so the 99th percentile is also shown.
+static void printEmbeddedRun(const char* name, EmbeddedBenchRun* run, long baseStack, 
+                             int clean, int fixed, int failed){
+    qsort(run->cycles, run->blocks, sizeof(unsigned long long), compareCycles);
+    printf("%-10s %7d %7d %7d %11llu %11llu %11llu %6ld\n", name, clean, fixed, failed, 
+           run->totalCycles/run->blocks, run->cycles[run->blocks*99/100], run->maxCycles, 
+           run->stackUsed - baseStack);
+}
+
+void embeddedBenchmark(int blocksPerClass){
+    if(blocksPerClass <= 0) blocksPerClass = 1;
+    srand(time(0));
+
+    static EmbeddedWorkspace ws;
+    initEmbeddedWorkspace(&ws);
+    ParityPolicy policy = getParityPolicy();
+    ws.trustParity = policy != PARITY_UNTRUSTED;
+
+    unsigned char* original = malloc(blocksPerClass*NUM_POINTS_SAMPLE);
+    unsigned char* expected = malloc(blocksPerClass*NUM_POINTS_SAMPLE);
+    EmbeddedBenchRun run = {
+        .ws = &ws,
+        .blocks = blocksPerClass,
+        .data = malloc(blocksPerClass*NUM_POINTS_SAMPLE),
+        .rec = malloc(blocksPerClass*REC_BYTES_PER_BLOCK),
+        .results = malloc(blocksPerClass*sizeof(AlgorithmReturn)),
+        .cycles = malloc(blocksPerClass*sizeof(unsigned long long)),
+    };
+    AlgorithmReturn* expectedResults = malloc(blocksPerClass*sizeof(AlgorithmReturn));
+    unsigned char* expectedRec = malloc(blocksPerClass*REC_BYTES_PER_BLOCK);
+    if(posix_memalign((void**) &run.stack, 4096, EMBEDDED_BENCH_STACK_SIZE) != 0 || 
+       original == NULL || expected == NULL || run.data == NULL || run.rec == NULL || 
+       run.results == NULL || run.cycles == NULL || expectedResults == NULL || expectedRec == NULL){
+        perror("Error allocating the benchmark");
+        exit(-1);
+    }
+
+    const char* policyNames[] = {"trusted", "untrusted", "adaptive"};
+    printf("Embedded codec benchmark: %d blocks per class, %s recuperation data%s.\n"
+           "Workspace: %zu bytes. Cycles and stack bytes per block.\n\n"
+           "%-10s %7s %7s %7s %11s %11s %11s %6s\n", 
+           blocksPerClass, policyNames[policy], 
+           policy == PARITY_ADAPTIVE ? " (the embedded codec only as trusted)" : "",
+           sizeof(EmbeddedWorkspace), "Class", "Clean", "Fixed", "Failed", "Avg cycles", 
+           "P99 cycles", "Max cycles", "Stack");
+
+    // The stack of the benchmark loop on its own.
+    run.encode = -1;
+    if(measureEmbeddedRun(&run) < 0){
+        perror("Error creating the benchmark thread");
+        exit(-1);
+    }
+    long baseStack = run.stackUsed;
+
+    // Encoding, compared with encodeBlock().
+    long mismatches = 0;
+    for(int i = 0; i < blocksPerClass*NUM_POINTS_SAMPLE; i++) original[i] = rand() & 0xFF;
+    for(int i = 0; i < blocksPerClass; i++){
+        encodeBlock(original + i*NUM_POINTS_SAMPLE, expectedRec + i*REC_BYTES_PER_BLOCK);
+    }
+    memcpy(run.data, original, blocksPerClass*NUM_POINTS_SAMPLE);
+    run.encode = 1;
+    measureEmbeddedRun(&run);
+    mismatches += memcmp(run.rec, expectedRec, blocksPerClass*REC_BYTES_PER_BLOCK) != 0;
+    printEmbeddedRun("encode", &run, baseStack, 0, 0, 0);
+
+    // Decoding with 0, 1... errors on the data, compared with decodeBlock().
+    run.encode = 0;
+    for(int numErrors = 0; numErrors <= EXTRA_POINTS; numErrors++){
+        for(int i = 0; i < blocksPerClass; i++){
+            unsigned char* data = run.data + i*NUM_POINTS_SAMPLE;
+            memcpy(data, original + i*NUM_POINTS_SAMPLE, NUM_POINTS_SAMPLE);
+
+            int positions[NUM_POINTS_SAMPLE];
+            for(int j = 0; j < NUM_POINTS_SAMPLE; j++) positions[j] = j;
+            shuffleArray(positions, NUM_POINTS_SAMPLE);
+            for(int j = 0; j < numErrors; j++){
+                data[positions[j]] ^= generateRandom(1, 255);
+            }
+
+            memcpy(expected + i*NUM_POINTS_SAMPLE, data, NUM_POINTS_SAMPLE);
+            expectedResults[i] = decodeBlock(expected + i*NUM_POINTS_SAMPLE, 
+                                             expectedRec + i*REC_BYTES_PER_BLOCK, NULL);
+        }
+        memcpy(run.rec, expectedRec, blocksPerClass*REC_BYTES_PER_BLOCK);
+        measureEmbeddedRun(&run);
+
+        int clean = 0, fixed = 0, failed = 0;
+        for(int i = 0; i < blocksPerClass; i++){
+            clean += run.results[i] == WITHOUT_ERRORS;
+            fixed += run.results[i] == FIXED_OK;
+            failed += run.results[i] < 0;
+            // Adaptive blocks fixed by the untrusted pass of decodeBlock() don't count.
+            if(policy == PARITY_ADAPTIVE && expectedResults[i] != run.results[i])   continue;
+            mismatches += run.results[i] != expectedResults[i] ||
+                          memcmp(run.data + i*NUM_POINTS_SAMPLE, expected + i*NUM_POINTS_SAMPLE, 
+                                 NUM_POINTS_SAMPLE) != 0;
+        }
+
+        char name[16];
+        snprintf(name, sizeof(name), "%d errors", numErrors);
+        printEmbeddedRun(name, &run, baseStack, clean, fixed, failed);
+    }
+    printf("\nBlocks that differ from encodeBlock() and decodeBlock(): %ld.\n", mismatches);
+
+    free(original);
+    free(expected);
+    free(expectedResults);
+    free(expectedRec);
+    free(run.data);
+    free(run.rec);
+    free(run.results);
+    free(run.cycles);
+    free(run.stack);
+}
+
+/***************************************************************************************************
+ * STREAM CODEC TEST
+ **************************************************************************************************/
+
+// Drains a random amount of bytes of [codec] to [out], which has [produced] of [total] bytes.
+static size_t drainRandom(StreamCodec* codec, unsigned char* out, size_t produced, size_t total){
+    size_t maxLen = generateRandom(1, 2*STREAM_DATA_SIZE);
+    if(maxLen > total - produced) maxLen = total - produced;
+    return produced + streamDrain(codec, out + produced, maxLen);
+}
+
+// Feeds a random chunk of [input] starting at [fed] to the data or the parity of [codec].
+static size_t feedRandom(StreamCodec* codec, const unsigned char* input, size_t fed, size_t total, 
+                         int parity){
+    size_t len = generateRandom(0, 3*STREAM_DATA_SIZE);
+    if(len > total - fed) len = total - fed;
+    return fed + (parity ? streamFeedParity(codec, input + fed, len) : 
+                           streamFeed(codec, input + fed, len));
+}
+
+// Runs [codec] on [data] (and [rec], when decoding) fed and drained in chunks of random sizes. 
+// Returns the number of bytes written to [out].
+static size_t runStream(StreamCodec* codec, const unsigned char* data, size_t dataLength, 
+                        const unsigned char* rec, size_t recLength, unsigned char* out, 
+                        size_t outLength){
+    size_t dataFed = 0, recFed = 0, produced = 0;
+    while(dataFed < dataLength || (codec->mode == STREAM_DECODER && recFed < recLength)){
+        if(codec->mode == STREAM_DECODER && rand() % 2) {
+            recFed = feedRandom(codec, rec, recFed, recLength, 1);
+        }else{
+            dataFed = feedRandom(codec, data, dataFed, dataLength, 0);
+        }
+        produced = drainRandom(codec, out, produced, outLength);
+    }
+    streamFinish(codec);
+    // A misaligned stream is never done, but it stops giving bytes.
+    size_t previous;
+    do{
+        previous = produced;
+        produced = drainRandom(codec, out, produced, outLength);
+    }while(!streamDone(codec) && produced != previous);
+    return produced;
+}
+
+// Reads the whole [filename] into [buffer] of [length] bytes. Returns the size of the file.
+static long readWholeFile(const char* filename, unsigned char* buffer, long length){
+    FILE* file = fopen(filename, "rb");
+    if(file == NULL) return -1;
+    long size = fread(buffer, 1, length, file);
+    while(fgetc(file) != EOF) size++;
+    fclose(file);
+    return size;
+}
+
+// Sends the standard output to /dev/null while [mute] is 1, so the logs of -e and -v don't get 
+// mixed with the results.
+static void muteStdout(int mute){
+    static int savedStdout = -1;
+    fflush(stdout);
+    if(mute){
+        int null = open("/dev/null", O_WRONLY);
+        savedStdout = dup(STDOUT_FILENO);
+        if(null >= 0) dup2(null, STDOUT_FILENO);
+        if(null >= 0) close(null);
+    }else if(savedStdout >= 0){
+        dup2(savedStdout, STDOUT_FILENO);
+        close(savedStdout);
+        savedStdout = -1;
+    }
+}
+
+static void writeWholeFile(const char* filename, const unsigned char* buffer, long length){
+    FILE* file = fopen(filename, "wb");
+    if(file == NULL || (long) fwrite(buffer, 1, length, file) != length || fclose(file) != 0){
+        printf("File %s. ", filename);
+        fflush(stdout);
+        perror("Error writing the test file");
+        exit(-1);
+    }
+}
+
+int streamTest(int blocks){
+    if(blocks <= 0) blocks = 1;
+    srand(time(0));
+
+    char directory[] = "/tmp/reed-stream-XXXXXX";
+    if(mkdtemp(directory) == NULL){
+        perror("Error creating the test directory");
+        exit(-1);
+    }
+    char dataFilename[sizeof(directory) + 16], recFilename[sizeof(directory) + 16];
+    char outFilename[sizeof(directory) + 16];
+    sprintf(dataFilename, "%s/data", directory);
+    sprintf(recFilename, "%s/data.rec", directory);
+    sprintf(outFilename, "%s/fixed", directory);
+
+    // Room for a block more than the longest case, to catch the outputs that are too long.
+    long maxLength = (long) blocks*NUM_POINTS_SAMPLE;
+    long maxRecLength = (long) (blocks + 1)*REC_BYTES_PER_BLOCK;
+    unsigned char* original = malloc(maxLength);
+    unsigned char* damaged = malloc(maxLength);
+    unsigned char* expected = malloc(maxLength);
+    unsigned char* expectedRec = malloc(maxRecLength);
+    unsigned char* out = malloc(maxLength + NUM_POINTS_SAMPLE);
+    unsigned char* fileOut = malloc(maxLength + maxRecLength);
+    if(original == NULL || damaged == NULL || expected == NULL || expectedRec == NULL || 
+       out == NULL || fileOut == NULL){
+        perror("Error allocating the test");
+        exit(-1);
+    }
+
+    static StreamCodec codec;
+    long totalMismatches = 0;
+    printf("Stream codec test: %d blocks, fed and drained in chunks of random sizes.\n"
+           "Mismatches with encodeBlock(), decodeBlock(), -e and -v, and misaligned streams "
+           "detected.\n\n%-6s %7s %7s %7s %7s %7s %7s %10s\n", blocks, "Tail", "Encode", "Decode", 
+           "-e", "-v", "Fixed", "Failed", "Misaligned");
+
+    // The last block has from 0 (complete) to NUM_POINTS_SAMPLE - 1 bytes missing.
+    for(int tail = 0; tail < NUM_POINTS_SAMPLE; tail++){
+        long length = maxLength - tail;
+        long numBlocks = blocks;
+        long recLength = numBlocks*REC_BYTES_PER_BLOCK;
+        for(long i = 0; i < length; i++) original[i] = rand() & 0xFF;
+
+        // What encodeBlock() and decodeBlock() give, with the last block padded.
+        long fixed = 0, failed = 0;
+        for(long i = 0; i < numBlocks; i++){
+            long blockLength = length - i*NUM_POINTS_SAMPLE < NUM_POINTS_SAMPLE ? 
+                               length - i*NUM_POINTS_SAMPLE : NUM_POINTS_SAMPLE;
+            unsigned char block[NUM_POINTS_SAMPLE];
+            memset(block, PADDING_BYTE, NUM_POINTS_SAMPLE);
+            memcpy(block, original + i*NUM_POINTS_SAMPLE, blockLength);
+            encodeBlock(block, expectedRec + i*REC_BYTES_PER_BLOCK);
+
+            // From 0 to EXTRA_POINTS + 1 errors, only on the bytes of the data.
+            int positions[NUM_POINTS_SAMPLE];
+            for(int j = 0; j < NUM_POINTS_SAMPLE; j++) positions[j] = j;
+            shuffleArray(positions, blockLength);
+            int numErrors = generateRandom(0, EXTRA_POINTS + 1);
+            if(numErrors > blockLength) numErrors = blockLength;
+            for(int j = 0; j < numErrors; j++) block[positions[j]] ^= generateRandom(1, 255);
+            memcpy(damaged + i*NUM_POINTS_SAMPLE, block, blockLength);
+
+            AlgorithmReturn ret = decodeBlock(block, expectedRec + i*REC_BYTES_PER_BLOCK, NULL);
+            fixed += ret == FIXED_OK;
+            failed += ret < 0;
+            memcpy(expected + i*NUM_POINTS_SAMPLE, block, blockLength);
+        }
+
+        // Encoding.
+        streamInit(&codec, STREAM_ENCODER);
+        size_t produced = runStream(&codec, original, length, NULL, 0, out, maxRecLength);
+        int encodeMismatch = produced != (size_t) recLength || 
+                             memcmp(out, expectedRec, recLength) != 0;
+
+        // Decoding.
+        streamInit(&codec, STREAM_DECODER);
+        produced = runStream(&codec, damaged, length, expectedRec, recLength, out, 
+                             maxLength + NUM_POINTS_SAMPLE);
+        int decodeMismatch = produced != (size_t) length || memcmp(out, expected, length) != 0 ||
+                             codec.blocksFixed != fixed || codec.blocksFailed != failed || 
+                             streamMisaligned(&codec);
+
+        // The same files through -e and -v.
+        writeWholeFile(dataFilename, original, length);
+        muteStdout(1);
+        createRecuperationFile(dataFilename, recFilename);
+        muteStdout(0);
+        int fileEncodeMismatch = readWholeFile(recFilename, fileOut, maxRecLength) != recLength ||
+                                 memcmp(fileOut, expectedRec, recLength) != 0;
+        writeWholeFile(dataFilename, damaged, length);
+        muteStdout(1);
+        recuperateFile(dataFilename, recFilename, outFilename);
+        muteStdout(0);
+        int fileDecodeMismatch = readWholeFile(outFilename, fileOut, maxLength) != length ||
+                                 memcmp(fileOut, out, length) != 0;
+
+        // A block without its recuperation data and recuperation data without its block.
+        int misaligned = 0;
+        streamInit(&codec, STREAM_DECODER);
+        runStream(&codec, damaged, length, expectedRec, recLength - REC_BYTES_PER_BLOCK, out, 
+                  maxLength + NUM_POINTS_SAMPLE);
+        misaligned += streamMisaligned(&codec);
+        streamInit(&codec, STREAM_DECODER);
+        memcpy(expectedRec + recLength, expectedRec, REC_BYTES_PER_BLOCK);
+        runStream(&codec, damaged, length, expectedRec, recLength + REC_BYTES_PER_BLOCK, out, 
+                  maxLength + NUM_POINTS_SAMPLE);
+        misaligned += streamMisaligned(&codec);
+
+        totalMismatches += encodeMismatch + decodeMismatch + fileEncodeMismatch + 
+                           fileDecodeMismatch + (misaligned != 2);
+        printf("%-6d %7d %7d %7d %7d %7ld %7ld %8d/2\n", tail, encodeMismatch, decodeMismatch, 
+               fileEncodeMismatch, fileDecodeMismatch, fixed, failed, misaligned);
+    }
+    printf("\nStream codec test %s: %ld mismatches.\n", totalMismatches ? "FAILED" : "passed", 
+           totalMismatches);
+
+    remove(dataFilename);
+    remove(recFilename);
+    remove(outFilename);
+    rmdir(directory);
+    free(original);
+    free(damaged);
+    free(expected);
+    free(expectedRec);
+    free(out);
+    free(fileOut);
+    return totalMismatches != 0;
 }
 
 /***************************************************************************************************
@@ -25,6 +25,18 @@
 // that the algorithm will try to fix.
 void testBench(int totalTests, int minErrors, int maxErrors);
 
+// Measures the cycles and the stack used by the embedded codec (see EmbeddedCodec.h) on 
+// [blocksPerClass] random blocks with 0, 1, 2... errors on their data, and checks that it gives the 
+// same results as encodeBlock() and decodeBlock().
+void embeddedBenchmark(int blocksPerClass);
+
+// Checks the stream codec (see StreamCodec.h) on [blocks] random blocks, fed and drained in chunks 
+// of random sizes and with every length of the last block. Its output is compared with 
+// encodeBlock() and decodeBlock() and with the files written by createRecuperationFile() and 
+// recuperateFile(), and the misaligned streams have to be detected. Returns 0 if everything 
+// matches and 1 otherwise.
+int streamTest(int blocks);
+
 // Runs a single case hardcoded in this function.
 int testCase();
 
@@ -0,0 +1,153 @@
+/***************************************************************************************************
+ * @file StreamCodec.c
+ * @brief Push-style encoder and decoder that work on data chunks of any size.
+ *
+ * @version   1.0
+ * @date      2024-07-23
+ * @author    @dabecart
+ *
+ * @license
+ * This project is licensed under the MIT License - see the LICENSE file for details.
+ **************************************************************************************************/
+
+#include "StreamCodec.h"
+
+/***************************************************************************************************
+ * RING BUFFERS
+ **************************************************************************************************/
+
+// Pushes as many bytes of [data] as they fit. Returns the number of bytes pushed.
+static size_t ringPush(unsigned char* ring, size_t capacity, RingIndex* index, 
+                       const unsigned char* data, size_t len){
+    size_t free = capacity - index->length;
+    if(len > free) len = free;
+
+    size_t end = (index->start + index->length) % capacity;
+    size_t first = capacity - end;
+    if(first > len) first = len;
+    memcpy(ring + end, data, first);
+    memcpy(ring, data + first, len - first);
+
+    index->length += len;
+    return len;
+}
+
+// Pops up to [len] bytes into [out]. Returns the number of bytes popped.
+static size_t ringPop(unsigned char* ring, size_t capacity, RingIndex* index, 
+                      unsigned char* out, size_t len){
+    if(len > index->length) len = index->length;
+
+    size_t first = capacity - index->start;
+    if(first > len) first = len;
+    memcpy(out, ring + index->start, first);
+    memcpy(out + first, ring, len - first);
+
+    index->start = (index->start + len) % capacity;
+    index->length -= len;
+    return len;
+}
+
+/***************************************************************************************************
+ * PROCESSING
+ **************************************************************************************************/
+
+// Processes all the blocks that are complete (or the last one if the stream is finished) as long as
+// there is room for their output.
+static void processBlocks(StreamCodec* codec){
+    size_t outputSize = codec->mode == STREAM_ENCODER ? REC_BYTES_PER_BLOCK : NUM_POINTS_SAMPLE;
+
+    while(codec->dataIndex.length >= NUM_POINTS_SAMPLE || 
+          (codec->finished && codec->dataIndex.length > 0)){
+        if(STREAM_DATA_SIZE - codec->outputIndex.length < outputSize) return;
+        if(codec->mode == STREAM_DECODER && codec->parityIndex.length < REC_BYTES_PER_BLOCK) return;
+
+        unsigned char block[NUM_POINTS_SAMPLE];
+        size_t blockLength = ringPop(codec->data, STREAM_DATA_SIZE, &codec->dataIndex, 
+                                     block, NUM_POINTS_SAMPLE);
+        memset(block + blockLength, PADDING_BYTE, NUM_POINTS_SAMPLE - blockLength);
+
+        unsigned char rec[REC_BYTES_PER_BLOCK];
+        if(codec->mode == STREAM_ENCODER){
+            encodeBlock(block, rec);
+            ringPush(codec->output, STREAM_DATA_SIZE, &codec->outputIndex, 
+                     rec, REC_BYTES_PER_BLOCK);
+        }else{
+            ringPop(codec->parity, STREAM_PARITY_SIZE, &codec->parityIndex, 
+                    rec, REC_BYTES_PER_BLOCK);
+
+            AlgorithmReturn ret = decodeBlock(block, rec, NULL);
+            codec->blocksFixed += ret == FIXED_OK;
+            codec->blocksFailed += ret < 0;
+
+            // The padding of the last block is not part of the output.
+            ringPush(codec->output, STREAM_DATA_SIZE, &codec->outputIndex, block, blockLength);
+        }
+        codec->blocks++;
+    }
+}
+
+/***************************************************************************************************
+ * FUNCTIONS
+ **************************************************************************************************/
+
+void streamInit(StreamCodec* codec, StreamMode mode){
+    memset(codec, 0, sizeof(StreamCodec));
+    codec->mode = mode;
+}
+
+size_t streamFeed(StreamCodec* codec, const unsigned char* data, size_t len){
+    if(codec->finished) return 0;
+
+    size_t consumed = 0;
+    while(consumed < len){
+        size_t pushed = ringPush(codec->data, STREAM_DATA_SIZE, &codec->dataIndex, 
+                                 data + consumed, len - consumed);
+        processBlocks(codec);
+        if(pushed == 0) break;
+        consumed += pushed;
+    }
+    return consumed;
+}
+
+size_t streamFeedParity(StreamCodec* codec, const unsigned char* buf, size_t len){
+    if(codec->mode != STREAM_DECODER || codec->finished) return 0;
+
+    size_t consumed = 0;
+    while(consumed < len){
+        size_t pushed = ringPush(codec->parity, STREAM_PARITY_SIZE, &codec->parityIndex, 
+                                 buf + consumed, len - consumed);
+        processBlocks(codec);
+        if(pushed == 0) break;
+        consumed += pushed;
+    }
+    return consumed;
+}
+
+size_t streamDrain(StreamCodec* codec, unsigned char* out, size_t maxLen){
+    size_t drained = 0;
+    while(drained < maxLen){
+        size_t popped = ringPop(codec->output, STREAM_DATA_SIZE, &codec->outputIndex, 
+                                out + drained, maxLen - drained);
+        // Room was made in the output, so the blocks that were waiting can be processed.
+        processBlocks(codec);
+        if(popped == 0) break;
+        drained += popped;
+    }
+    return drained;
+}
+
+void streamFinish(StreamCodec* codec){
+    codec->finished = 1;
+    processBlocks(codec);
+}
+
+int streamDone(const StreamCodec* codec){
+    return codec->finished && codec->dataIndex.length == 0 && codec->outputIndex.length == 0;
+}
+
+int streamMisaligned(const StreamCodec* codec){
+    if(!codec->finished || codec->mode != STREAM_DECODER) return 0;
+    // Either a block is missing its recuperation data or there is recuperation data left over.
+    return (codec->dataIndex.length > 0 && codec->parityIndex.length < REC_BYTES_PER_BLOCK) ||
+           (codec->dataIndex.length == 0 && codec->parityIndex.length > 0);
+}
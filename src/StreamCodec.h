@@ -0,0 +1,100 @@
+/***************************************************************************************************
+ * @file StreamCodec.h
+ * @brief Push-style encoder and decoder that work on data chunks of any size.
+ *
+ * The caller feeds the data (and, when decoding, the recuperation data) as it arrives and drains 
+ * the result whenever it wants to. All the memory lives inside the StreamCodec, so no call ever 
+ * allocates or blocks. If the internal buffers are full, the feed functions consume less bytes than
+ * given and the caller has to drain the output before feeding the rest.
+ *
+ * @version   1.0
+ * @date      2024-07-23
+ * @author    @dabecart
+ *
+ * @license
+ * This project is licensed under the MIT License - see the LICENSE file for details.
+ **************************************************************************************************/
+
+#ifndef STREAM_CODEC_h
+#define STREAM_CODEC_h
+
+#include "CommonDefines.h"
+#include "ReedSolomon.h"
+
+/***************************************************************************************************
+ * DEFINES
+ **************************************************************************************************/
+
+// Number of blocks each of the internal buffers can hold.
+#define STREAM_BUFFER_BLOCKS    64
+
+#define STREAM_DATA_SIZE        (STREAM_BUFFER_BLOCKS*NUM_POINTS_SAMPLE)
+#define STREAM_PARITY_SIZE      (STREAM_BUFFER_BLOCKS*REC_BYTES_PER_BLOCK)
+
+/***************************************************************************************************
+ * TYPES
+ **************************************************************************************************/
+
+typedef enum{
+    // Takes data and outputs its recuperation data.
+    STREAM_ENCODER,
+
+    // Takes data and its recuperation data and outputs the fixed data.
+    STREAM_DECODER,
+} StreamMode;
+
+// Position of the bytes stored in a ring buffer.
+typedef struct{
+    size_t start;
+    size_t length;
+} RingIndex;
+
+typedef struct{
+    StreamMode mode;
+    int finished;
+
+    // Input data, waiting to fill a block.
+    unsigned char data[STREAM_DATA_SIZE];
+    RingIndex dataIndex;
+
+    // Recuperation data waiting for its block (only for the decoder).
+    unsigned char parity[STREAM_PARITY_SIZE];
+    RingIndex parityIndex;
+
+    // Processed bytes waiting to be drained.
+    unsigned char output[STREAM_DATA_SIZE];
+    RingIndex outputIndex;
+
+    // Statistics.
+    long blocks;
+    long blocksFixed;
+    long blocksFailed;
+} StreamCodec;
+
+/***************************************************************************************************
+ * FUNCTIONS
+ **************************************************************************************************/
+
+void streamInit(StreamCodec* codec, StreamMode mode);
+
+// Feeds [len] bytes of data. Returns how many of them were consumed.
+size_t streamFeed(StreamCodec* codec, const unsigned char* data, size_t len);
+
+// Feeds [len] bytes of recuperation data to a decoder. Returns how many of them were consumed.
+size_t streamFeedParity(StreamCodec* codec, const unsigned char* buf, size_t len);
+
+// Copies up to [maxLen] processed bytes to [out]. Returns how many bytes were copied.
+size_t streamDrain(StreamCodec* codec, unsigned char* out, size_t maxLen);
+
+// Tells the codec that there is no more input, so the last block can be processed even if it's not
+// complete. The padding of the last block is not part of the decoder's output.
+void streamFinish(StreamCodec* codec);
+
+// After streamFinish(), returns 1 once every byte has been processed and drained.
+int streamDone(const StreamCodec* codec);
+
+// After streamFinish(), returns 1 if the data and the recuperation data don't have the same number
+// of blocks.
+int streamMisaligned(const StreamCodec* codec);
+
+#endif //STREAM_CODEC_h
@@ -0,0 +1,98 @@
+/***************************************************************************************************
+ * @file Throttle.c
+ * @brief Limits the bandwidth and CPU of the background jobs, so they don't disturb the rest.
+ *
+ * @version   1.0
+ * @date      2024-07-23
+ * @author    @dabecart
+ *
+ * @license
+ * This project is licensed under the MIT License - see the LICENSE file for details.
+ **************************************************************************************************/
+
+// Needed for syscall().
+#define _GNU_SOURCE
+
+#include "Throttle.h"
+#include <errno.h>
+#include <sys/resource.h>
+#include <sys/syscall.h>
+#include <time.h>
+#include <unistd.h>
+
+// Linux's I/O priorities (see ioprio_set(2)), which libc doesn't wrap.
+#define IOPRIO_CLASS_IDLE       3
+#define IOPRIO_CLASS_SHIFT      13
+#define IOPRIO_WHO_PROCESS      1
+
+/***************************************************************************************************
+ * STATE
+ **************************************************************************************************/
+
+static long rateLimit = 0;
+static int cpuLimit = 0;
+
+// Bytes that can be read right now. It goes negative when a read takes more than there are.
+static double tokens = 0;
+static struct timespec lastRefill;
+
+// Start of the duty cycle of the CPU.
+static struct timespec wallStart;
+static struct timespec cpuStart;
+
+static double secondsBetween(const struct timespec* start, const struct timespec* end){
+    return (end->tv_sec - start->tv_sec) + (end->tv_nsec - start->tv_nsec)/1e9;
+}
+
+static void sleepSeconds(double seconds){
+    struct timespec time = {.tv_sec = (time_t) seconds};
+    time.tv_nsec = (long) ((seconds - time.tv_sec)*1e9);
+    while(nanosleep(&time, &time) < 0 && errno == EINTR);
+}
+
+/***************************************************************************************************
+ * FUNCTIONS
+ **************************************************************************************************/
+
+void setThrottle(long bytesPerSecond, int cpuPercent){
+    rateLimit = bytesPerSecond > 0 ? bytesPerSecond : 0;
+    cpuLimit = (cpuPercent > 0 && cpuPercent < 100) ? cpuPercent : 0;
+
+    // The bucket starts full.
+    tokens = rateLimit;
+    clock_gettime(CLOCK_MONOTONIC, &lastRefill);
+    wallStart = lastRefill;
+    clock_gettime(CLOCK_PROCESS_CPUTIME_ID, &cpuStart);
+}
+
+void throttleRead(long bytes){
+    struct timespec now;
+    if(rateLimit > 0){
+        clock_gettime(CLOCK_MONOTONIC, &now);
+        tokens += secondsBetween(&lastRefill, &now)*rateLimit;
+        if(tokens > rateLimit) tokens = rateLimit;
+        lastRefill = now;
+
+        // The debt is paid sleeping, the refill of the next call accounts for it.
+        tokens -= bytes;
+        if(tokens < 0) sleepSeconds(-tokens/rateLimit);
+    }
+
+    if(cpuLimit > 0){
+        struct timespec cpu;
+        clock_gettime(CLOCK_MONOTONIC, &now);
+        clock_gettime(CLOCK_PROCESS_CPUTIME_ID, &cpu);
+        double wall = secondsBetween(&wallStart, &now);
+        double used = secondsBetween(&cpuStart, &cpu);
+        double allowedWall = used*100/cpuLimit;
+        if(allowedWall > wall) sleepSeconds(allowedWall - wall);
+    }
+}
+
+void lowerPriority(){
+    // Both are best effort: the job runs the same without them.
+    setpriority(PRIO_PROCESS, 0, 19);
+#if defined(__linux__) && defined(SYS_ioprio_set)
+    syscall(SYS_ioprio_set, IOPRIO_WHO_PROCESS, 0, IOPRIO_CLASS_IDLE << IOPRIO_CLASS_SHIFT);
+#endif
+}
@@ -0,0 +1,41 @@
+/***************************************************************************************************
+ * @file Throttle.h
+ * @brief Limits the bandwidth and CPU of the background jobs, so they don't disturb the rest.
+ *
+ * The reads are paced with a token bucket: it fills at the allowed rate up to a second's worth of
+ * bytes, and a read that takes more tokens than there are sleeps until they're refilled. The CPU
+ * is limited with a duty cycle: if the process used more than its share of the time since the
+ * throttle was started, it sleeps until it's back under it.
+ *
+ * throttleRead() does nothing until setThrottle() is called, so the tools that read files can call
+ * it always. It's meant for a single thread (the scrub, see Scrub.h).
+ *
+ * @version   1.0
+ * @date      2024-07-23
+ * @author    @dabecart
+ *
+ * @license
+ * This project is licensed under the MIT License - see the LICENSE file for details.
+ **************************************************************************************************/
+
+#ifndef THROTTLE_h
+#define THROTTLE_h
+
+#include "CommonDefines.h"
+
+/***************************************************************************************************
+ * FUNCTIONS
+ **************************************************************************************************/
+
+// Limits the reads to [bytesPerSecond] and the CPU to [cpuPercent]% of a core. 0 leaves either of
+// them unlimited.
+void setThrottle(long bytesPerSecond, int cpuPercent);
+
+// Called before reading [bytes] bytes. Sleeps as long as needed to stay under the limits.
+void throttleRead(long bytes);
+
+// Lowers the CPU and I/O priority of the process to the minimum (like nice 19 and ionice -c3), so
+// it only gets the time the rest of the system doesn't use.
+void lowerPriority();
+
+#endif
@@ -12,16 +12,38 @@
 
 #include "SimulationTools.h"
 #include "FileTools.h"
+#include "Checkpoint.h"
+#include "Checksum.h"
+#include "Instrumentation.h"
+#include "ColumnParity.h"
+#include "Interleave.h"
+#include "Merkle.h"
+#include "Scrub.h"
+#include "Throttle.h"
 
 #define DEFAULT_TOTAL_TESTS 10000
 #define DEFAULT_MIN_ERRORS  0
 #define DEFAULT_MAX_ERRORS  EXTRA_POINTS
+#define DEFAULT_EMBEDDED_BLOCKS 10000
+#define DEFAULT_STREAM_BLOCKS   10000
 #define DEFAULT_OUT_ENCODE  "encode.out"
 #define DEFAULT_OUT_VERIFY  "fixed.out"
+#define MAX_RANGES          64
 
 void print_help(const char* programName){
-    printf("Usage: %s [-h] [-t <TOTAL> <MIN> <MAX>] [-e <FILE> <OUTPUT>] -v <DATA> <REC> <OUTPUT>\n\n", 
-            programName);
+    printf("Usage: %s [-h] [--stats] [-p <POLICY>] [-t <TOTAL> <MIN> <MAX>]\n"
+           "       %s [-c <ENTRIES>] [-m [<BLOCKS>]] [-i <DEPTH>] [-k [<GROUP> <PARITY>]] [--checkpoint <FILE> [<SECONDS>] [--resume]] -e <FILE> [<OUTPUT>]\n"
+           "       %s [-p <POLICY>] [-b <COMBINATIONS>] [-r <OFFSET> <LENGTH>] [--second-read <FILE>] [--report <FILE>] [--checkpoint <FILE> [<SECONDS>] [--resume]] -v <DATA> <REC> [<OUTPUT>]\n"
+           "       %s [-p <POLICY>] -s <DATA> <REC> [--json]\n"
+           "       %s [-r <OFFSET> <LENGTH>]... -u <DATA> <REC> [<OLD>]\n"
+           "       %s [-p <POLICY>] [--rate <MB/S>] [--cpu <PERCENT>] [--every <HOURS>] [--no-repair] --scrub <DIR> [<STATE>]\n"
+           "       %s [-m [<BLOCKS>]] [-i <DEPTH>] [-k [<GROUP> <PARITY>]] --batch-encode <LIST|DIR> <RESULTS>\n"
+           "       %s [-p <POLICY>] --batch-verify <LIST|DIR> <RESULTS>\n"
+           "       %s [--no-accel] -x <FILE> [<CRC32C>]\n"
+           "       %s [-p <POLICY>] --embedded-bench [<BLOCKS>]\n"
+           "       %s [-p <POLICY>] --stream-test [<BLOCKS>]\n\n", 
+            programName, programName, programName, programName, programName, programName, 
+            programName, programName, programName, programName, programName);
 
     printf("This program error proofs files with an error correction algorithm based on the\n"
            "Reed-Salomon's algorithm. You may use this as a tesbench for the algorithm with [-t]\n"
@@ -37,6 +59,18 @@ void print_help(const char* programName){
            "                          a minimum of <MIN> errors and a maximum of <MAX> errors.\n"
            "                          By default, it runs a <TOTAL> of %d times, with an error\n"
            "                          count of rand(<MIN> = %d,  <MAX> = %d).\n\n"
+
+           "  --embedded-bench [<BLOCKS>]\n"
+           "                          Run the embedded codec (EmbeddedCodec.h) on <BLOCKS> random\n"
+           "                          blocks (by default: %d) per number of errors, and print the\n"
+           "                          cycles and stack bytes it needed. It also checks that it\n"
+           "                          gives the same results as -e and -v.\n\n"
+
+           "  --stream-test [<BLOCKS>]\n"
+           "                          Check the stream codec (StreamCodec.h) on <BLOCKS> random\n"
+           "                          blocks (by default: %d) with every length of the last block,\n"
+           "                          fed in chunks of random sizes, against -e and -v. The exit\n"
+           "                          status is 0 if everything matches and 1 if not.\n\n"
            
            "  -e <FILE> [<OUTPUT>]  --encode <FILE> [<OUTPUT>]\n"
            "                          Create the recuperation file for a given <FILE>. You may \n"
@@ -44,9 +78,135 @@ void print_help(const char* programName){
 
            "  -v <DATA> <REC> [<OUTPUT>]  --verify <DATA> <REC> [<OUTPUT>]\n"
            "                          Recuperate a <DATA> file using the <REC>uperation file. You\n"
-           "                          may also specify the <OUTPUT> file (by default: %s).\n",
-           DEFAULT_TOTAL_TESTS, DEFAULT_MIN_ERRORS, DEFAULT_MAX_ERRORS, 
-           DEFAULT_OUT_ENCODE, DEFAULT_OUT_VERIFY);
+           "                          may also specify the <OUTPUT> file (by default: %s).\n\n"
+
+           "                          With -e and -v, any file can be \"-\" to use the standard\n"
+           "                          input or output instead, so they can be used on pipes.\n\n"
+
+           "  -u <DATA> <REC> [<OLD>]  --update <DATA> <REC> [<OLD>]\n"
+           "                          Update the <REC>uperation file after changing part of <DATA>.\n"
+           "                          Only the blocks that differ from the <OLD> data, or the ones \n"
+           "                          inside of the -r ranges, are encoded again.\n\n"
+
+           "  -r <OFFSET> <LENGTH>  --range <OFFSET> <LENGTH>\n"
+           "                          Use before -v. Only recuperate the <LENGTH> bytes starting at\n"
+           "                          <OFFSET> (decimal or 0x hexadecimal). The <OUTPUT> file only\n"
+           "                          contains that range, so only one can be given. Before -u, it\n"
+           "                          can be repeated to list the ranges that changed.\n\n"
+
+           "  -c <ENTRIES>  --cache <ENTRIES>\n"
+           "                          Use before -e. Keeps the recuperation data of up to <ENTRIES>\n"
+           "                          blocks per thread, so repeated blocks aren't encoded again.\n\n"
+
+           "  -m [<BLOCKS>]  --merkle [<BLOCKS>]\n"
+           "                          Use before -e. Appends an integrity index to the recuperation\n"
+           "                          file: a hash tree over regions of <BLOCKS> blocks (by default:\n"
+           "                          %d). -v and -s then only verify the regions that changed.\n\n"
+
+           "  -i <DEPTH>  --interleave <DEPTH>\n"
+           "                          Use before -e. Spreads the bytes of every block over groups of\n"
+           "                          <DEPTH> blocks (up to %d), so a burst of up to <DEPTH> bytes\n"
+           "                          only damages one byte of each block. The depth is saved on the\n"
+           "                          recuperation file; also use it before -v if it's a stream.\n\n"
+
+           "  -k [<GROUP> <PARITY>]  --columns [<GROUP> <PARITY>]\n"
+           "                          Use before -e. Adds <PARITY> parity blocks (up to %d) for\n"
+           "                          every <GROUP> blocks (by default: %d and %d) to recuperate\n"
+           "                          the blocks that -v can't fix, up to <PARITY> per group. It's\n"
+           "                          not used if the recuperation file is a stream.\n\n"
+
+           "  -p <POLICY>  --parity <POLICY>\n"
+           "                          Use before -t, -v or -s. How much the recuperation data is\n"
+           "                          trusted: \"trusted\", \"untrusted\" or \"adaptive\" (trusted\n"
+           "                          first, untrusted only for the blocks that fail). By default:\n"
+           "                          %s.\n\n"
+
+           "  -b <COMBINATIONS>  --budget <COMBINATIONS>\n"
+           "                          Use before -v. Blocks that need to check more than\n"
+           "                          <COMBINATIONS> combinations of points are left for the end,\n"
+           "                          so they don't stall the rest of the file.\n\n"
+
+           "  --second-read <FILE>\n"
+           "                          Use before -v. <FILE> is the same data read again (e.g. with\n"
+           "                          a read retry of the flash). The bytes that differ between\n"
+           "                          both reads are taken as the least reliable, so the fixes that\n"
+           "                          change them are tried first.\n\n"
+
+           "  --report <FILE>  --report-binary <FILE>\n"
+           "                          Use before -v. Writes a report of the recuperation to <FILE>\n"
+           "                          as JSON (or binary): the outcome of every block, the damaged\n"
+           "                          ranges, histograms of errors and decoding times, and the\n"
+           "                          throughput.\n\n"
+
+           "  --checkpoint <FILE> [<SECONDS>]\n"
+           "                          Use before -e or -v. Every <SECONDS> seconds (by default: %d)\n"
+           "                          the output is flushed to the disk and the progress is saved on\n"
+           "                          <FILE>, which is removed when the job ends. It needs files, not\n"
+           "                          streams, and it can't be used with --report.\n\n"
+
+           "  --resume\n"
+           "                          Use after --checkpoint. Continues the job from its checkpoint,\n"
+           "                          if there's one, giving the same output as an uninterrupted run.\n"
+           "                          The same files and options have to be given.\n\n"
+
+           "  -s <DATA> <REC> [--json]  --scan <DATA> <REC> [--json]\n"
+           "                          Check a <DATA> file against its <REC>uperation file without\n"
+           "                          writing anything. Prints the damaged block ranges with their\n"
+           "                          estimated errors (as JSON with --json). Exit status: 0 if\n"
+           "                          clean, 1 if repairable, 2 if unrepairable, 3 if misaligned.\n\n"
+
+           "  --scrub <DIR> [<STATE>]\n"
+           "                          Scan every pair of data and recuperation files of <DIR> and\n"
+           "                          its subdirectories (DATA and DATA.rec, or firmware.bin and\n"
+           "                          firmware.rec) and repair the damaged blocks in place. The last\n"
+           "                          scrub of every file is kept on <STATE> (by default: <DIR>/%s),\n"
+           "                          so every run only checks the files that are due. It runs with\n"
+           "                          the lowest CPU and I/O priority. The exit status is the worst\n"
+           "                          of -s.\n\n"
+
+           "  --rate <MB/S>  --cpu <PERCENT>\n"
+           "                          Use before --scrub. Limit the reads to <MB/S> megabytes per\n"
+           "                          second and the CPU to <PERCENT>%% of a core.\n\n"
+
+           "  --every <HOURS>\n"
+           "                          Use before --scrub. Hours between the scrubs of a file (by\n"
+           "                          default: %d). Files that changed are always due.\n\n"
+
+           "  --no-repair\n"
+           "                          Use before --scrub. Only report the damaged files.\n\n"
+
+           "  --batch-encode <LIST|DIR> <RESULTS>\n"
+           "                          Encode every file of <DIR> and its subdirectories, or every\n"
+           "                          file of <LIST> (one per line), to FILE.rec with a pool of\n"
+           "                          threads. The status, sizes, CRC32C of the recuperation file\n"
+           "                          and time of every file are written to <RESULTS>.\n\n"
+
+           "  --batch-verify <LIST|DIR> <RESULTS>\n"
+           "                          Check every file like -s, with a pool of threads. <LIST> can\n"
+           "                          be the <RESULTS> of a --batch-encode, then the recuperation\n"
+           "                          files that changed since are counted. The exit status is the\n"
+           "                          worst of -s.\n\n"
+
+           "  -x <FILE> [<CRC32C>]  --checksum <FILE> [<CRC32C>]\n"
+           "                          Print the CRC32C and CRC-16 of the whole <FILE>. If the\n"
+           "                          expected <CRC32C> is given (hexadecimal), the exit status is\n"
+           "                          0 if it matches and 1 if it doesn't.\n\n"
+
+           "  --stats\n"
+           "                          Use before any action. When it ends, prints what the codec\n"
+           "                          did (interpolations, combinations, Hamming hits...) on the\n"
+           "                          error output. Needs a build with make INSTRUMENT=1 (or 2 to\n"
+           "                          also time it).\n\n"
+
+           "  --no-accel\n"
+           "                          Compute the checksums without the CRC instructions of the\n"
+           "                          CPU (PCLMULQDQ and SSE4.2), even if it has them.\n",
+           DEFAULT_TOTAL_TESTS, DEFAULT_MIN_ERRORS, DEFAULT_MAX_ERRORS, DEFAULT_EMBEDDED_BLOCKS,
+           DEFAULT_STREAM_BLOCKS,
+           DEFAULT_OUT_ENCODE, DEFAULT_OUT_VERIFY, MERKLE_DEFAULT_REGION_BLOCKS, INTERLEAVE_MAX_DEPTH, 
+           COLUMN_MAX_PARITY, COLUMN_DEFAULT_GROUP, COLUMN_DEFAULT_PARITY, 
+           EEPROM_NOT_CORRUPTED ? "trusted" : "untrusted", CHECKPOINT_DEFAULT_INTERVAL, 
+           SCRUB_STATE_FILENAME, SCRUB_DEFAULT_HOURS);
 
     printf("\nCreated under MIT license by @dabecart, 2024.\n");
 }
@@ -54,10 +214,22 @@ void print_help(const char* programName){
 /***************************************************************************************************
  * MAIN
  **************************************************************************************************/
+
+// The actions return or exit from many places, so the statistics get printed at exit.
+static void printStatsAtExit(){
+    printCodecStats(stderr);
+}
+
 int main(int argc, char *argv[]){
     int totalTests  = DEFAULT_TOTAL_TESTS;
     int minErrors   = DEFAULT_MIN_ERRORS;
     int maxErrors   = DEFAULT_MAX_ERRORS;
+    long rangeOffsets[MAX_RANGES];
+    long rangeLengths[MAX_RANGES];
+    int numRanges = 0;
+    int hasCheckpoint = 0;
+    double scrubRate = 0;
+    int scrubCpu = 0;
 
     if (argc == 1) print_help(argv[0]);
 
@@ -71,6 +243,17 @@ int main(int argc, char *argv[]){
             testBench(totalTests, minErrors, maxErrors);
             return 0;
 
+        }else if (strcmp(argv[i], "--embedded-bench") == 0){
+            int blocks = DEFAULT_EMBEDDED_BLOCKS;
+            if (i + 1 < argc) blocks = atoi(argv[++i]);
+            embeddedBenchmark(blocks);
+            return 0;
+
+        }else if (strcmp(argv[i], "--stream-test") == 0){
+            int blocks = DEFAULT_STREAM_BLOCKS;
+            if (i + 1 < argc) blocks = atoi(argv[++i]);
+            return streamTest(blocks);
+
         }else if (strcmp(argv[i], "-e") == 0 || strcmp(argv[i], "--encode") == 0){
             if (i + 2 < argc){
                 i++;
@@ -84,19 +267,216 @@ int main(int argc, char *argv[]){
             }
             return 0;
 
-        }else if (strcmp(argv[i], "-v") == 0 || strcmp(argv[i], "--verify") == 0){
-            if(i + 3 < argc){
-                i++;
-                recuperateFile(argv[i], argv[i+1], argv[i+2]);
+        }else if (strcmp(argv[i], "-r") == 0 || strcmp(argv[i], "--range") == 0){
+            if(numRanges == MAX_RANGES){
+                fprintf(stderr, "Error: no more than %d ranges can be given\n", MAX_RANGES);
+                return 1;
             }else if(i + 2 < argc){
-                i++;
-                recuperateFile(argv[i], argv[i+1], DEFAULT_OUT_VERIFY);
+                rangeOffsets[numRanges] = strtol(argv[i+1], NULL, 0);
+                rangeLengths[numRanges++] = strtol(argv[i+2], NULL, 0);
+                i += 2;
+            }else{
+                fprintf(stderr, "Error: -r requires an offset and a length\n");
+                return 1;
+            }
+
+        }else if (strcmp(argv[i], "-v") == 0 || strcmp(argv[i], "--verify") == 0){
+            if(i + 2 < argc){
+                const char* out = (i + 3 < argc) ? argv[i+3] : DEFAULT_OUT_VERIFY;
+                if(numRanges > 1){
+                    fprintf(stderr, "Error: -v only takes one -r range\n");
+                    return 1;
+                }else if(numRanges > 0){
+                    recuperateRange(argv[i+1], argv[i+2], out, rangeOffsets[0], rangeLengths[0]);
+                }else{
+                    recuperateFile(argv[i+1], argv[i+2], out);
+                }
             }else{
                 fprintf(stderr, "Error: -v requires two file paths\n");
                 return 1;
             }
             return 0;
 
+        }else if (strcmp(argv[i], "-u") == 0 || strcmp(argv[i], "--update") == 0){
+            if(i + 2 < argc && (i + 3 < argc || numRanges > 0)){
+                const char* old = (i + 3 < argc) ? argv[i+3] : NULL;
+                updateRecuperationFile(argv[i+1], argv[i+2], old, rangeOffsets, rangeLengths, 
+                                       numRanges);
+            }else{
+                fprintf(stderr, "Error: -u requires two file paths and the old data or -r ranges\n");
+                return 1;
+            }
+            return 0;
+
+        }else if (strcmp(argv[i], "-c") == 0 || strcmp(argv[i], "--cache") == 0){
+            if(i + 1 < argc){
+                setEncodeCacheSize(atol(argv[++i]));
+            }else{
+                fprintf(stderr, "Error: -c requires the number of entries\n");
+                return 1;
+            }
+
+        }else if (strcmp(argv[i], "-m") == 0 || strcmp(argv[i], "--merkle") == 0){
+            long regionBlocks = MERKLE_DEFAULT_REGION_BLOCKS;
+            if(i + 1 < argc && argv[i+1][0] >= '0' && argv[i+1][0] <= '9'){
+                regionBlocks = atol(argv[++i]);
+            }
+            if(regionBlocks <= 0){
+                fprintf(stderr, "Error: -m requires a positive number of blocks\n");
+                return 1;
+            }
+            setIntegrityIndex(regionBlocks);
+
+        }else if (strcmp(argv[i], "-i") == 0 || strcmp(argv[i], "--interleave") == 0){
+            long depth = (i + 1 < argc) ? atol(argv[++i]) : 0;
+            if(depth < 1 || depth > INTERLEAVE_MAX_DEPTH){
+                fprintf(stderr, "Error: -i requires a depth between 1 and %d\n", INTERLEAVE_MAX_DEPTH);
+                return 1;
+            }
+            setInterleaveDepth(depth);
+
+        }else if (strcmp(argv[i], "-k") == 0 || strcmp(argv[i], "--columns") == 0){
+            long group = COLUMN_DEFAULT_GROUP;
+            long parity = COLUMN_DEFAULT_PARITY;
+            if(i + 2 < argc && argv[i+1][0] >= '0' && argv[i+1][0] <= '9'){
+                group = atol(argv[++i]);
+                parity = atol(argv[++i]);
+            }
+            if(group < COLUMN_MIN_GROUP || parity < 1 || parity > COLUMN_MAX_PARITY || 
+               group + parity > COLUMN_MAX_ROWS){
+                fprintf(stderr, "Error: -k requires a group of at least %d blocks and between 1 and %d "
+                                "parity blocks, %d in total at most\n", 
+                        COLUMN_MIN_GROUP, COLUMN_MAX_PARITY, COLUMN_MAX_ROWS);
+                return 1;
+            }
+            setColumnParity(group, parity);
+
+        }else if (strcmp(argv[i], "-p") == 0 || strcmp(argv[i], "--parity") == 0){
+            if(i + 1 < argc && strcmp(argv[i+1], "trusted") == 0){
+                setParityPolicy(PARITY_TRUSTED);
+            }else if(i + 1 < argc && strcmp(argv[i+1], "untrusted") == 0){
+                setParityPolicy(PARITY_UNTRUSTED);
+            }else if(i + 1 < argc && strcmp(argv[i+1], "adaptive") == 0){
+                setParityPolicy(PARITY_ADAPTIVE);
+            }else{
+                fprintf(stderr, "Error: -p requires trusted, untrusted or adaptive\n");
+                return 1;
+            }
+            i++;
+
+        }else if (strcmp(argv[i], "-b") == 0 || strcmp(argv[i], "--budget") == 0){
+            if(i + 1 < argc){
+                setDecodeBudget(atol(argv[++i]));
+            }else{
+                fprintf(stderr, "Error: -b requires the number of combinations\n");
+                return 1;
+            }
+
+        }else if (strcmp(argv[i], "--second-read") == 0){
+            if(i + 1 < argc){
+                setSecondRead(argv[++i]);
+            }else{
+                fprintf(stderr, "Error: --second-read requires a file path\n");
+                return 1;
+            }
+
+        }else if (strcmp(argv[i], "--report") == 0 || strcmp(argv[i], "--report-binary") == 0){
+            if(i + 1 < argc){
+                setRecoveryReport(argv[i+1], strcmp(argv[i], "--report-binary") == 0);
+                i++;
+            }else{
+                fprintf(stderr, "Error: %s requires a file path\n", argv[i]);
+                return 1;
+            }
+
+        }else if (strcmp(argv[i], "--checkpoint") == 0){
+            if(i + 1 < argc){
+                const char* filename = argv[++i];
+                long interval = CHECKPOINT_DEFAULT_INTERVAL;
+                if(i + 1 < argc && argv[i+1][0] >= '0' && argv[i+1][0] <= '9'){
+                    interval = atol(argv[++i]);
+                }
+                setCheckpoint(filename, interval);
+                hasCheckpoint = 1;
+            }else{
+                fprintf(stderr, "Error: --checkpoint requires a file path\n");
+                return 1;
+            }
+
+        }else if (strcmp(argv[i], "--resume") == 0){
+            if(!hasCheckpoint){
+                fprintf(stderr, "Error: --resume requires a --checkpoint before it\n");
+                return 1;
+            }
+            setResume(1);
+
+        }else if (strcmp(argv[i], "--scrub") == 0){
+            if(i + 1 < argc){
+                setThrottle((long) (scrubRate*1e6), scrubCpu);
+                return scrubDirectory(argv[i+1], (i + 2 < argc) ? argv[i+2] : NULL);
+            }else{
+                fprintf(stderr, "Error: --scrub requires a directory\n");
+                return 1;
+            }
+
+        }else if (strcmp(argv[i], "--batch-encode") == 0 || strcmp(argv[i], "--batch-verify") == 0){
+            if(i + 2 < argc && strcmp(argv[i], "--batch-encode") == 0){
+                return batchEncode(argv[i+1], argv[i+2]);
+            }else if(i + 2 < argc){
+                return batchVerify(argv[i+1], argv[i+2]);
+            }else{
+                fprintf(stderr, "Error: %s requires a list of files and a results file\n", argv[i]);
+                return 1;
+            }
+
+        }else if (strcmp(argv[i], "--rate") == 0){
+            scrubRate = (i + 1 < argc) ? atof(argv[++i]) : 0;
+            if(scrubRate <= 0){
+                fprintf(stderr, "Error: --rate requires a positive number of MB/s\n");
+                return 1;
+            }
+
+        }else if (strcmp(argv[i], "--cpu") == 0){
+            scrubCpu = (i + 1 < argc) ? atoi(argv[++i]) : 0;
+            if(scrubCpu < 1 || scrubCpu > 100){
+                fprintf(stderr, "Error: --cpu requires a percentage between 1 and 100\n");
+                return 1;
+            }
+
+        }else if (strcmp(argv[i], "--every") == 0){
+            double hours = (i + 1 < argc) ? atof(argv[++i]) : -1;
+            if(hours < 0){
+                fprintf(stderr, "Error: --every requires a number of hours\n");
+                return 1;
+            }
+            setScrubInterval((long) (hours*3600));
+
+        }else if (strcmp(argv[i], "--no-repair") == 0){
+            setScrubRepair(0);
+
+        }else if (strcmp(argv[i], "--stats") == 0){
+            atexit(printStatsAtExit);
+
+        }else if (strcmp(argv[i], "--no-accel") == 0){
+            setChecksumAcceleration(0);
+
+        }else if (strcmp(argv[i], "-x") == 0 || strcmp(argv[i], "--checksum") == 0){
+            if(i + 1 < argc){
+                return checksumFile(argv[i+1], (i + 2 < argc) ? argv[i+2] : NULL);
+            }else{
+                fprintf(stderr, "Error: -x requires a file path\n");
+                return 1;
+            }
+
+        }else if (strcmp(argv[i], "-s") == 0 || strcmp(argv[i], "--scan") == 0){
+            if(i + 2 < argc){
+                int jsonOutput = (i + 3 < argc) && strcmp(argv[i+3], "--json") == 0;
+                return scanFile(argv[i+1], argv[i+2], jsonOutput);
+            }else{
+                fprintf(stderr, "Error: -s requires two file paths\n");
+                return 1;
+            }
+
         }else{
             fprintf(stderr, "Unknown argument: %s\nUse -h for the help menu.\n", argv[i]);
             return 1;
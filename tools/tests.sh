@@ -0,0 +1,172 @@
+#!/bin/bash
+
+# //////////////////////////////////////////////////////////////////////////////////////////////////
+# @file tests.sh
+# @brief Regression tests of the command line tools. Runs the reed binary given as argument (by
+# default, ./reed) on temporary files and prints the tests that fail. The exit status is the number
+# of failed tests.
+#
+# @version   1.0
+# @date      2024-07-25
+# @author    @dabecart
+#
+# @license
+# This project is licensed under the MIT License - see the LICENSE file for details.
+# //////////////////////////////////////////////////////////////////////////////////////////////////
+
+REED="$(realpath "${1:-./reed}")"
+if [ ! -x "$REED" ]; then
+    echo "$REED is not an executable!"
+    exit -1
+fi
+
+WORK="$(mktemp -d)"
+trap 'rm -rf "$WORK"' EXIT
+cd "$WORK"
+
+FAILED=0
+
+pass() {
+    echo "PASS: $1"
+}
+
+fail() {
+    echo "FAIL: $1"
+    FAILED=$((FAILED + 1))
+}
+
+# The report of an undamaged file has no fixed blocks and no damaged ranges, even if some of its
+# recuperation points needed the retry as 256. The random data makes sure some of them do.
+test_clean_report() {
+    head -c 2000000 /dev/urandom > clean.bin
+    "$REED" -e clean.bin clean.rec > /dev/null
+    "$REED" --report clean.json -v clean.bin clean.rec clean.out > /dev/null
+
+    if grep -q '"fixed_blocks": 0,' clean.json && grep -q '"failed_blocks": 0,' clean.json && \
+       grep -q '"ranges": \[\]' clean.json && cmp -s clean.bin clean.out; then
+        pass "clean file gives a report without damage"
+    else
+        fail "clean file gives a report without damage"
+    fi
+
+    # A single damaged byte is one fixed block on one range.
+    printf '\xA5' | dd of=clean.bin bs=1 seek=123456 conv=notrunc 2> /dev/null
+    "$REED" --report damaged.json -v clean.bin clean.rec clean.out > /dev/null
+    if grep -q '"fixed_blocks": 1,' damaged.json && \
+       [ "$(grep -c '"first_block"' damaged.json)" -eq 1 ]; then
+        pass "one damaged byte gives one fixed block"
+    else
+        fail "one damaged byte gives one fixed block"
+    fi
+}
+
+# A batch with more files than the process can have open, which are opened a few at a time. The
+# recuperation files are the same as the ones of -e.
+test_batch_many_files() {
+    mkdir many
+    for i in $(seq 1 300); do
+        head -c $((RANDOM % 5000)) /dev/urandom > "many/f$i.bin"
+    done
+
+    if (ulimit -n 64 && "$REED" -m -k -i 8 --batch-encode many encoded.txt > /dev/null) && \
+       [ "$(grep -c '^encoded' encoded.txt)" -eq 300 ]; then
+        pass "batch encode of more files than the open file limit"
+    else
+        fail "batch encode of more files than the open file limit"
+    fi
+
+    if (ulimit -n 64 && "$REED" --batch-verify encoded.txt verified.txt > /dev/null) && \
+       [ "$(grep -c '^clean' verified.txt)" -eq 300 ]; then
+        pass "batch verify of more files than the open file limit"
+    else
+        fail "batch verify of more files than the open file limit"
+    fi
+
+    local same=1
+    for i in 1 150 300; do
+        "$REED" -m -k -i 8 -e "many/f$i.bin" single.rec > /dev/null
+        cmp -s single.rec "many/f$i.bin.rec" || same=0
+    done
+    if [ $same -eq 1 ]; then
+        pass "batch encode gives the same recuperation files as -e"
+    else
+        fail "batch encode gives the same recuperation files as -e"
+    fi
+}
+
+# The integrity index only hashes the data, so the recuperation data of a region whose hash matches
+# still has to be checked. --scrub rewrites it from the data.
+test_scan_parity_rot() {
+    head -c 1000000 /dev/urandom > rot.bin
+    "$REED" -m -e rot.bin rot.rec > /dev/null
+    cp rot.rec rot.orig.rec
+    printf '\x11\x22' | dd of=rot.rec bs=1 seek=200000 conv=notrunc 2> /dev/null
+
+    "$REED" -s rot.bin rot.rec > /dev/null
+    if [ $? -eq 1 ]; then
+        pass "scan reports damaged recuperation data of a verified region"
+    else
+        fail "scan reports damaged recuperation data of a verified region"
+    fi
+
+    mkdir rot && mv rot.bin rot.rec rot/
+    "$REED" --scrub rot > /dev/null
+    if cmp -s rot/rot.rec rot.orig.rec; then
+        pass "scrub repairs damaged recuperation data of a verified region"
+    else
+        fail "scrub repairs damaged recuperation data of a verified region"
+    fi
+}
+
+# A block with more errors than its own recuperation data can fix is recuperated by the column
+# parity, and still counts as a fixed block of the report.
+test_column_report() {
+    head -c 2000000 /dev/urandom > column.bin
+    cp column.bin column.orig.bin
+    "$REED" -k -e column.bin column.rec > /dev/null
+    printf '\x01\x02\x03\x04\x05\x06' | dd of=column.bin bs=1 seek=50000 conv=notrunc 2> /dev/null
+    "$REED" --report column.json -v column.bin column.rec column.out > /dev/null
+
+    if grep -q '"fixed_blocks": 1,' column.json && grep -q '"column_fixed_blocks": 1,' column.json && \
+       [ "$(grep -c '"first_block"' column.json)" -eq 1 ] && cmp -s column.orig.bin column.out; then
+        pass "column parity recovery gives one fixed block"
+    else
+        fail "column parity recovery gives one fixed block"
+    fi
+}
+
+# An encoding killed after its first checkpoint gives, once resumed, the same recuperation file as
+# one that was never stopped. The checkpoint cannot be resumed on another file of the same size.
+test_checkpoint_resume() {
+    head -c 50000000 /dev/urandom > resume.bin
+    head -c 50000000 /dev/urandom > other.bin
+    "$REED" -i 16 -k -e resume.bin resume.full.rec > /dev/null
+
+    "$REED" --checkpoint resume.ckpt 0 -i 16 -k -e resume.bin resume.rec > /dev/null 2>&1 &
+    local pid=$!
+    while [ ! -s resume.ckpt ] && kill -0 $pid 2> /dev/null; do sleep 0.05; done
+    kill -9 $pid 2> /dev/null
+    wait $pid 2> /dev/null
+
+    if ! "$REED" --checkpoint resume.ckpt 0 --resume -i 16 -k -e other.bin resume.rec \
+         > /dev/null 2>&1 && [ -s resume.ckpt ]; then
+        pass "checkpoint is refused on another input"
+    else
+        fail "checkpoint is refused on another input"
+    fi
+
+    "$REED" --checkpoint resume.ckpt 0 --resume -i 16 -k -e resume.bin resume.rec > /dev/null 2>&1
+    if cmp -s resume.rec resume.full.rec; then
+        pass "resumed encoding gives the same recuperation file"
+    else
+        fail "resumed encoding gives the same recuperation file"
+    fi
+}
+
+test_clean_report
+test_column_report
+test_checkpoint_resume
+test_batch_many_files
+test_scan_parity_rot
+
+exit $FAILED